@@ -630,10 +630,10 @@ namespace Extinction {
 
         std::cout << "=== Initialzie History" << std::endl;
         const Double_t lastThreshold = 100 * nsec;
-        std::vector<Extinction::TdcData> lastExtData;
-        std::vector<Extinction::TdcData> lastHodData;
-        std::vector<Extinction::TdcData> lastTcData;
-        std::vector<Extinction::TdcData> lastBhData;
+        Extinction::TdcHistory_t         lastExtData;
+        Extinction::TdcHistory_t         lastHodData;
+        Extinction::TdcHistory_t         lastTcData;
+        Extinction::TdcHistory_t         lastBhData;
         std::vector<Extinction::TdcData> lastMrSyncData;
         std::vector<Extinction::TdcData> eventMatchData;
         std::map<std::size_t, Extinction::TdcData> recExtData;
@@ -954,10 +954,10 @@ namespace Extinction {
           }
 
           if (provider->GetSpill() != lastSpill) {
-            lastExtData.clear();
-            lastHodData.clear();
-            lastTcData.clear();
-            lastBhData.clear();
+            lastExtData.Clear();
+            lastHodData.Clear();
+            lastTcData.Clear();
+            lastBhData.Clear();
             lastMrSyncData.clear();
           }
 
@@ -1030,18 +1030,10 @@ namespace Extinction {
                 hExtTdcCoin[ch]->Fill(lastCh + CoinOffset::BH, lastTdc - tdc);
               }
 
-              for (std::size_t i = 0, n = lastExtData.size(); i < n; ++i) {
-                if (TMath::Abs(time - lastExtData[0].Time) > lastThreshold) {
-                  lastExtData.erase(lastExtData.begin());
-                } else {
-                  break;
-                }
-              }
-              lastExtData.push_back(data);
-              if (lastExtData.size() > 10000) {
-                std::cerr << "[error] size of lastExtData reaches 10000" << std::endl;
-                exit(1);
-              }
+              lastExtData.PopWhile([&](const TdcData& lastData) {
+                  return TMath::Abs(time - lastData.Time) > lastThreshold;
+                });
+              lastExtData.Push(data);
 
             } else if (Hodoscope::Contains(globalChannel)) {
               const Int_t ch = Hodoscope::GetChannel(globalChannel);
@@ -1089,18 +1081,10 @@ namespace Extinction {
                 hExtTdcCoin[lastCh]->Fill(ch + CoinOffset::Hod, tdc - lastTdc);
               }
 
-              for (std::size_t i = 0, n = lastHodData.size(); i < n; ++i) {
-                if (TMath::Abs(time - lastHodData[0].Time) > lastThreshold) {
-                  lastHodData.erase(lastHodData.begin());
-                } else {
-                  break;
-                }
-              }
-              lastHodData.push_back(data);
-              if (lastHodData.size() > 10000) {
-                std::cerr << "[error] size of lastHodData reaches 10000" << std::endl;
-                exit(1);
-              }
+              lastHodData.PopWhile([&](const TdcData& lastData) {
+                  return TMath::Abs(time - lastData.Time) > lastThreshold;
+                });
+              lastHodData.Push(data);
 
             } else if (TimingCounter::Contains(globalChannel)) {
               const Int_t ch = TimingCounter::GetChannel(globalChannel);
@@ -1149,18 +1133,10 @@ namespace Extinction {
                 hExtTdcCoin[lastCh]->Fill(ch + CoinOffset::TC, tdc - lastTdc);
               }
 
-              for (std::size_t i = 0, n = lastTcData.size(); i < n; ++i) {
-                if (TMath::Abs(time - lastTcData[0].Time) > lastThreshold) {
-                  lastTcData.erase(lastTcData.begin());
-                } else {
-                  break;
-                }
-              }
-              lastTcData.push_back(data);
-              if (lastTcData.size() > 10000) {
-                std::cerr << "[error] size of lastTcData reaches 10000" << std::endl;
-                exit(1);
-              }
+              lastTcData.PopWhile([&](const TdcData& lastData) {
+                  return TMath::Abs(time - lastData.Time) > lastThreshold;
+                });
+              lastTcData.Push(data);
 
             } else if (BeamlineHodoscope::Contains(globalChannel)) {
               const Int_t ch = BeamlineHodoscope::GetChannel(globalChannel);
@@ -1209,18 +1185,10 @@ namespace Extinction {
                 hExtTdcCoin[lastCh]->Fill(ch + CoinOffset::BH, tdc - lastTdc);
               }
 
-              for (std::size_t i = 0, n = lastBhData.size(); i < n; ++i) {
-                if (TMath::Abs(time - lastBhData[0].Time) > lastThreshold) {
-                  lastBhData.erase(lastBhData.begin());
-                } else {
-                  break;
-                }
-              }
-              lastBhData.push_back(data);
-              if (lastBhData.size() > 10000) {
-                std::cerr << "[error] size of lastBhData reaches 10000" << std::endl;
-                exit(1);
-              }
+              lastBhData.PopWhile([&](const TdcData& lastData) {
+                  return TMath::Abs(time - lastData.Time) > lastThreshold;
+                });
+              lastBhData.Push(data);
 
             } else if (MrSync::Contains(globalChannel)) {
               const Int_t ch = MrSync::GetChannel(globalChannel);
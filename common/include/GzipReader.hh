@@ -0,0 +1,182 @@
+#ifndef Extinction_GzipReader_hh
+#define Extinction_GzipReader_hh
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <cstdlib>
+#include <zlib.h>
+#include "Rtypes.h"
+
+namespace Extinction {
+
+  // Sequential reader of a gzipped raw data file, either ".gz" or ".tar.gz" made by "daq --compress".
+  // Decompression runs on a background thread a few blocks ahead of the reader.
+  // For a tar archive, only the first member is read.
+  class GzipReader {
+  public:
+    static const std::size_t kBlockSize  = 4UL * 1024UL * 1024UL;
+    static const std::size_t kNofBlocks  = 4UL;
+    static const std::size_t kTarBlock   = 512UL;
+
+  private:
+    gzFile                           fFile     = nullptr;
+    std::thread                      fThread;
+    std::mutex                       fMutex;
+    std::condition_variable          fCond;
+    std::deque<std::vector<UChar_t>> fBlocks;
+    std::vector<UChar_t>             fCurrent;
+    std::size_t                      fPosition = 0;
+    Bool_t                           fEnded    = false;
+    Bool_t                           fStop     = false;
+
+  public:
+    GzipReader() = default;
+    GzipReader(const GzipReader&) = delete;
+    GzipReader& operator=(const GzipReader&) = delete;
+    ~GzipReader() {
+      Close();
+    }
+
+    static Bool_t IsCompressed(const std::string& filename) {
+      auto endsWith =
+        [&](const std::string& suffix) {
+          return filename.size() >= suffix.size() &&
+            filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+        };
+      return endsWith(".gz") || endsWith(".tgz");
+    }
+
+    Bool_t Open(const std::string& filename) {
+      Close();
+
+      if ((fFile = gzopen(filename.data(), "rb")) == nullptr) {
+        std::cerr << "[error] file is not opened, " << filename << std::endl;
+        return false;
+      }
+      gzbuffer(fFile, 1024 * 1024);
+
+      fThread = std::thread(&GzipReader::Run, this);
+      return true;
+    }
+
+    inline Bool_t IsOpen() const {
+      return fFile;
+    }
+
+    void Close() {
+      {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fStop = true;
+      }
+      fCond.notify_all();
+      if (fThread.joinable()) {
+        fThread.join();
+      }
+      if (fFile) {
+        gzclose(fFile);
+      }
+      fFile     = nullptr;
+      fPosition = 0;
+      fEnded    = false;
+      fStop     = false;
+      fBlocks.clear();
+      fCurrent.clear();
+    }
+
+    // Copies up to size bytes, returns 0 at the end of data
+    std::size_t Read(void* data, std::size_t size) {
+      std::size_t copied = 0;
+      while (copied < size) {
+        if (fPosition == fCurrent.size()) {
+          std::unique_lock<std::mutex> lock(fMutex);
+          fCond.wait(lock, [this] { return !fBlocks.empty() || fEnded; });
+          if (fBlocks.empty()) {
+            break;
+          }
+          fCurrent.swap(fBlocks.front());
+          fBlocks.pop_front();
+          fPosition = 0;
+          lock.unlock();
+          fCond.notify_all();
+        }
+        const std::size_t n = std::min(size - copied, fCurrent.size() - fPosition);
+        std::memcpy((UChar_t*)data + copied, fCurrent.data() + fPosition, n);
+        fPosition += n;
+        copied    += n;
+      }
+      return copied;
+    }
+
+  private:
+    // Returns the member size if the block is a ustar header, otherwise -1
+    static Long64_t GetTarMemberSize(const UChar_t* header) {
+      if (std::memcmp(header + 257, "ustar", 5) != 0) {
+        return -1;
+      }
+      const std::string size((const Char_t*)header + 124, 12);
+      return std::strtoll(size.data(), nullptr, 8);
+    }
+
+    Bool_t Push(std::vector<UChar_t>& block) {
+      std::unique_lock<std::mutex> lock(fMutex);
+      fCond.wait(lock, [this] { return fStop || fBlocks.size() < kNofBlocks; });
+      if (fStop) {
+        return false;
+      }
+      fBlocks.push_back(std::move(block));
+      lock.unlock();
+      fCond.notify_all();
+      return true;
+    }
+
+    void Run() {
+      Long64_t rest = -1; // bytes left in the tar member, -1 for plain gzip
+      Bool_t   head = true;
+      while (rest != 0) {
+        std::vector<UChar_t> block(kBlockSize);
+        const std::size_t    want = rest < 0 ? kBlockSize : std::min<Long64_t>(kBlockSize, rest);
+        const Int_t          n    = gzread(fFile, block.data(), want);
+        if (n < 0) {
+          Int_t errnum = 0;
+          std::cerr << "[error] decompression failed, " << gzerror(fFile, &errnum) << std::endl;
+          break;
+        } else if (n == 0) {
+          break;
+        }
+        block.resize(n);
+
+        if (head) {
+          head = false;
+          if (block.size() >= kTarBlock && (rest = GetTarMemberSize(block.data())) >= 0) {
+            block.erase(block.begin(), block.begin() + kTarBlock);
+            if ((Long64_t)block.size() > rest) {
+              block.resize(rest);
+            }
+          }
+        }
+        if (rest > 0) {
+          rest -= block.size();
+        }
+
+        if (!block.empty() && !Push(block)) {
+          return;
+        }
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fEnded = true;
+      }
+      fCond.notify_all();
+    }
+  };
+
+}
+
+#endif
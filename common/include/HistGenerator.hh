@@ -3,6 +3,11 @@
 
 #include <iostream>
 #include <fstream>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 #include "TROOT.h"
 #include "TSystem.h"
@@ -54,9 +59,6 @@ namespace Extinction {
         } TimeDiff;
       };
 
-    private:
-      static const std::size_t kHistLimit = 10000;
-
     public:
       using TdcOffsets_t = MargedReader::TdcOffsets_t;
 
@@ -119,11 +121,11 @@ namespace Extinction {
 
       Double_t                     fHistoryWidth              = 600.0 * nsec;
 
-      std::vector<TdcData>         fLastBhData;
-      std::vector<TdcData>         fLastHodData;
-      std::vector<TdcData>         fLastExtData;
-      std::vector<TdcData>         fLastTcData;
-      std::map<Int_t, TdcData>     fLastMrSyncData;
+      HitHistory_t                 fLastBhData;
+      HitHistory_t                 fLastHodData;
+      HitHistory_t                 fLastExtData;
+      HitHistory_t                 fLastTcData;
+      std::map<Int_t, TdcHit_t>    fLastMrSyncData;
 
       Double_t                     fBunchCenters [Extinction::kNofBunches] = { };
    // Double_t                     fBunchWidths  [Extinction::kNofBunches] = { };
@@ -131,6 +133,9 @@ namespace Extinction {
       Double_t                     fBunchMaxEdges[Extinction::kNofBunches] = { };
       Bool_t                       fOffsetFromBunch           = false;
 
+      PlotsProfiles                fProfile;
+      HitBatch_t                   fHitsInMrSync;
+
     public:
       HistGenerator(ITdcDataProvider* provider);
       ~HistGenerator();
@@ -176,14 +181,27 @@ namespace Extinction {
       void                 WriteTdcOffsets(const std::string& ofilename);
 
       Int_t                GeneratePlots(MargedReader* reader);
+      Int_t                GeneratePlots(MargedReader*                                  reader,
+                                         const BoardMap_t<std::string>&                 ifilenames,
+                                         const std::string&                             itreename,
+                                         const std::function<ITdcDataProvider*(Int_t)>& createProvider,
+                                         std::size_t                                    nthreads);
 
       void                 CalcEntries();
       void                 CalcMrSyncInterval();
       void                 CalcTdcOffsets();
 
     private:
+      HistGenerator*       CloneSettings() const;
+      void                 AddPlots(const HistGenerator* other);
+
+      void                 ReadFirstMrSync(MargedReader* reader);
+      Int_t                ProcessMrSyncs(MargedReader* reader);
+      void                 FillSpillSummary();
+      void                 FillProjections();
+
       void                 ClearLastSpill(Bool_t clearHists);
-      std::size_t          RemoveOldTdc(std::vector<TdcData>* lastData, const TdcData& tdc);
+      std::size_t          RemoveOldTdc(HitHistory_t* lastData, const TdcHit_t& tdc);
 
       Bool_t               IsInBunch(Long64_t dtdc) const {
         for (std::size_t bunch = 0; bunch < kNofBunches; ++bunch) {
@@ -204,10 +222,10 @@ namespace Extinction {
 
     HistGenerator::HistGenerator(ITdcDataProvider* provider)
       : fProvider(provider) {
-      fLastBhData .reserve(100);
-      fLastHodData.reserve(100);
-      fLastExtData.reserve(100);
-      fLastTcData .reserve(100);
+      fLastBhData .Reserve(128);
+      fLastHodData.Reserve(128);
+      fLastExtData.Reserve(128);
+      fLastTcData .Reserve(128);
     }
 
     HistGenerator::~HistGenerator() {
@@ -458,6 +476,7 @@ namespace Extinction {
 
     void HistGenerator::InitializePlots(const PlotsProfiles& profile) {
       std::cout << "Initialize plots" << std::endl;
+      fProfile = profile;
       const std::string tdcName    = fProvider->GetName();
       const Double_t    timePerTdc = fProvider->GetTimePerTdc();
 
@@ -1450,10 +1469,10 @@ namespace Extinction {
     }
 
     void HistGenerator::ClearLastSpill(Bool_t clearHists) {
-      fLastExtData.clear();
-      fLastHodData.clear();
-      fLastTcData .clear();
-      fLastBhData .clear();
+      fLastExtData.Clear();
+      fLastHodData.Clear();
+      fLastTcData .Clear();
+      fLastBhData .Clear();
       fLastMrSyncData.clear();
 
       if (clearHists) {
@@ -1582,17 +1601,148 @@ namespace Extinction {
       }
     }
 
-    std::size_t HistGenerator::RemoveOldTdc(std::vector<TdcData>* lastData, const TdcData& tdc) {
-      for (std::size_t i = 0, n = lastData->size(); i < n; ++i) {
-        TdcData& lastTdc = lastData->at(0);
-        const Double_t dt = TdcData::GetTimeDifference(tdc, lastTdc);
-        if (std::abs(dt) > fHistoryWidth) {
-          lastData->erase(lastData->begin());
-        } else {
-          break;
-        }
+    HistGenerator* HistGenerator::CloneSettings() const {
+      HistGenerator* generator = new HistGenerator(fProvider);
+      generator->fRefExtChannel   = fRefExtChannel;
+      generator->fTdcOffsets      = fTdcOffsets;
+      generator->fHistoryWidth    = fHistoryWidth;
+      std::copy(std::begin(fBunchCenters ), std::end(fBunchCenters ), std::begin(generator->fBunchCenters ));
+      std::copy(std::begin(fBunchMinEdges), std::end(fBunchMinEdges), std::begin(generator->fBunchMinEdges));
+      std::copy(std::begin(fBunchMaxEdges), std::end(fBunchMaxEdges), std::begin(generator->fBunchMaxEdges));
+      generator->fOffsetFromBunch = fOffsetFromBunch;
+      generator->InitializePlots(fProfile);
+      return generator;
+    }
+
+    void HistGenerator::AddPlots(const HistGenerator* other) {
+      hHodHitMap     ->Add(other->hHodHitMap);
+      hHodEntriesByCh->Add(other->hHodEntriesByCh);
+
+      hExtHitMap            ->Add(other->hExtHitMap);
+      hExtEntriesByCh       ->Add(other->hExtEntriesByCh);
+      hExtEntriesByChBottom ->Add(other->hExtEntriesByChBottom);
+      hExtEntriesByChCenter1->Add(other->hExtEntriesByChCenter1);
+      hExtEntriesByChCenter2->Add(other->hExtEntriesByChCenter2);
+      hExtEntriesByChTop    ->Add(other->hExtEntriesByChTop);
+
+      hEntriesInMrSyncByCh      ->Add(other->hEntriesInMrSyncByCh);
+      hEntriesInMrSyncByDetector->Add(other->hEntriesInMrSyncByDetector);
+
+      hExtEntriesInMrSyncInSpill->Add(other->hExtEntriesInMrSyncInSpill);
+
+      for (std::size_t ch = 0; ch < BeamlineHodoscope::NofChannels; ++ch) {
+        hBhTdcInSpill[ch]->Add(other->hBhTdcInSpill[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < Hodoscope::NofChannels; ++ch) {
+        hHodTdcInSpill[ch]->Add(other->hHodTdcInSpill[ch]);
+      } {
+        hHodTdcInSpill_Any->Add(other->hHodTdcInSpill_Any);
+      }
+
+      for (std::size_t ch = 0; ch < ExtinctionDetector::NofChannels; ++ch) {
+        hExtTdcInSpill[ch]->Add(other->hExtTdcInSpill[ch]);
+      } {
+        hExtTdcInSpill_Any->Add(other->hExtTdcInSpill_Any);
+      }
+
+      for (std::size_t ch = 0; ch < TimingCounter::NofChannels; ++ch) {
+        hTcTdcInSpill[ch]->Add(other->hTcTdcInSpill[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < MrSync::NofChannels; ++ch) {
+        hMrSyncTdcInSpill[ch]->Add(other->hMrSyncTdcInSpill[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < EventMatch::NofChannels; ++ch) {
+        hEvmTdcInSpill[ch]->Add(other->hEvmTdcInSpill[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < Veto::NofChannels; ++ch) {
+        hVetoTdcInSpill[ch]->Add(other->hVetoTdcInSpill[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < MrSync::NofChannels; ++ch) {
+        hErrTdcInSpill[ch]->Add(other->hErrTdcInSpill[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < BeamlineHodoscope::NofChannels; ++ch) {
+        hBhTdcInSync[ch]->Add(other->hBhTdcInSync[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < Hodoscope::NofChannels; ++ch) {
+        hHodTdcInSync[ch]->Add(other->hHodTdcInSync[ch]);
+      } {
+        hHodTdcInSync_Any->Add(other->hHodTdcInSync_Any);
+      }
+
+      for (std::size_t ch = 0; ch < ExtinctionDetector::NofChannels; ++ch) {
+        hExtTdcInSync[ch]->Add(other->hExtTdcInSync[ch]);
+      } {
+        hExtTdcInSync_Any->Add(other->hExtTdcInSync_Any);
+      }
+
+      for (std::size_t ch = 0; ch < TimingCounter::NofChannels; ++ch) {
+        hTcTdcInSync[ch]->Add(other->hTcTdcInSync[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < Veto::NofChannels; ++ch) {
+        hVetoTdcInSync[ch]->Add(other->hVetoTdcInSync[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < BeamlineHodoscope::NofChannels; ++ch) {
+        hBhMountain[ch]->Add(other->hBhMountain[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < Hodoscope::NofChannels; ++ch) {
+        hHodMountain[ch]->Add(other->hHodMountain[ch]);
+      } {
+        hHodMountain_Any->Add(other->hHodMountain_Any);
+      }
+
+      for (std::size_t ch = 0; ch < ExtinctionDetector::NofChannels; ++ch) {
+        hExtMountain[ch]->Add(other->hExtMountain[ch]);
+      } {
+        hExtMountain_Any->Add(other->hExtMountain_Any);
+      }
+
+      for (std::size_t ch = 0; ch < TimingCounter::NofChannels; ++ch) {
+        hTcMountain[ch]->Add(other->hTcMountain[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < Veto::NofChannels; ++ch) {
+        hVetoMountain[ch]->Add(other->hVetoMountain[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < MrSync::NofChannels; ++ch) {
+        hErrMountain[ch]->Add(other->hErrMountain[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < MrSync::NofChannels; ++ch) {
+        hMrSyncInterval[ch]->Add(other->hMrSyncInterval[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < MrSync::NofChannels; ++ch) {
+        hMrSyncInterval2[ch]->Add(other->hMrSyncInterval2[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < BeamlineHodoscope::NofChannels; ++ch) {
+        hBhTdcOffset[ch]->Add(other->hBhTdcOffset[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < TimingCounter::NofChannels; ++ch) {
+        hTcTdcOffset[ch]->Add(other->hTcTdcOffset[ch]);
       }
-      return lastData->size();
+
+      for (std::size_t ch = 0; ch < ExtinctionDetector::NofChannels; ++ch) {
+        hExtTdcOffset[ch]->Add(other->hExtTdcOffset[ch]);
+      }
+    }
+
+    std::size_t HistGenerator::RemoveOldTdc(HitHistory_t* lastData, const TdcHit_t& tdc) {
+      return lastData->PopWhile([&](const TdcHit_t& lastTdc) {
+          return std::abs(fHitsInMrSync.GetTimeDifference(tdc, lastTdc)) > fHistoryWidth;
+        });
     }
 
     Int_t HistGenerator::GeneratePlots(MargedReader* reader) {
@@ -1603,552 +1753,676 @@ namespace Extinction {
 
       // std::cout << "[debug] check end of spill" << std::endl;
       // Throw away first mr sync
-      std::map<Tag_t, TdcData> tdcDataInMrSync;
-      reader->Read(tdcDataInMrSync);
-      tdcDataInMrSync.clear();
-
-      fSpillData.SetDate(reader->GetDate());
-      fSpillData.EMCount = reader->GetEMCount();
+      ReadFirstMrSync(reader);
 
-      std::map<std::size_t, Long64_t> entriesInMrSyncByCh;
-      std::map<Int_t, Long64_t> entriesInMrSyncByDetector;
-      
       while (true) {
-        for (; reader->Read(tdcDataInMrSync); tdcDataInMrSync.clear()) {
-          // std::cout << "[debug] data process" << std::endl;
-          for (auto&& pair : tdcDataInMrSync) {
-            // auto& tag  = pair.first;
-            auto& data = pair.second;
-            const Int_t    board   = data.Board;
-            const Int_t    gch     = data.Channel;
-            const Double_t time    = data.Time;
-            const Long64_t syncTdc = fLastMrSyncData[board].Tdc;
-
-            if (data.Channel < 0) {
-              hErrTdcInSpill[board]->Fill(time / msec);
-              for (Int_t xbin = 0, nbinsx = hErrMountain[board]->GetNbinsX(); xbin < nbinsx; ++xbin) {
-                const Double_t dtdc = hErrMountain[board]->GetXaxis()->GetBinCenter(xbin);
-                hErrMountain[board]->Fill(dtdc, time / msec);
+        if (ProcessMrSyncs(reader)) {
+          return 1;
+        }
+
+        // std::cout << "[debug] check end of spill" << std::endl;
+        // Check end of spill
+        if (reader->IsSpillEnded()) {
+          std::cout << "[info] end of spill" << std::endl;
+
+          FillSpillSummary();
+
+          // History is not carried over to the next spill, as in spill parallel mode
+          ClearLastSpill(false);
+
+          reader->ClearLastSpill();
+          // std::cout << "[debug] Throw away first mr sync" << std::endl;
+          // Throw away first mr sync
+          ReadFirstMrSync(reader);
+        }
+
+        // std::cout << "[debug] check end of file" << std::endl;
+        // Check end of file
+        if (reader->IsFileEnded()) {
+          std::cout << "[info] end of file" << std::endl;
+
+          FillProjections();
+
+          break;
+        }
+      }
+
+      const clock_t stopClock = clock();
+      std::cout << "time: " << (double)(stopClock - startClock) / CLOCKS_PER_SEC << " sec\n";
+
+      return 0;
+    }
+
+    Int_t HistGenerator::GeneratePlots(MargedReader*                                  reader,
+                                       const BoardMap_t<std::string>&                 ifilenames,
+                                       const std::string&                             itreename,
+                                       const std::function<ITdcDataProvider*(Int_t)>& createProvider,
+                                       std::size_t                                    nthreads) {
+      if (nthreads <= 1) {
+        return GeneratePlots(reader);
+      }
+
+      const clock_t startClock = clock();
+      const time_t  startTime  = time(nullptr);
+
+      std::cout << "Build spill index" << std::endl;
+      std::vector<BoardMap_t<MargedReader::EntryRange_t>> spillIndex;
+      if (reader->BuildSpillIndex(spillIndex) < 0) {
+        return 1;
+      }
+      std::cout << " = " << spillIndex.size() << " spills" << std::endl;
+
+      std::cout << "Initialize history" << std::endl;
+      ClearLastSpill(true);
+
+      ROOT::EnableThreadSafety();
+
+      // Thread local histogram sets and readers
+      std::cout << "Initialize workers" << std::endl;
+      nthreads = std::min(nthreads, std::max<std::size_t>(spillIndex.size(), 1));
+      const Bool_t addDirectory = TH1::AddDirectoryStatus();
+      TH1::AddDirectory(false);
+      std::vector<HistGenerator*>                 generators;
+      std::vector<MargedReader*>                  readers;
+      std::vector<BoardMap_t<ITdcDataProvider*>>  providers(nthreads);
+      for (std::size_t i = 0; i < nthreads; ++i) {
+        generators.push_back(CloneSettings());
+        readers   .push_back(reader->CloneSettings());
+        for (auto&& pair : ifilenames) {
+          providers[i][pair.first] = createProvider(pair.first);
+        }
+      }
+      TH1::AddDirectory(addDirectory);
+
+      // Spills are processed in any order, merged in order of spill.
+      // After an error no spill is taken, and the taken ones are drained without merging
+      std::atomic<Bool_t>      failed     { false };
+      std::atomic<std::size_t> nextSpill  { 0 };
+      std::size_t              mergedSpill  = 0;
+      std::mutex               mergeMutex;
+      std::condition_variable  mergedSpillChanged;
+
+      auto processSpills =
+        [&] (std::size_t i) {
+          HistGenerator* generator   = generators[i];
+          MargedReader*  spillReader = readers   [i];
+          if ((reader->IsMargedInput() ?
+               spillReader->OpenMarged(reader->GetMargedFilename(), reader->GetMargedTreename()) :
+               spillReader->Open(providers[i], ifilenames, itreename))) {
+            failed = true;
+          }
+          for (std::size_t spill; !failed && (spill = nextSpill++) < spillIndex.size(); ) {
+            generator->ClearLastSpill(true);
+
+            Bool_t spillEnded = false;
+            if (spillReader->SetEntryRanges(spillIndex[spill])) {
+              failed = true;
+            } else {
+              generator->ReadFirstMrSync(spillReader);
+              if (generator->ProcessMrSyncs(spillReader)) {
+                failed = true;
               }
-              continue;
+              spillEnded = spillReader->IsSpillEnded();
             }
 
-            if (Detectors::Contains(data.Channel)) {
-              ++entriesInMrSyncByCh[data.Channel];
+            std::unique_lock<std::mutex> lock(mergeMutex);
+            mergedSpillChanged.wait(lock, [&] { return mergedSpill == spill; });
+            if (!failed) {
+              std::cout << "[info] merge spill " << spill << std::endl;
+              AddPlots(generator);
+              if (spillEnded) {
+                fSpillData.SetDate(generator->fSpillData.Date.Convert());
+                fSpillData.EMCount = generator->fSpillData.EMCount;
+                FillSpillSummary();
+              }
+            }
+            ++mergedSpill;
+            mergedSpillChanged.notify_all();
+          }
+          spillReader->Close();
+        };
+
+      std::vector<std::thread> threads;
+      for (std::size_t i = 0; i < nthreads; ++i) {
+        threads.emplace_back(processSpills, i);
+      }
+      for (auto&& thread : threads) {
+        thread.join();
+      }
+
+      for (std::size_t i = 0; i < nthreads; ++i) {
+        delete generators[i];
+        delete readers   [i];
+        for (auto&& pair : providers[i]) {
+          delete pair.second;
+        }
+      }
+
+      if (failed) {
+        std::cerr << "[error] spill parallel processing is aborted" << std::endl;
+        return 1;
+      }
+
+      FillProjections();
+
+      const clock_t stopClock = clock();
+      std::cout << "time: " << (double)(stopClock - startClock) / CLOCKS_PER_SEC << " sec (cpu), "
+                << time(nullptr) - startTime << " sec (wall)\n";
+
+      return 0;
+    }
+
+    void HistGenerator::ReadFirstMrSync(MargedReader* reader) {
+      reader->Read(fHitsInMrSync);
+      fHitsInMrSync.Clear();
+
+      if (!reader->IsFileEnded()) {
+        fSpillData.SetDate(reader->GetDate());
+        fSpillData.EMCount = reader->GetEMCount();
+      }
+    }
+
+    Int_t HistGenerator::ProcessMrSyncs(MargedReader* reader) {
+      std::map<std::size_t, Long64_t> entriesInMrSyncByCh;
+      std::map<Int_t, Long64_t> entriesInMrSyncByDetector;
+
+      for (; reader->Read(fHitsInMrSync); fHitsInMrSync.Clear()) {
+        // std::cout << "[debug] data process" << std::endl;
+        for (std::size_t i = 0, n = fHitsInMrSync.Size(); i < n; ++i) {
+          const TdcHit_t data    = fHitsInMrSync.GetHit(i);
+          const Int_t    board   = data.Board;
+          const Int_t    gch     = data.Channel;
+          const Double_t time    = fHitsInMrSync.GetTime(i);
+          const Long64_t syncTdc = fLastMrSyncData[board].Tdc;
+
+          if (data.Channel < 0) {
+            hErrTdcInSpill[board]->Fill(time / msec);
+            for (Int_t xbin = 0, nbinsx = hErrMountain[board]->GetNbinsX(); xbin < nbinsx; ++xbin) {
+              const Double_t dtdc = hErrMountain[board]->GetXaxis()->GetBinCenter(xbin);
+              hErrMountain[board]->Fill(dtdc, time / msec);
             }
+            continue;
+          }
 
-            if (BeamlineHodoscope::Contains(data.Channel)) {
-              // std::cout << "[debug] beamline hodoscope" << std::endl;
-              const Int_t    ch  = BeamlineHodoscope::GetChannel(gch);
-              const Long64_t tdc = data.Tdc;
+          if (Detectors::Contains(data.Channel)) {
+            ++entriesInMrSyncByCh[data.Channel];
+          }
 
-              ++entriesInMrSyncByDetector[Detectors::Bh1 + ch];
+          if (BeamlineHodoscope::Contains(data.Channel)) {
+            // std::cout << "[debug] beamline hodoscope" << std::endl;
+            const Int_t    ch  = BeamlineHodoscope::GetChannel(gch);
+            const Long64_t tdc = data.Tdc;
 
-              hBhTdcInSpill[ch]->Fill(time / msec);
+            ++entriesInMrSyncByDetector[Detectors::Bh1 + ch];
 
-              if (syncTdc) {
-                hBhTdcInSync[ch]->Fill(tdc - syncTdc);
-                hBhMountain [ch]->Fill(tdc - syncTdc, time / msec);
+            hBhTdcInSpill[ch]->Fill(time / msec);
 
-                if (fOffsetFromBunch) {
-                  const Bool_t thisIsInBunch = IsInBunch(tdc - syncTdc);
+            if (syncTdc) {
+              hBhTdcInSync[ch]->Fill(tdc - syncTdc);
+              hBhMountain [ch]->Fill(tdc - syncTdc, time / msec);
 
-                  for (auto&& lastData : fLastBhData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = BeamlineHodoscope::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
-                      if (thisIsInBunch)
-                        hBhTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
-                      if (IsInBunch(lastData.Tdc - lastSyncTdc))
-                        hBhTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
-                  }
-                  for (auto&& lastData : fLastHodData) {
-                    auto lastGch     = lastData.Channel;
-                    // auto lastCh      = Hodoscope::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
-                      if (thisIsInBunch)
-                        hBhTdcOffset[ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (tdc - syncTdc));
-                    }
-                  }
-                  for (auto&& lastData : fLastExtData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = ExtinctionDetector::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
-                      if (thisIsInBunch)
-                        hBhTdcOffset [    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
-                      if (IsInBunch(lastData.Tdc - lastSyncTdc))
-                        hExtTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
-                  }
-                  for (auto&& lastData : fLastTcData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = TimingCounter::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
-                      if (thisIsInBunch)
-                        hBhTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
-                      if (IsInBunch(lastData.Tdc - lastSyncTdc))
-                        hTcTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
-                  }
-                  
-                } else {
-
-                  for (auto&& lastData : fLastBhData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = BeamlineHodoscope::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
+              if (fOffsetFromBunch) {
+                const Bool_t thisIsInBunch = IsInBunch(tdc - syncTdc);
+
+                for (auto&& lastData : fLastBhData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = BeamlineHodoscope::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    if (thisIsInBunch)
                       hBhTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    if (IsInBunch(lastData.Tdc - lastSyncTdc))
                       hBhTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
                   }
-                  for (auto&& lastData : fLastHodData) {
-                    auto lastGch     = lastData.Channel;
-                    // auto lastCh      = Hodoscope::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
+                }
+                for (auto&& lastData : fLastHodData) {
+                  auto lastGch     = lastData.Channel;
+                  // auto lastCh      = Hodoscope::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    if (thisIsInBunch)
                       hBhTdcOffset[ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (tdc - syncTdc));
-                    }
                   }
-                  for (auto&& lastData : fLastExtData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = ExtinctionDetector::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
+                }
+                for (auto&& lastData : fLastExtData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = ExtinctionDetector::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    if (thisIsInBunch)
                       hBhTdcOffset [    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    if (IsInBunch(lastData.Tdc - lastSyncTdc))
                       hExtTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
                   }
-                  for (auto&& lastData : fLastTcData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = TimingCounter::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
+                }
+                for (auto&& lastData : fLastTcData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = TimingCounter::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    if (thisIsInBunch)
                       hBhTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    if (IsInBunch(lastData.Tdc - lastSyncTdc))
                       hTcTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
                   }
                 }
-
+                
+              } else {
+
+                for (auto&& lastData : fLastBhData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = BeamlineHodoscope::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    hBhTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    hBhTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
+                  }
+                }
+                for (auto&& lastData : fLastHodData) {
+                  auto lastGch     = lastData.Channel;
+                  // auto lastCh      = Hodoscope::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    hBhTdcOffset[ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (tdc - syncTdc));
+                  }
+                }
+                for (auto&& lastData : fLastExtData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = ExtinctionDetector::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    hBhTdcOffset [    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    hExtTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
+                  }
+                }
+                for (auto&& lastData : fLastTcData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = TimingCounter::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    hBhTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    hTcTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
+                  }
+                }
               }
 
-              fLastBhData.push_back(data);
-
-              if (RemoveOldTdc(&fLastBhData, data) > kHistLimit) {
-                std::cerr << "[error] size of fLastBhData reaches " << kHistLimit << std::endl;
-                return 1;
-              }
+            }
 
-            } else if (Hodoscope::Contains(data.Channel)) {
-              // std::cout << "[debug] hodoscope" << std::endl;
-              const Int_t    ch  = Hodoscope::GetChannel(gch);
-              const Long64_t tdc = data.Tdc;
+            fLastBhData.Push(data);
 
-              ++entriesInMrSyncByDetector[Detectors::Hod];
+            RemoveOldTdc(&fLastBhData, data);
 
-              hHodEntriesByCh   ->Fill(ch);
-              Hodoscope         ::Fill(hHodHitMap, ch);
+          } else if (Hodoscope::Contains(data.Channel)) {
+            // std::cout << "[debug] hodoscope" << std::endl;
+            const Int_t    ch  = Hodoscope::GetChannel(gch);
+            const Long64_t tdc = data.Tdc;
 
-              hHodTdcInSpill[ch]->Fill(time / msec);
-              hHodTdcInSpill_Any->Fill(time / msec);
+            ++entriesInMrSyncByDetector[Detectors::Hod];
 
-              if (syncTdc) {
-                hHodTdcInSync[ch]->Fill(tdc - syncTdc);
-                hHodTdcInSync_Any->Fill(tdc - syncTdc);
-                hHodMountain [ch]->Fill(tdc - syncTdc, time / msec);
-                hHodMountain_Any ->Fill(tdc - syncTdc, time / msec);
+            hHodEntriesByCh   ->Fill(ch);
+            Hodoscope         ::Fill(hHodHitMap, ch);
 
-                if (fOffsetFromBunch) {
-                  // const Bool_t thisIsInBunch = IsInBunch(tdc - syncTdc);
+            hHodTdcInSpill[ch]->Fill(time / msec);
+            hHodTdcInSpill_Any->Fill(time / msec);
 
-                  for (auto&& lastData : fLastBhData) {
-                    auto lastCh      = BeamlineHodoscope::GetChannel(lastData.Channel);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
-                      if (IsInBunch(lastData.Tdc - lastSyncTdc))
-                        hBhTdcOffset[lastCh]->Fill(gch, (tdc - syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
-                  }
-                  for (auto&& lastData : fLastExtData) {
-                    auto lastCh      = ExtinctionDetector::GetChannel(lastData.Channel);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
-                      if (IsInBunch(lastData.Tdc - lastSyncTdc))
-                        hExtTdcOffset[lastCh]->Fill(gch, (tdc - syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
-                  }
-                  for (auto&& lastData : fLastTcData) {
-                    auto lastCh      = TimingCounter::GetChannel(lastData.Channel);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
-                      if (IsInBunch(lastData.Tdc - lastSyncTdc))
-                        hTcTdcOffset[lastCh]->Fill(gch, (tdc - syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
-                  }
+            if (syncTdc) {
+              hHodTdcInSync[ch]->Fill(tdc - syncTdc);
+              hHodTdcInSync_Any->Fill(tdc - syncTdc);
+              hHodMountain [ch]->Fill(tdc - syncTdc, time / msec);
+              hHodMountain_Any ->Fill(tdc - syncTdc, time / msec);
 
-                } else {
+              if (fOffsetFromBunch) {
+                // const Bool_t thisIsInBunch = IsInBunch(tdc - syncTdc);
 
-                  for (auto&& lastData : fLastBhData) {
-                    auto lastCh      = BeamlineHodoscope::GetChannel(lastData.Channel);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
+                for (auto&& lastData : fLastBhData) {
+                  auto lastCh      = BeamlineHodoscope::GetChannel(lastData.Channel);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    if (IsInBunch(lastData.Tdc - lastSyncTdc))
                       hBhTdcOffset[lastCh]->Fill(gch, (tdc - syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
                   }
-                  for (auto&& lastData : fLastExtData) {
-                    auto lastCh      = ExtinctionDetector::GetChannel(lastData.Channel);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
+                }
+                for (auto&& lastData : fLastExtData) {
+                  auto lastCh      = ExtinctionDetector::GetChannel(lastData.Channel);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    if (IsInBunch(lastData.Tdc - lastSyncTdc))
                       hExtTdcOffset[lastCh]->Fill(gch, (tdc - syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
                   }
-                  for (auto&& lastData : fLastTcData) {
-                    auto lastCh      = TimingCounter::GetChannel(lastData.Channel);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
+                }
+                for (auto&& lastData : fLastTcData) {
+                  auto lastCh      = TimingCounter::GetChannel(lastData.Channel);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    if (IsInBunch(lastData.Tdc - lastSyncTdc))
                       hTcTdcOffset[lastCh]->Fill(gch, (tdc - syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
                   }
-
                 }
-              }
 
-              fLastHodData.push_back(data);
-
-              if (RemoveOldTdc(&fLastHodData, data) > kHistLimit) {
-                std::cerr << "[error] size of fLastHodData reaches " << kHistLimit << std::endl;
-                return 1;
-              }
+              } else {
 
-            } else if (ExtinctionDetector::Contains(data.Channel)) {
-              // std::cout << "[debug] extinction detector" << std::endl;
-              const Int_t    ch  = ExtinctionDetector::GetChannel(gch);
-              const Long64_t tdc = data.Tdc;
-
-              ++entriesInMrSyncByDetector[Detectors::Ext];
-
-              hExtEntriesByCh   ->Fill(ch);
-              ExtinctionDetector::Fill(hExtHitMap, ch);
-
-              hExtTdcInSpill[ch]->Fill(time / msec);
-              hExtTdcInSpill_Any->Fill(time / msec);
-
-              if (syncTdc) {
-                hExtTdcInSync[ch]->Fill(tdc - syncTdc);
-                hExtTdcInSync_Any->Fill(tdc - syncTdc);
-                hExtMountain [ch]->Fill(tdc - syncTdc, time / msec);
-                hExtMountain_Any ->Fill(tdc - syncTdc, time / msec);
-
-                if (fOffsetFromBunch) {
-                  const Bool_t thisIsInBunch = IsInBunch(tdc - syncTdc);
-
-                  for (auto&& lastData : fLastBhData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = BeamlineHodoscope::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
-                      if (thisIsInBunch)
-                        hExtTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
-                      if (IsInBunch(lastData.Tdc - lastSyncTdc))
-                        hBhTdcOffset [lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
+                for (auto&& lastData : fLastBhData) {
+                  auto lastCh      = BeamlineHodoscope::GetChannel(lastData.Channel);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    hBhTdcOffset[lastCh]->Fill(gch, (tdc - syncTdc) - (lastData.Tdc - lastSyncTdc));
                   }
-                  for (auto&& lastData : fLastHodData) {
-                    auto lastGch     = lastData.Channel;
-                    // auto lastCh      = Hodoscope::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
-                      if (thisIsInBunch)
-                        hExtTdcOffset[ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (tdc - syncTdc));
-                    }
-                  }
-                  for (auto&& lastData : fLastExtData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = ExtinctionDetector::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
-                      if (thisIsInBunch)
-                        hExtTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
-                      if (IsInBunch(lastData.Tdc - lastSyncTdc))
-                        hExtTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
+                }
+                for (auto&& lastData : fLastExtData) {
+                  auto lastCh      = ExtinctionDetector::GetChannel(lastData.Channel);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    hExtTdcOffset[lastCh]->Fill(gch, (tdc - syncTdc) - (lastData.Tdc - lastSyncTdc));
                   }
-                  for (auto&& lastData : fLastTcData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = TimingCounter::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
-                      if (thisIsInBunch)
-                        hExtTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
-                      if (IsInBunch(lastData.Tdc - lastSyncTdc))
-                        hTcTdcOffset [lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
+                }
+                for (auto&& lastData : fLastTcData) {
+                  auto lastCh      = TimingCounter::GetChannel(lastData.Channel);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    hTcTdcOffset[lastCh]->Fill(gch, (tdc - syncTdc) - (lastData.Tdc - lastSyncTdc));
                   }
+                }
+
+              }
+            }
+
+            fLastHodData.Push(data);
+
+            RemoveOldTdc(&fLastHodData, data);
 
-                } else {
+          } else if (ExtinctionDetector::Contains(data.Channel)) {
+            // std::cout << "[debug] extinction detector" << std::endl;
+            const Int_t    ch  = ExtinctionDetector::GetChannel(gch);
+            const Long64_t tdc = data.Tdc;
 
-                  for (auto&& lastData : fLastBhData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = BeamlineHodoscope::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
+            ++entriesInMrSyncByDetector[Detectors::Ext];
+
+            hExtEntriesByCh   ->Fill(ch);
+            ExtinctionDetector::Fill(hExtHitMap, ch);
+
+            hExtTdcInSpill[ch]->Fill(time / msec);
+            hExtTdcInSpill_Any->Fill(time / msec);
+
+            if (syncTdc) {
+              hExtTdcInSync[ch]->Fill(tdc - syncTdc);
+              hExtTdcInSync_Any->Fill(tdc - syncTdc);
+              hExtMountain [ch]->Fill(tdc - syncTdc, time / msec);
+              hExtMountain_Any ->Fill(tdc - syncTdc, time / msec);
+
+              if (fOffsetFromBunch) {
+                const Bool_t thisIsInBunch = IsInBunch(tdc - syncTdc);
+
+                for (auto&& lastData : fLastBhData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = BeamlineHodoscope::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    if (thisIsInBunch)
                       hExtTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    if (IsInBunch(lastData.Tdc - lastSyncTdc))
                       hBhTdcOffset [lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
                   }
-                  for (auto&& lastData : fLastHodData) {
-                    auto lastGch     = lastData.Channel;
-                    // auto lastCh      = Hodoscope::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
+                }
+                for (auto&& lastData : fLastHodData) {
+                  auto lastGch     = lastData.Channel;
+                  // auto lastCh      = Hodoscope::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    if (thisIsInBunch)
                       hExtTdcOffset[ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (tdc - syncTdc));
-                    }
                   }
-                  for (auto&& lastData : fLastExtData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = ExtinctionDetector::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
+                }
+                for (auto&& lastData : fLastExtData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = ExtinctionDetector::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    if (thisIsInBunch)
                       hExtTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    if (IsInBunch(lastData.Tdc - lastSyncTdc))
                       hExtTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
                   }
-                  for (auto&& lastData : fLastTcData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = TimingCounter::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
+                }
+                for (auto&& lastData : fLastTcData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = TimingCounter::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    if (thisIsInBunch)
                       hExtTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    if (IsInBunch(lastData.Tdc - lastSyncTdc))
                       hTcTdcOffset [lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
                   }
-
                 }
-              }
 
-              if (RemoveOldTdc(&fLastExtData, data) > kHistLimit) {
-                std::cerr << "[error] size of fLastExtData reaches " << kHistLimit << std::endl;
-                return 1;
-              }
-              fLastExtData.push_back(data);
-
-            } else if (TimingCounter::Contains(data.Channel)) {
-              // std::cout << "[debug] timing counter" << std::endl;
-              const Int_t ch = TimingCounter::GetChannel(gch);
-              const Long64_t tdc = data.Tdc;
-
-              ++entriesInMrSyncByDetector[Detectors::Tc1 + ch];
-
-              hTcTdcInSpill[ch]->Fill(time / msec);
-
-              if (syncTdc) {
-                hTcTdcInSync[ch]->Fill(tdc - syncTdc);
-                hTcMountain [ch]->Fill(tdc - syncTdc, time / msec);
-
-                if (fOffsetFromBunch) {
-                  const Bool_t thisIsInBunch = IsInBunch(tdc - syncTdc);
-
-                  for (auto&& lastData : fLastBhData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = BeamlineHodoscope::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
-                      if (thisIsInBunch)
-                        hTcTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
-                      if (IsInBunch(lastData.Tdc - lastSyncTdc))
-                        hBhTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
+              } else {
+
+                for (auto&& lastData : fLastBhData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = BeamlineHodoscope::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    hExtTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    hBhTdcOffset [lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
                   }
-                  for (auto&& lastData : fLastHodData) {
-                    auto lastGch     = lastData.Channel;
-                    // auto lastCh      = Hodoscope::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
-                      if (thisIsInBunch)
-                        hTcTdcOffset[ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (tdc - syncTdc));
-                    }
+                }
+                for (auto&& lastData : fLastHodData) {
+                  auto lastGch     = lastData.Channel;
+                  // auto lastCh      = Hodoscope::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    hExtTdcOffset[ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (tdc - syncTdc));
                   }
-                  for (auto&& lastData : fLastExtData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = ExtinctionDetector::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
-                      if (thisIsInBunch)
-                        hTcTdcOffset [    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
-                      if (IsInBunch(lastData.Tdc - lastSyncTdc))
-                        hExtTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
+                }
+                for (auto&& lastData : fLastExtData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = ExtinctionDetector::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    hExtTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    hExtTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
                   }
-                  for (auto&& lastData : fLastTcData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = TimingCounter::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
-                      if (thisIsInBunch)
-                        hTcTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
-                      if (IsInBunch(lastData.Tdc - lastSyncTdc))
-                        hTcTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
+                }
+                for (auto&& lastData : fLastTcData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = TimingCounter::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    hExtTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    hTcTdcOffset [lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
                   }
+                }
 
-                } else {
-                
-                  for (auto&& lastData : fLastBhData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = BeamlineHodoscope::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
+              }
+            }
+
+            RemoveOldTdc(&fLastExtData, data);
+            fLastExtData.Push(data);
+
+          } else if (TimingCounter::Contains(data.Channel)) {
+            // std::cout << "[debug] timing counter" << std::endl;
+            const Int_t ch = TimingCounter::GetChannel(gch);
+            const Long64_t tdc = data.Tdc;
+
+            ++entriesInMrSyncByDetector[Detectors::Tc1 + ch];
+
+            hTcTdcInSpill[ch]->Fill(time / msec);
+
+            if (syncTdc) {
+              hTcTdcInSync[ch]->Fill(tdc - syncTdc);
+              hTcMountain [ch]->Fill(tdc - syncTdc, time / msec);
+
+              if (fOffsetFromBunch) {
+                const Bool_t thisIsInBunch = IsInBunch(tdc - syncTdc);
+
+                for (auto&& lastData : fLastBhData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = BeamlineHodoscope::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    if (thisIsInBunch)
                       hTcTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    if (IsInBunch(lastData.Tdc - lastSyncTdc))
                       hBhTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
                   }
-                  for (auto&& lastData : fLastHodData) {
-                    auto lastGch     = lastData.Channel;
-                    // auto lastCh      = Hodoscope::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
+                }
+                for (auto&& lastData : fLastHodData) {
+                  auto lastGch     = lastData.Channel;
+                  // auto lastCh      = Hodoscope::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    if (thisIsInBunch)
                       hTcTdcOffset[ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (tdc - syncTdc));
-                    }
                   }
-                  for (auto&& lastData : fLastExtData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = ExtinctionDetector::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
+                }
+                for (auto&& lastData : fLastExtData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = ExtinctionDetector::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    if (thisIsInBunch)
                       hTcTdcOffset [    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    if (IsInBunch(lastData.Tdc - lastSyncTdc))
                       hExtTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
                   }
-                  for (auto&& lastData : fLastTcData) {
-                    auto lastGch     = lastData.Channel;
-                    auto lastCh      = TimingCounter::GetChannel(lastGch);
-                    auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
-                    if (lastSyncTdc) {
+                }
+                for (auto&& lastData : fLastTcData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = TimingCounter::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    if (thisIsInBunch)
                       hTcTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    if (IsInBunch(lastData.Tdc - lastSyncTdc))
                       hTcTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
-                    }
                   }
-
                 }
-              }
-
-              fLastTcData.push_back(data);
 
-              if (RemoveOldTdc(&fLastTcData, data) > kHistLimit) {
-                std::cerr << "[error] size of fLastTcData reaches " << kHistLimit << std::endl;
-                return 1;
-              }
-
-            } else if (Veto::Contains(data.Channel)) {
-              // std::cout << "[debug] veto" << std::endl;
-              const Int_t ch = Veto::GetChannel(gch);
-              const Long64_t tdc = data.Tdc;
-
-              hVetoTdcInSpill[ch]->Fill(time / msec);
+              } else {
+              
+                for (auto&& lastData : fLastBhData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = BeamlineHodoscope::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    hTcTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    hBhTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
+                  }
+                }
+                for (auto&& lastData : fLastHodData) {
+                  auto lastGch     = lastData.Channel;
+                  // auto lastCh      = Hodoscope::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    hTcTdcOffset[ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (tdc - syncTdc));
+                  }
+                }
+                for (auto&& lastData : fLastExtData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = ExtinctionDetector::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    hTcTdcOffset [    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    hExtTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
+                  }
+                }
+                for (auto&& lastData : fLastTcData) {
+                  auto lastGch     = lastData.Channel;
+                  auto lastCh      = TimingCounter::GetChannel(lastGch);
+                  auto lastSyncTdc = fLastMrSyncData[lastData.Board].Tdc;
+                  if (lastSyncTdc) {
+                    hTcTdcOffset[    ch]->Fill(lastGch, (lastData.Tdc - lastSyncTdc) - (         tdc -     syncTdc));
+                    hTcTdcOffset[lastCh]->Fill(    gch, (         tdc -     syncTdc) - (lastData.Tdc - lastSyncTdc));
+                  }
+                }
 
-              if (syncTdc) {
-                hVetoTdcInSync[ch]->Fill(tdc - syncTdc);
-                hVetoMountain [ch]->Fill(tdc - syncTdc, time / msec);
               }
+            }
 
-            } else if (MrSync::Contains(data.Channel)) {
-              // std::cout << "[debug] mrsync" << std::endl;
-              const Int_t ch = MrSync::GetChannel(gch);
+            fLastTcData.Push(data);
 
-              hMrSyncTdcInSpill[ch]->Fill(time / msec);
+            RemoveOldTdc(&fLastTcData, data);
 
-              decltype(fLastMrSyncData)::const_iterator itr;
-              if ((itr = fLastMrSyncData.find(data.Board)) != fLastMrSyncData.end()) {
-                if (itr->second.Tdc) {
-                  hMrSyncInterval [data.Board]->Fill(data.Tdc - itr->second.Tdc);
-                  hMrSyncInterval2[data.Board]->Fill(data.Tdc - itr->second.Tdc, data.Time / msec);
-                }
-              }
+          } else if (Veto::Contains(data.Channel)) {
+            // std::cout << "[debug] veto" << std::endl;
+            const Int_t ch = Veto::GetChannel(gch);
+            const Long64_t tdc = data.Tdc;
 
-              fLastMrSyncData[board] = data;
+            hVetoTdcInSpill[ch]->Fill(time / msec);
 
-            } else if (EventMatch::Contains(gch)) {
-              const Int_t ch = EventMatch::GetChannel(gch);
+            if (syncTdc) {
+              hVetoTdcInSync[ch]->Fill(tdc - syncTdc);
+              hVetoMountain [ch]->Fill(tdc - syncTdc, time / msec);
+            }
 
-              hEvmTdcInSpill[ch]->Fill(time / msec);
+          } else if (MrSync::Contains(data.Channel)) {
+            // std::cout << "[debug] mrsync" << std::endl;
+            const Int_t ch = MrSync::GetChannel(gch);
 
-            } else {
-              // std::cout << "[debug] skip others" << std::endl;
-              continue;
+            hMrSyncTdcInSpill[ch]->Fill(time / msec);
 
+            decltype(fLastMrSyncData)::const_iterator itr;
+            if ((itr = fLastMrSyncData.find(data.Board)) != fLastMrSyncData.end()) {
+              if (itr->second.Tdc) {
+                hMrSyncInterval [data.Board]->Fill(data.Tdc - itr->second.Tdc);
+                hMrSyncInterval2[data.Board]->Fill(data.Tdc - itr->second.Tdc, time / msec);
+              }
             }
-          }
 
-          for (std::size_t gch = 0; gch < Detectors::NofChannels; ++gch) {
-            hEntriesInMrSyncByCh->Fill(gch, entriesInMrSyncByCh[gch]);
-            entriesInMrSyncByCh[gch] = 0;
-          }
-
-          hExtEntriesInMrSyncInSpill->Fill(fLastMrSyncData.begin()->second.Time / msec, entriesInMrSyncByDetector[Detectors::Ext]);
-          for (std::size_t detector = 0; detector < Detectors::NofTypes; ++detector) {
-            hEntriesInMrSyncByDetector->Fill(detector, entriesInMrSyncByDetector[detector]);
-            entriesInMrSyncByDetector[detector] = 0;
-          }
+            fLastMrSyncData[board] = data;
 
-        }
+          } else if (EventMatch::Contains(gch)) {
+            const Int_t ch = EventMatch::GetChannel(gch);
 
-        // std::cout << "[debug] check end of spill" << std::endl;
-        // Check end of spill
-        if (reader->IsSpillEnded()) {
-          std::cout << "[info] end of spill" << std::endl;
+            hEvmTdcInSpill[ch]->Fill(time / msec);
 
-          // Calc spill summary
-          CalcEntries();
-          CalcMrSyncInterval();
-          CalcTdcOffsets();
+          } else {
+            // std::cout << "[debug] skip others" << std::endl;
+            continue;
 
-          // Fill spill summary
-          if (fSpillTree) {
-            fSpillTree->Fill();
           }
+        }
 
-          reader->ClearLastSpill();
-          // std::cout << "[debug] Throw away first mr sync" << std::endl;
-          // Throw away first mr sync
-          reader->Read(tdcDataInMrSync);
-          tdcDataInMrSync.clear();
+        for (std::size_t gch = 0; gch < Detectors::NofChannels; ++gch) {
+          hEntriesInMrSyncByCh->Fill(gch, entriesInMrSyncByCh[gch]);
+          entriesInMrSyncByCh[gch] = 0;
+        }
 
-          if (!reader->IsFileEnded()) {
-            fSpillData.SetDate(reader->GetDate());
-            fSpillData.EMCount = reader->GetEMCount();
-          }
+        hExtEntriesInMrSyncInSpill->Fill(fHitsInMrSync.GetTime(fLastMrSyncData.begin()->second) / msec, entriesInMrSyncByDetector[Detectors::Ext]);
+        for (std::size_t detector = 0; detector < Detectors::NofTypes; ++detector) {
+          hEntriesInMrSyncByDetector->Fill(detector, entriesInMrSyncByDetector[detector]);
+          entriesInMrSyncByDetector[detector] = 0;
         }
 
-        // std::cout << "[debug] check end of file" << std::endl;
-        // Check end of file
-        if (reader->IsFileEnded()) {
-          std::cout << "[info] end of file" << std::endl;
+      }
 
-          // Get projections
-          for (Int_t xbin = 1, nbinsx = hExtHitMap->GetNbinsX(); xbin <= nbinsx; ++xbin) {
-            hExtEntriesByChBottom ->SetBinContent(xbin, hExtHitMap->GetBinContent(xbin, 1));
-            hExtEntriesByChCenter1->SetBinContent(xbin, hExtHitMap->GetBinContent(xbin, 2));
-            hExtEntriesByChCenter2->SetBinContent(xbin, hExtHitMap->GetBinContent(xbin, 3));
-            hExtEntriesByChTop    ->SetBinContent(xbin, hExtHitMap->GetBinContent(xbin, 4));
-            hExtEntriesByChBottom ->SetBinError  (xbin, hExtHitMap->GetBinError  (xbin, 1));
-            hExtEntriesByChCenter1->SetBinError  (xbin, hExtHitMap->GetBinError  (xbin, 2));
-            hExtEntriesByChCenter2->SetBinError  (xbin, hExtHitMap->GetBinError  (xbin, 3));
-            hExtEntriesByChTop    ->SetBinError  (xbin, hExtHitMap->GetBinError  (xbin, 4));
-          }
+      return 0;
+    }
 
-          break;
-        }
-      }
+    void HistGenerator::FillSpillSummary() {
+      // Calc spill summary
+      CalcEntries();
+      CalcMrSyncInterval();
+      CalcTdcOffsets();
 
-      const clock_t stopClock = clock();
-      std::cout << "time: " << (double)(stopClock - startClock) / CLOCKS_PER_SEC << " sec\n";
+      // Fill spill summary
+      if (fSpillTree) {
+        fSpillTree->Fill();
+      }
+    }
 
-      return 0;
+    void HistGenerator::FillProjections() {
+      // Get projections
+      for (Int_t xbin = 1, nbinsx = hExtHitMap->GetNbinsX(); xbin <= nbinsx; ++xbin) {
+        hExtEntriesByChBottom ->SetBinContent(xbin, hExtHitMap->GetBinContent(xbin, 1));
+        hExtEntriesByChCenter1->SetBinContent(xbin, hExtHitMap->GetBinContent(xbin, 2));
+        hExtEntriesByChCenter2->SetBinContent(xbin, hExtHitMap->GetBinContent(xbin, 3));
+        hExtEntriesByChTop    ->SetBinContent(xbin, hExtHitMap->GetBinContent(xbin, 4));
+        hExtEntriesByChBottom ->SetBinError  (xbin, hExtHitMap->GetBinError  (xbin, 1));
+        hExtEntriesByChCenter1->SetBinError  (xbin, hExtHitMap->GetBinError  (xbin, 2));
+        hExtEntriesByChCenter2->SetBinError  (xbin, hExtHitMap->GetBinError  (xbin, 3));
+        hExtEntriesByChTop    ->SetBinError  (xbin, hExtHitMap->GetBinError  (xbin, 4));
+      }
     }
 
     void HistGenerator::CalcEntries() {
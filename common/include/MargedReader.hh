@@ -3,6 +3,11 @@
 
 #include <iostream>
 #include <fstream>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
 
 #include "TROOT.h"
 #include "TSystem.h"
@@ -30,28 +35,386 @@ namespace Extinction {
 
   namespace Analyzer {
 
+    // Hits of a board ordered by (tdc, channel), as Tag_t { 0, tdc, channel } of SortedTdcData_t.
+    // Each board stream is nearly time ordered, so data is appended at the back in most cases
+    // and consumed from the front without node allocations.
+    class TdcBuffer_t {
+    private:
+      std::vector<TdcHit_t> fData;
+      std::size_t           fHead = 0;
+
+      static inline Bool_t Less(const TdcHit_t& data1, const TdcHit_t& data2) {
+        return data1.Tdc != data2.Tdc ? data1.Tdc < data2.Tdc : data1.Channel < data2.Channel;
+      }
+
+    public:
+      using iterator = std::vector<TdcHit_t>::iterator;
+
+      inline iterator    begin() { return fData.begin() + fHead; }
+      inline iterator    end  () { return fData.end(); }
+      inline std::size_t size () const { return fData.size() - fHead; }
+      inline Bool_t      empty() const { return fData.size() == fHead; }
+
+      // Data of the same tdc and channel is dropped, as std::map::emplace does
+      inline void Insert(const TdcHit_t& data) {
+        if (empty() || Less(fData.back(), data)) {
+          fData.push_back(data);
+          return;
+        }
+        const iterator pos = std::upper_bound(begin(), end(), data, Less);
+        if (pos != begin() && !Less(*(pos - 1), data)) {
+          return;
+        }
+        fData.insert(pos, data);
+      }
+
+      inline iterator Find(const TdcHit_t& data) {
+        const iterator pos = std::lower_bound(begin(), end(), data, Less);
+        return (pos != end() && !Less(data, *pos)) ? pos : end();
+      }
+
+      inline void Erase(iterator last) {
+        fHead = last - fData.begin();
+        if (fHead == fData.size()) {
+          Clear();
+        } else if (fHead >= 4096 && 2 * fHead >= fData.size()) {
+          fData.erase(fData.begin(), fData.begin() + fHead);
+          fHead = 0;
+        }
+      }
+
+      inline void Clear() {
+        fData.clear();
+        fHead = 0;
+      }
+    };
+
+    // Decoded entry of a board tree
+    struct EntryData_t {
+      enum : Int_t {
+            Ok,
+            End,     // entry reaches number of entries
+            Broken,  // TTree::GetEntry returned 0
+      };
+      Int_t                Status;
+      Long64_t             Entry;
+      Int_t                Spill;
+      Bool_t               IsFooter;
+      Bool_t               IsData;
+      ULong64_t            Date;
+      Int_t                EMCount;
+      std::vector<TdcData> Data;
+
+      void Read(Int_t board, ITdcDataProvider* provider, TTree* tree, Long64_t entry, Long64_t entries) {
+        Data.clear();
+        Entry = entry;
+        if (entry >= entries) {
+          Status = End;
+          return;
+        } else if (!tree->GetEntry(entry)) {
+          Status = Broken;
+          return;
+        }
+        Status   = Ok;
+        Spill    = provider->GetSpill();
+        IsFooter = provider->IsFooter();
+        IsData   = provider->IsData();
+        Date     = provider->GetDate();
+        EMCount  = provider->GetEMCount();
+        if (Spill >= 0 && !IsFooter) {
+          provider->AppendTdcData(board, Data);
+        }
+      }
+    };
+
+    // Opens, reads and decodes a board tree on a worker thread.
+    // Entries are handed to the reader in chunks ending at a mr sync or a footer,
+    // at most depth chunks are read ahead.
+    class EntryPrefetcher_t {
+    private:
+      struct Chunk_t {
+        std::vector<EntryData_t> Entries;
+        std::size_t              Size = 0;
+      };
+
+      static constexpr std::size_t          kMaxChunkEntries = 1024;
+
+      enum : Int_t {
+            kOpening = -1,
+            kOpened,
+            kNotOpened,
+      };
+
+      Int_t                                 fBoard    = -1;
+      ITdcDataProvider*                     fProvider = nullptr;
+      std::string                           fFilename;
+      std::string                           fTreename;
+      Int_t                                 fOpenStatus = kOpening;
+      Long64_t                              fFirst    = 0;
+      Long64_t                              fLast     = 0;
+      Long64_t                              fEntries  = 0;
+
+      std::thread                           fThread;
+      std::mutex                            fMutex;
+      std::condition_variable               fFilled;
+      std::condition_variable               fFreed;
+      std::vector<std::unique_ptr<Chunk_t>> fChunks;
+      std::deque<Chunk_t*>                  fQueue;
+      std::vector<Chunk_t*>                 fFree;
+      Bool_t                                fStop     = false;
+
+      Chunk_t*                              fCurrent  = nullptr;
+      std::size_t                           fIndex    = 0;
+
+    public:
+      ~EntryPrefetcher_t() {
+        Stop();
+      }
+
+      // Reads entries in [first, last) or to the end if last < 0.
+      // Returns non-zero if the file or the tree is not opened on the worker
+      Int_t Start(Int_t board, ITdcDataProvider* provider, const std::string& filename, const std::string& treename,
+                  Long64_t first, Long64_t last, std::size_t depth) {
+        Stop();
+        fBoard      = board;
+        fProvider   = provider;
+        fFilename   = filename;
+        fTreename   = treename;
+        fOpenStatus = kOpening;
+        fFirst      = first;
+        fLast       = last;
+        fEntries    = 0;
+        fStop       = false;
+        fCurrent  = nullptr;
+        fIndex    = 0;
+        fChunks.clear();
+        fQueue .clear();
+        fFree  .clear();
+        // One more chunk is held by the reader
+        for (std::size_t i = 0; i < depth + 1; ++i) {
+          fChunks.emplace_back(new Chunk_t());
+          fFree.push_back(fChunks.back().get());
+        }
+        fThread = std::thread(&EntryPrefetcher_t::Run, this);
+
+        std::unique_lock<std::mutex> lock(fMutex);
+        fFilled.wait(lock, [this] { return fOpenStatus != kOpening; });
+        return fOpenStatus;
+      }
+
+      inline Long64_t GetEntries() const {
+        return fEntries;
+      }
+
+      void Stop() {
+        if (fThread.joinable()) {
+          {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fStop = true;
+          }
+          fFreed.notify_all();
+          fThread.join();
+        }
+      }
+
+      // Valid until the next call, the end of the tree is returned repeatedly
+      EntryData_t* Next() {
+        if (fCurrent && fIndex == fCurrent->Size && fCurrent->Entries[fIndex - 1].Status != EntryData_t::Ok) {
+          return &fCurrent->Entries[fIndex - 1];
+        } else if (!fCurrent || fIndex == fCurrent->Size) {
+          std::unique_lock<std::mutex> lock(fMutex);
+          if (fCurrent) {
+            fFree.push_back(fCurrent);
+            fFreed.notify_one();
+          }
+          fFilled.wait(lock, [this] { return !fQueue.empty(); });
+          fCurrent = fQueue.front();
+          fQueue.pop_front();
+          fIndex   = 0;
+        }
+        return &fCurrent->Entries[fIndex++];
+      }
+
+    private:
+      void Run() {
+        // File and tree are owned by this thread
+        TFile* file = new TFile(fFilename.data(), "READ");
+        TTree* tree = nullptr;
+        Int_t  status = kOpened;
+        if (!file->IsOpen()) {
+          std::cerr << "[error] input file is not opened, " << fFilename << std::endl;
+          status = kNotOpened;
+        } else if (!(tree = dynamic_cast<TTree*>(file->Get(fTreename.data())))) {
+          std::cerr << "[error] input tree is not found, " << fFilename << " - " << fTreename << std::endl;
+          status = kNotOpened;
+        } else {
+          fEntries = tree->GetEntries();
+          fLast    = fLast < 0 ? fEntries : std::min(fLast, fEntries);
+          fProvider->SetBranchAddress(tree);
+        }
+        {
+          std::lock_guard<std::mutex> lock(fMutex);
+          fOpenStatus = status;
+        }
+        fFilled.notify_all();
+
+        if (status == kOpened) {
+          Prefetch(tree);
+        }
+        file->Close();
+        delete file;
+      }
+
+      void Prefetch(TTree* tree) {
+        for (Long64_t entry = fFirst; ; ) {
+          Chunk_t* chunk = nullptr;
+          {
+            std::unique_lock<std::mutex> lock(fMutex);
+            fFreed.wait(lock, [this] { return fStop || !fFree.empty(); });
+            if (fStop) {
+              return;
+            }
+            chunk = fFree.back();
+            fFree.pop_back();
+          }
+
+          Bool_t ended = false;
+          for (chunk->Size = 0; chunk->Size < kMaxChunkEntries; ) {
+            if (chunk->Entries.size() == chunk->Size) {
+              chunk->Entries.emplace_back();
+            }
+            EntryData_t& data = chunk->Entries[chunk->Size++];
+            data.Read(fBoard, fProvider, tree, entry++, fLast);
+            if (data.Status != EntryData_t::Ok) {
+              ended = true;
+              break;
+            } else if (data.IsFooter ||
+                       std::any_of(data.Data.begin(), data.Data.end(), [](const TdcData& tdc) { return MrSync::Contains(tdc.Channel); })) {
+              break;
+            }
+          }
+
+          {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fQueue.push_back(chunk);
+          }
+          fFilled.notify_one();
+
+          if (ended) {
+            return;
+          }
+        }
+      }
+    };
+
+    // Entry range of a spill in the marged hit tree,
+    // with the spill and date of each board since boards count spills and stamp dates on their own
+    struct MargedSpill_t {
+      static const Int_t kMaxBoards = 128; // TdcHit_t::Board is 8 bit
+
+      Int_t     Spill   = -1; // of the last board read, as MargedReader::GetDate()
+      Int_t     EMCount = -1;
+      ULong64_t Date    =  0; // of the last board read, as MargedReader::GetDate()
+      Long64_t  First   =  0;
+      Long64_t  Last    =  0;
+      Bool_t    Ended   = false; // false if the spill was cut by the end of file
+      Int_t     NofBoards = 0;
+      Int_t     Boards     [kMaxBoards];
+      Int_t     BoardSpills[kMaxBoards];
+      ULong64_t BoardDates [kMaxBoards];
+
+      inline void CreateBranch(TTree* tree) {
+        tree->Branch("spill"  , &Spill      , "spill"   "/I");
+        tree->Branch("emcount", &EMCount    , "emcount" "/I");
+        tree->Branch("date"   , &Date       , "date"    "/l");
+        tree->Branch("first"  , &First      , "first"   "/L");
+        tree->Branch("last"   , &Last       , "last"    "/L");
+        tree->Branch("ended"  , &Ended      , "ended"   "/O");
+        tree->Branch("nboards", &NofBoards  , "nboards" "/I");
+        tree->Branch("boards" ,  Boards     , "boards[nboards]"  "/I");
+        tree->Branch("bspills",  BoardSpills, "bspills[nboards]" "/I");
+        tree->Branch("bdates" ,  BoardDates , "bdates[nboards]"  "/l");
+      }
+
+      inline void SetBranchAddress(TTree* tree) {
+        tree->SetBranchAddress("spill"  , &Spill      );
+        tree->SetBranchAddress("emcount", &EMCount    );
+        tree->SetBranchAddress("date"   , &Date       );
+        tree->SetBranchAddress("first"  , &First      );
+        tree->SetBranchAddress("last"   , &Last       );
+        tree->SetBranchAddress("ended"  , &Ended      );
+        tree->SetBranchAddress("nboards", &NofBoards  );
+        tree->SetBranchAddress("boards" ,  Boards     );
+        tree->SetBranchAddress("bspills",  BoardSpills);
+        tree->SetBranchAddress("bdates" ,  BoardDates );
+      }
+
+      void SetBoards(const BoardMap_t<Int_t>& spills, const BoardMap_t<ULong64_t>& dates) {
+        NofBoards = 0;
+        for (auto&& pair : spills) {
+          if (NofBoards == kMaxBoards) {
+            std::cerr << "[warning] too many boards to be recorded, " << spills.size() << std::endl;
+            break;
+          }
+          const auto date = dates.find(pair.first);
+          Boards     [NofBoards] = pair.first;
+          BoardSpills[NofBoards] = pair.second;
+          BoardDates [NofBoards] = date != dates.end() ? date->second : 0;
+          ++NofBoards;
+        }
+      }
+    };
+
+    // Time ordered merge of board trees.
+    // The merged hits can be written once into a marged hit file, and read back instead of the board trees.
+    // A marged hit file has three trees,
+    //   <treename>       : hits in order of Read(), see TdcHit_t::CreateBranch
+    //   <treename>_spill : entry range of each spill, see MargedSpill_t
+    //   <treename>_board : time per tdc of each board
     class MargedReader {
     public:
+      // Pseudo board of the spill index of a marged hit file, its entry range is a range of spills
+      enum : Int_t { kMargedBoard = -1 };
+
       using TdcOffsets_t = std::map<std::size_t/*globalChannel*/, Long64_t>;
+      using EntryRange_t = std::pair<Long64_t/*first*/, Long64_t/*last*/>;
       
     private:
       ITdcDataProvider*                   fProvider               = nullptr;
 
       BoardMap_t<ITdcDataProvider*>       fProviders;
+      BoardMap_t<std::string>             fIfilenames;
+      std::string                         fItreename;
       BoardMap_t<TFile*>                  fIfiles;
       BoardMap_t<TTree*>                  fItrees;
       BoardMap_t<Long64_t>                fEntrieses;
       BoardMap_t<Long64_t>                fEntries;
       BoardMap_t<Bool_t>                  fSpillEnded;
       BoardMap_t<Bool_t>                  fFileEnded;
-      BoardMap_t<SortedTdcData_t>         fTdcBuffers;
-      BoardMap_t<TdcData>                 fLastMrSync;
-      BoardMap_t<TdcData>                 fNextMrSync;
-      BoardMap_t<TdcData>                 fNext2MrSync;
-      BoardMap_t<std::deque<TdcData>>     fRsvdMrSync;
+      BoardMap_t<TdcBuffer_t>             fTdcBuffers;
+      BoardMap_t<TdcHit_t>                fLastMrSync;
+      BoardMap_t<TdcHit_t>                fNextMrSync;
+      BoardMap_t<TdcHit_t>                fNext2MrSync;
+      BoardMap_t<std::deque<TdcHit_t>>    fRsvdMrSync;
+      EntryData_t                         fEntryData;
+      std::size_t                         fPrefetchDepth          = 0;
+      BoardMap_t<std::unique_ptr<EntryPrefetcher_t>> fPrefetchers;
+
+      // K-way merge of boards in Tag_t order
+      struct MergeCursor_t {
+        TdcBuffer_t::iterator Current;
+        TdcBuffer_t::iterator End;
+        std::size_t           Order;
+      };
+      std::vector<MergeCursor_t>          fMergeHeap;
+      HitBatch_t                          fMergedHits;
+      std::vector<TdcData>                fMergedTdcData;
 
       std::size_t                         fReadCount              =  0;
       ULong64_t                           fDate                   =  0;
+      Int_t                               fSpill                  = -1;
+      BoardMap_t<ULong64_t>               fDates;
+      BoardMap_t<Int_t>                   fSpills;
       Int_t                               fEMCount                = -1;
       Int_t                               fMrSyncCount            =  0;
       clock_t                             fLastClock;
@@ -61,8 +424,23 @@ namespace Extinction {
       std::size_t                         fRefExtChannel          = ExtinctionDetector::NofChannels / 2;
       TdcOffsets_t                        fTdcOffsets;
 
+      // Marged hit file output
       TFile*                              fMargedFile             = nullptr;
       TTree*                              fMargedTree             = nullptr;
+      TTree*                              fMargedSpillTree        = nullptr;
+      TdcHit_t                            fMargedHit;
+      MargedSpill_t                       fMargedSpill;
+
+      // Marged hit file input
+      std::string                         fMargedFilename;
+      std::string                         fMargedTreename;
+      TFile*                              fMargedIfile            = nullptr;
+      TTree*                              fMargedItree            = nullptr;
+      std::vector<MargedSpill_t>          fMargedSpills;
+      BoardMap_t<Double_t>                fMargedTimePerTdc;
+      std::size_t                         fMargedSpillIndex       = 0;
+      std::size_t                         fMargedSpillEnd         = 0;
+      Long64_t                            fMargedEntry            = 0;
 
     public:
       MargedReader(ITdcDataProvider* provider);
@@ -75,21 +453,50 @@ namespace Extinction {
       }
       inline Double_t      GetMrSyncTdcOffset() const { return fMrSyncTdcOffset; }
 
+      // Read ahead on one thread per board, 0 reads on the caller thread
+      inline void          SetPrefetchDepth(std::size_t depth) {
+        std::cout << "SetPrefetchDepth ... " << depth << std::endl;
+        fPrefetchDepth = depth;
+        if (fPrefetchDepth) {
+          ROOT::EnableThreadSafety();
+        }
+      }
+      inline std::size_t   GetPrefetchDepth() const { return fPrefetchDepth; }
+
       Int_t                LoadTdcOffsets(const std::string& ffilename);
       Int_t                AddTdcOffsets(const std::string& ffilename);
 
-      void                 InitializeMargedTree(const std::string& filename, const std::string& treename = "mtree");
+      // Marged hit file output, MargeTree() reads all spills of the opened board trees into the file
+      Int_t                InitializeMargedTree(const std::string& filename, const std::string& treename = "mtree");
+      Int_t                MargeTree();
       void                 WriteMargedTree();
 
       // File operation
       Int_t                Open(BoardMap_t<ITdcDataProvider*>  providers,
                                 const BoardMap_t<std::string>& ifilenames,
                                 const std::string&             itreename);
+      // Reads hits from a marged hit file, the tdc offsets of the merge are used
+      Int_t                OpenMarged(const std::string& filename, const std::string& treename = "mtree");
+      inline void          SetMargedInput(const std::string& filename, const std::string& treename = "mtree") {
+        fMargedFilename = filename;
+        fMargedTreename = treename;
+      }
+      inline Bool_t        IsMargedInput() const { return !fMargedFilename.empty(); }
+      inline const std::string& GetMargedFilename() const { return fMargedFilename; }
+      inline const std::string& GetMargedTreename() const { return fMargedTreename; }
 
+      // Appends hits in the next mr sync, in order of Tag_t
+      Int_t                Read(HitBatch_t& hitsInMrSync);
+      Int_t                Read(std::vector<TdcData>& tdcDataInMrSync);
       Int_t                Read(SortedTdcData_t& tdcDataInMrSync);
 
       Int_t                Close();
 
+      // Spill parallel reading
+      MargedReader*        CloneSettings() const;
+      Int_t                BuildSpillIndex(std::vector<BoardMap_t<EntryRange_t>>& spillIndex);
+      Int_t                SetEntryRanges(const BoardMap_t<EntryRange_t>& ranges);
+
       void                 ClearLastSpill();
 
       // Status getters
@@ -111,6 +518,7 @@ namespace Extinction {
 
     private:
       Int_t ReadUntillNextMrSync(Int_t board);
+      Int_t ReadMarged(HitBatch_t& hitsInMrSync);
 
 
       template <typename T, typename V>
@@ -160,21 +568,66 @@ namespace Extinction {
       return fTdcOffsets.size();
     }
 
-    void MargedReader::InitializeMargedTree(const std::string& filename, const std::string& treename) {
+    Int_t MargedReader::InitializeMargedTree(const std::string& filename, const std::string& treename) {
       std::cout << "Initialize marged tree" << std::endl;
 
       fMargedFile = new TFile(filename.data(), "RECREATE");
       if (!fMargedFile->IsOpen()) {
         std::cout << "[error] marged file is not opened, " << filename << std::endl;
-        return;
+        delete fMargedFile; fMargedFile = nullptr;
+        return 1;
       }
 
       fMargedTree = new TTree(treename.data(), "Marged tree");
+      fMargedHit.CreateBranch(fMargedTree);
+      fMargedTree->AutoSave();
+
+      fMargedSpillTree = new TTree((treename + "_spill").data(), "Spills of marged tree");
+      fMargedSpill.CreateBranch(fMargedSpillTree);
+
+      return 0;
+    }
 
+    Int_t MargedReader::MargeTree() {
+      if (!fMargedTree) {
+        std::cout << "[error] output marged file is not initialized" << std::endl;
+        return 1;
+      }
+
+      const clock_t startClock = clock();
 
+      while (true) {
+        const Long64_t first = fMargedTree->GetEntries();
+        for (fMergedHits.Clear(); Read(fMergedHits); fMergedHits.Clear()) {
+          for (std::size_t i = 0, n = fMergedHits.Size(); i < n; ++i) {
+            fMargedHit = fMergedHits.GetHit(i);
+            fMargedTree->Fill();
+          }
+        }
 
+        const Long64_t last = fMargedTree->GetEntries();
+        if (first < last || IsSpillEnded()) {
+          fMargedSpill.Spill   = fSpill;
+          fMargedSpill.EMCount = fEMCount;
+          fMargedSpill.Date    = fDate;
+          fMargedSpill.First   = first;
+          fMargedSpill.Last    = last;
+          fMargedSpill.Ended   = IsSpillEnded();
+          fMargedSpill.SetBoards(fSpills, fDates);
+          fMargedSpillTree->Fill();
+          std::cout << "[info] marged spill " << fSpill << ", " << last - first << " hits" << std::endl;
+        }
 
-      fMargedTree->AutoSave();
+        if (IsFileEnded()) {
+          break;
+        }
+        ClearLastSpill();
+      }
+
+      const clock_t stopClock = clock();
+      std::cout << "time: " << (double)(stopClock - startClock) / CLOCKS_PER_SEC << " sec\n";
+
+      return 0;
     }
 
     void MargedReader::WriteMargedTree() {
@@ -187,8 +640,26 @@ namespace Extinction {
       }
 
       fMargedFile->cd();
-      fMargedTree->Write();
+
+      Int_t    board;
+      Double_t timePerTdc;
+      TTree* boardTree = new TTree((std::string(fMargedTree->GetName()) + "_board").data(), "Boards of marged tree");
+      boardTree->Branch("board"     , &board     , "board"      "/I");
+      boardTree->Branch("timePerTdc", &timePerTdc, "timePerTdc" "/D");
+      for (auto&& pair : fProviders) {
+        board      = pair.first;
+        timePerTdc = pair.second->GetTimePerTdc();
+        boardTree->Fill();
+      }
+
+      fMargedTree     ->Write();
+      fMargedSpillTree->Write();
+      boardTree       ->Write();
       fMargedFile->Close();
+      delete fMargedFile;
+      fMargedFile      = nullptr;
+      fMargedTree      = nullptr;
+      fMargedSpillTree = nullptr;
     }
 
     Int_t MargedReader::Open(BoardMap_t<ITdcDataProvider*>  providers,
@@ -214,10 +685,26 @@ namespace Extinction {
       fProviders = providers;
 
       std::cout << "Open file" << std::endl;
+      fItreename = itreename;
       for (auto&& pair : ifilenames) {
         const Int_t       board     = pair.first;
         const std::string ifilename = pair.second;
         std::cout << " - " << ifilename << std::endl;
+        fIfilenames[board] = ifilename;
+
+        if (fPrefetchDepth) {
+          // The file is opened on the worker which reads it
+          auto& prefetcher = fPrefetchers[board];
+          if (!prefetcher) {
+            prefetcher.reset(new EntryPrefetcher_t());
+          }
+          if (prefetcher->Start(board, fProviders[board], ifilename, itreename, 0, -1, fPrefetchDepth)) {
+            return 1;
+          }
+          fEntrieses[board] = prefetcher->GetEntries();
+          std::cout << " + " << fEntrieses[board] << std::endl;
+          continue;
+        }
 
         fIfiles[board] = new TFile(ifilename.data(), "READ");
         if (!fIfiles[board]->IsOpen()) {
@@ -254,9 +741,195 @@ namespace Extinction {
       return 0;
     }
 
+    Int_t MargedReader::OpenMarged(const std::string& filename, const std::string& treename) {
+      std::cout << "Open marged file" << std::endl;
+      std::cout << " - " << filename << std::endl;
+      if (fTdcOffsets.size() || fMrSyncTdcOffset) {
+        std::cout << "[info] tdc offsets of the marged file are used" << std::endl;
+      }
+
+      fMargedFilename = filename;
+      fMargedTreename = treename;
+      fMargedIfile    = new TFile(filename.data(), "READ");
+      if (!fMargedIfile->IsOpen()) {
+        std::cerr << "[error] input file is not opened, " << filename << std::endl;
+        return 1;
+      }
+
+      fMargedItree     = dynamic_cast<TTree*>(fMargedIfile->Get(treename.data()));
+      TTree* spillTree = dynamic_cast<TTree*>(fMargedIfile->Get((treename + "_spill").data()));
+      TTree* boardTree = dynamic_cast<TTree*>(fMargedIfile->Get((treename + "_board").data()));
+      if (!fMargedItree || !spillTree || !boardTree) {
+        std::cerr << "[error] marged tree is not found, " << filename << " - " << treename << std::endl;
+        return 1;
+      }
+      fMargedHit.SetBranchAddress(fMargedItree);
+      std::cout << " + " << fMargedItree->GetEntries() << std::endl;
+
+      MargedSpill_t spill;
+      spill.SetBranchAddress(spillTree);
+      fMargedSpills.clear();
+      for (Long64_t entry = 0, entries = spillTree->GetEntries(); entry < entries; ++entry) {
+        spillTree->GetEntry(entry);
+        fMargedSpills.push_back(spill);
+      }
+      std::cout << " = " << fMargedSpills.size() << " spills" << std::endl;
+
+      Int_t    board;
+      Double_t timePerTdc;
+      boardTree->SetBranchAddress("board"     , &board     );
+      boardTree->SetBranchAddress("timePerTdc", &timePerTdc);
+      fMargedTimePerTdc.clear();
+      fSpillEnded      .clear();
+      fFileEnded       .clear();
+      for (Long64_t entry = 0, entries = boardTree->GetEntries(); entry < entries; ++entry) {
+        boardTree->GetEntry(entry);
+        fMargedTimePerTdc[board] = timePerTdc;
+        fSpillEnded      [board] = false;
+        fFileEnded       [board] = false;
+      }
+
+      std::cout << "Initialize parameters" << std::endl;
+      ClearLastSpill();
+      FillToSeconds(&fFileEnded, false);
+      fMargedSpillIndex = 0;
+      fMargedSpillEnd   = fMargedSpills.size();
+      fMargedEntry      = fMargedSpills.size() ? fMargedSpills.front().First : 0;
+
+      return 0;
+    }
+
+    MargedReader* MargedReader::CloneSettings() const {
+      MargedReader* reader = new MargedReader(fProvider);
+      reader->fPrefetchDepth   = fPrefetchDepth;
+      reader->fMrSyncTdcOffset = fMrSyncTdcOffset;
+      reader->fRefExtChannel   = fRefExtChannel;
+      reader->fTdcOffsets      = fTdcOffsets;
+      reader->fMargedFilename  = fMargedFilename;
+      reader->fMargedTreename  = fMargedTreename;
+      return reader;
+    }
+
+    Int_t MargedReader::BuildSpillIndex(std::vector<BoardMap_t<EntryRange_t>>& spillIndex) {
+      spillIndex.clear();
+
+      if (fMargedItree) {
+        for (std::size_t spill = 0; spill < fMargedSpills.size(); ++spill) {
+          spillIndex.push_back({ { kMargedBoard, { (Long64_t)spill, (Long64_t)spill + 1 } } });
+        }
+        return spillIndex.size();
+      }
+
+      for (auto&& pair : fPrefetchers) {
+        pair.second->Stop();
+      }
+
+      // Spill k of a board is the entries after footer k-1 up to footer k,
+      // entries after the last footer make an unterminated spill
+      for (auto&& pair : fIfilenames) {
+        const Int_t       board    = pair.first;
+        ITdcDataProvider* provider = fProviders[board];
+        const Long64_t    entries  = fEntrieses[board];
+
+        // Files of prefetch are opened by the workers, the index is read from another one
+        TFile* ifile = nullptr;
+        TTree* itree = nullptr;
+        if (fPrefetchDepth) {
+          ifile = new TFile(pair.second.data(), "READ");
+          itree = ifile->IsOpen() ? dynamic_cast<TTree*>(ifile->Get(fItreename.data())) : nullptr;
+          if (!itree) {
+            std::cerr << "[error] input tree is not found, " << pair.second << " - " << fItreename << std::endl;
+            delete ifile;
+            return -1;
+          }
+          provider->SetBranchAddress(itree);
+        } else {
+          itree = fItrees[board];
+        }
+
+        itree->SetBranchStatus("*"    , 0);
+        itree->SetBranchStatus("type" , 1);
+        itree->SetBranchStatus("spill", 1);
+
+        std::size_t spill = 0;
+        Long64_t    first = 0;
+        for (Long64_t entry = 0; entry < entries; ++entry) {
+          if (!itree->GetEntry(entry)) {
+            break;
+          } else if (provider->GetSpill() >= 0 && provider->IsFooter()) {
+            if (spillIndex.size() <= spill) {
+              spillIndex.resize(spill + 1);
+            }
+            spillIndex[spill++][board] = { first, entry + 1 };
+            first = entry + 1;
+          }
+        }
+        if (first < entries) {
+          if (spillIndex.size() <= spill) {
+            spillIndex.resize(spill + 1);
+          }
+          spillIndex[spill][board] = { first, entries };
+        }
+
+        itree->SetBranchStatus("*", 1);
+
+        if (ifile) {
+          ifile->Close();
+          delete ifile;
+        }
+      }
+
+      // Boards without the spill are read as already ended
+      for (auto&& ranges : spillIndex) {
+        for (auto&& pair : fEntrieses) {
+          if (!ranges.count(pair.first)) {
+            ranges[pair.first] = { pair.second, pair.second };
+          }
+        }
+      }
+
+      return spillIndex.size();
+    }
+
+    Int_t MargedReader::SetEntryRanges(const BoardMap_t<EntryRange_t>& ranges) {
+      for (auto&& pair : fPrefetchers) {
+        pair.second->Stop();
+      }
+
+      ClearLastSpill();
+
+      if (fMargedItree) {
+        const EntryRange_t& range = ranges.at(kMargedBoard);
+        fMargedSpillIndex = range.first;
+        fMargedSpillEnd   = std::min<std::size_t>(range.second, fMargedSpills.size());
+        fMargedEntry      = fMargedSpillIndex < fMargedSpillEnd ? fMargedSpills[fMargedSpillIndex].First : 0;
+        FillToSeconds(&fFileEnded, false);
+        return 0;
+      }
+
+      for (auto&& pair : ranges) {
+        const Int_t board = pair.first;
+        fEntries  [board] = pair.second.first;
+        fEntrieses[board] = pair.second.second;
+        fFileEnded[board] = false;
+      }
+
+      if (fPrefetchDepth) {
+        for (auto&& pair : ranges) {
+          const Int_t board = pair.first;
+          if (fPrefetchers[board]->Start(board, fProviders[board], fIfilenames[board], fItreename, fEntries[board], fEntrieses[board], fPrefetchDepth)) {
+            return 1;
+          }
+        }
+      }
+
+      return 0;
+    }
+
     Int_t MargedReader::ReadUntillNextMrSync(Int_t board) {
       ITdcDataProvider* provider   = fProviders[board];
       TTree*            itree      = fItrees   [board];
+      EntryPrefetcher_t* prefetcher = fPrefetchDepth ? fPrefetchers[board].get() : nullptr;
       Long64_t&         entry      = fEntries  [board];
       const Long64_t    entries    = fEntrieses[board];
 
@@ -289,12 +962,19 @@ namespace Extinction {
         // }
 
         // std::cout << "[debug] GetEntry" << std::endl;
-        if (entry >= entries) {
+        EntryData_t* current = &fEntryData;
+        if (prefetcher) {
+          current = prefetcher->Next();
+        } else {
+          current->Read(board, provider, itree, entry, entries);
+        }
+
+        if (current->Status == EntryData_t::End) {
           std::cout << "[info] detect file end @ " << board << std::endl;
           fFileEnded[board] = true;
           break;
 
-        } else if (!itree->GetEntry(entry)) {
+        } else if (current->Status == EntryData_t::Broken) {
           std::cout << "[info] detect file end @ " << board << " (TTree::GetEntry)" << std::endl;
           fFileEnded[board] = true;
           break;
@@ -302,43 +982,43 @@ namespace Extinction {
         }
 
         // if (entry >= entries - 3) {
-        //   std::cout << "[debug] spill = " << (Int_t)provider->GetSpill() << std::endl;
-        //   std::cout << "[debug] IsData = " << (Int_t)provider->IsData() << ", IsFooter = " << (Int_t)provider->IsFooter() << std::endl;
+        //   std::cout << "[debug] spill = " << current->Spill << std::endl;
+        //   std::cout << "[debug] IsData = " << (Int_t)current->IsData << ", IsFooter = " << (Int_t)current->IsFooter << std::endl;
         // }
 
         // std::cout << "[debug] Data Check" << std::endl;
-        if (provider->GetSpill() < 0) {
+        if (current->Spill < 0) {
           continue;
 
-        } else if (provider->IsFooter()) {
+        } else if (current->IsFooter) {
           std::cout << "[info] detect spill end @ " << board << std::endl;
           ++entry;
           fSpillEnded[board] = true;
           break;
 
-        } else if (fEMCount != -1 && fEMCount != provider->GetEMCount()) {
-          std::cout << "[error] conflict EMCount, " << fEMCount << " <--> " << provider->GetEMCount() << std::endl;
+        } else if (fEMCount != -1 && fEMCount != current->EMCount) {
+          std::cout << "[error] conflict EMCount, " << fEMCount << " <--> " << current->EMCount << std::endl;
           exit(1);
 
-        } else if (!provider->IsData()) {
-          std::cout << "[info] detect non data entry of " << entry << " @ " << board << std::endl;
-          auto tdcData = provider->GetTdcData(board);
+        } else if (!current->IsData) {
+          std::cout << "[info] detect non data entry of " << current->Entry << " @ " << board << std::endl;
 
           // std::cout << "[debug] data process" << std::endl;
-          for (auto&& data : tdcData) {
+          for (auto&& data : current->Data) {
             // std::cout << "[debug] push data into tdc buffers" << std::endl;
-            Tag_t tag = { 0, data.Tdc, data.Channel };
-            fTdcBuffers[board].emplace_hint(fTdcBuffers[board].end(), tag, data);
+            fTdcBuffers[board].Insert(TdcHit_t(data));
           }
 
         } else {
           // std::cout << "[info] detect data @ " << board << std::endl;
-          fDate        = provider->GetDate();
-          fEMCount     = provider->GetEMCount();
-          auto tdcData = provider->GetTdcData(board);
+          fDate          = current->Date;
+          fSpill         = current->Spill;
+          fDates [board] = current->Date;
+          fSpills[board] = current->Spill;
+          fEMCount       = current->EMCount;
 
           // std::cout << "[debug] data process" << std::endl;
-          for (auto&& data : tdcData) {
+          for (auto&& data : current->Data) {
             if (MrSync::Contains(data.Channel)) {
               // std::cout << "[debug] mr sync " << data.Channel << std::endl;
               data.Tdc -= fMrSyncTdcOffset;
@@ -350,9 +1030,9 @@ namespace Extinction {
                 // const Int_t step = fMrSyncCount <= 1 ? 1 : TMath::Nint(dmsNext / dmsLast);
                 // std::cout << "[debug] step == " << step << std::endl;
                 if (step == 1) {
-                  fNext2MrSync[board] = data;
+                  fNext2MrSync[board] = TdcHit_t(data);
                 } else if (step > 1) {
-                  TdcData rsvdData = data;
+                  TdcHit_t rsvdData(data);
                   const Long64_t dtdc = (rsvdData.Tdc - fNextMrSync[board].Tdc) / step;
                   for (Int_t i = step; i > 1; --i) {
                     fRsvdMrSync[board].push_front(rsvdData);
@@ -362,8 +1042,8 @@ namespace Extinction {
                 } else {
                   std::cout << "[error] detect time inverted mr sync"                                         << std::endl
                             << "   Board               = " << board                                           << std::endl
-                            << "   File                = " << fIfiles[board]->GetName()                       << std::endl
-                            << "   Entry               = " << entry                                           << std::endl
+                            << "   File                = " << fIfilenames[board]                              << std::endl
+                            << "   Entry               = " << current->Entry                                  << std::endl
                             << "   Last (ms0)          = " << fLastMrSync[board].Tdc                          << std::endl
                             << "   Next (ms1)          = " << fNextMrSync[board].Tdc                          << std::endl
                             << "   data (ms2)          = " << data              .Tdc                          << std::endl
@@ -376,10 +1056,10 @@ namespace Extinction {
 
               } else if (fLastMrSync[board].Tdc) {
                 // std::cout << "[debug] get next mrsync" << std::endl;
-                fNextMrSync[board] = data;
+                fNextMrSync[board] = TdcHit_t(data);
               } else {
                 // std::cout << "[debug] get first mrsync" << std::endl;
-                fLastMrSync[board] = data;
+                fLastMrSync[board] = TdcHit_t(data);
               }
 
             } else if (BeamlineHodoscope::Contains(data.Channel)) {
@@ -412,8 +1092,7 @@ namespace Extinction {
             }
 
             // std::cout << "[debug] push data into tdc buffers" << std::endl;
-            Tag_t tag = { 0, data.Tdc, data.Channel };
-            fTdcBuffers[board].emplace_hint(fTdcBuffers[board].end(), tag, data);
+            fTdcBuffers[board].Insert(TdcHit_t(data));
           }
         }
       }
@@ -421,7 +1100,11 @@ namespace Extinction {
       return 0;
     }
 
-    Int_t MargedReader::Read(SortedTdcData_t& tdcDataInMrSync) {
+    Int_t MargedReader::Read(HitBatch_t& hitsInMrSync) {
+      if (fMargedItree) {
+        return ReadMarged(hitsInMrSync);
+      }
+
       ++fMrSyncCount;
 
       for (auto&& pair : fProviders) {
@@ -452,12 +1135,12 @@ namespace Extinction {
             std::cout << "[warning] first mr syncs are so different, "
                       << "min tdc = " << minMrSyncTdc << " @ " << minBoard << ", "
                       << "max tdc = " << maxMrSyncTdc << " @ " << maxBoard << std::endl;
-            auto itr = fTdcBuffers[minBoard].find({ 0, fLastMrSync[minBoard].Tdc, fLastMrSync[minBoard].Channel });
+            auto itr = fTdcBuffers[minBoard].Find(fLastMrSync[minBoard]);
             if (itr == fTdcBuffers[minBoard].end()) {
               std::cerr << "[error] mr sync was not found on removing till incorrect mr sync" << std::endl;
               exit(1);
             }
-            fTdcBuffers[minBoard].erase(fTdcBuffers[minBoard].begin(), ++itr);
+            fTdcBuffers[minBoard].Erase(++itr);
             ReadUntillNextMrSync(minBoard);
           } else {
             std::cout << "[info] first mr syncs are not so different, "
@@ -484,47 +1167,180 @@ namespace Extinction {
         return 0;
       }
 
+      // Boards count spills and stamp dates on their own, the event match number is checked to be common on reading
+      hitsInMrSync.EMCount = fEMCount;
+      for (auto&& pair : fProviders) {
+        const Int_t board = pair.first;
+        hitsInMrSync.SetTimePerTdc(board, pair.second->GetTimePerTdc());
+        hitsInMrSync.SetSpill     (board, fDates[board], fSpills[board]);
+      }
+
       // Extract tdc data
+      fMergeHeap.clear();
+      std::size_t order = 0;
       for (auto&& pair : fProviders) {
-        const Int_t    board      = pair.first;
-        const TdcData& lastMrSync = fLastMrSync[board];
-        const TdcData& nextMrSync = fNextMrSync[board];
-        SortedTdcData_t::iterator itr, end;
-        for (itr = fTdcBuffers[board].begin(), end = fTdcBuffers[board].end(); itr != end; ++itr) {
-          TdcData& data = itr->second;
-          if        (data.Tdc > nextMrSync.Tdc) {
-            break;
-          } else if (data.Tdc > lastMrSync.Tdc) {
-            data.LastMrSyncCount = fMrSyncCount;
-            data.LastMrSyncTdc   = lastMrSync.Tdc;
-            data.NextMrSyncTdc   = nextMrSync.Tdc;
-            data.TdcFromMrSync   = data.Tdc - data.LastMrSyncTdc;
-            const Tag_t tag { data.LastMrSyncCount, data.TdcFromMrSync, data.Channel };
-            tdcDataInMrSync.emplace(tag, data);
-          } else {
-            // Nothing to do
-          }
+        const Int_t     board      = pair.first;
+        const TdcHit_t& lastMrSync = fLastMrSync[board];
+        const TdcHit_t& nextMrSync = fNextMrSync[board];
+        TdcBuffer_t::iterator itr, first, end;
+        for (itr = fTdcBuffers[board].begin(), end = fTdcBuffers[board].end(); itr != end && itr->Tdc <= lastMrSync.Tdc; ++itr) {
+          // Nothing to do
+        }
+        for (first = itr; itr != end && itr->Tdc <= nextMrSync.Tdc; ++itr) {
+          TdcHit_t& data = *itr;
+          data.LastMrSyncCount = fMrSyncCount;
+          data.LastMrSyncTdc   = lastMrSync.Tdc;
+          data.SetNextMrSyncTdc(nextMrSync.Tdc);
         }
-        // std::cout << "[debug] erase buffer" << std::endl;
-        fTdcBuffers[board].erase(fTdcBuffers[board].begin(), itr);
+        if (first != itr) {
+          fMergeHeap.push_back({ first, itr, order });
+        }
+        ++order;
+      }
+
+      // Tdc from mr sync is monotonic in each board, merge them in Tag_t order
+      // On the same tag, data of the former board is kept as std::map::emplace does
+      auto greater =
+        [] (const MergeCursor_t& cursor1, const MergeCursor_t& cursor2) {
+          const TdcHit_t& data1 = *cursor1.Current;
+          const TdcHit_t& data2 = *cursor2.Current;
+          const Long64_t  tdc1  = data1.GetTdcFromMrSync();
+          const Long64_t  tdc2  = data2.GetTdcFromMrSync();
+          if (tdc1          != tdc2         ) { return tdc1          > tdc2;          }
+          if (data1.Channel != data2.Channel) { return data1.Channel > data2.Channel; }
+          return cursor1.Order > cursor2.Order;
+        };
+      std::make_heap(fMergeHeap.begin(), fMergeHeap.end(), greater);
+      const TdcHit_t* last = nullptr;
+      while (!fMergeHeap.empty()) {
+        std::pop_heap(fMergeHeap.begin(), fMergeHeap.end(), greater);
+        MergeCursor_t&  cursor = fMergeHeap.back();
+        const TdcHit_t& data   = *cursor.Current;
+        if (!last ||
+            last->GetTdcFromMrSync() != data.GetTdcFromMrSync() ||
+            last->Channel            != data.Channel) {
+          hitsInMrSync.Push(data);
+          last = &data;
+        }
+        if (++cursor.Current == cursor.End) {
+          fMergeHeap.pop_back();
+        } else {
+          std::push_heap(fMergeHeap.begin(), fMergeHeap.end(), greater);
+        }
+      }
+
+      // std::cout << "[debug] erase buffer" << std::endl;
+      for (auto&& pair : fProviders) {
+        const Int_t     board      = pair.first;
+        const TdcHit_t& nextMrSync = fNextMrSync[board];
+        TdcBuffer_t::iterator itr, end;
+        for (itr = fTdcBuffers[board].begin(), end = fTdcBuffers[board].end(); itr != end && itr->Tdc <= nextMrSync.Tdc; ++itr) {
+          // Nothing to do
+        }
+        fTdcBuffers[board].Erase(itr);
       }
       // std::cout << "[debug] end of read" << std::endl;
 
       return 1;
     }
 
+    // Hits of a mr sync are the run of entries with the same mr sync count
+    Int_t MargedReader::ReadMarged(HitBatch_t& hitsInMrSync) {
+      ++fMrSyncCount;
+
+      if (IsSpillEnded() || IsFileEnded()) {
+        return 0;
+      } else if (fMargedSpillIndex >= fMargedSpillEnd) {
+        std::cout << "[info] file ended" << std::endl;
+        FillToSeconds(&fFileEnded, true);
+        return 0;
+      }
+
+      const MargedSpill_t& spill = fMargedSpills[fMargedSpillIndex];
+      if (fMargedEntry >= spill.Last) {
+        if (spill.Ended) {
+          std::cout << "[info] spill ended" << std::endl;
+          FillToSeconds(&fSpillEnded, true);
+        } else {
+          std::cout << "[info] file ended" << std::endl;
+          FillToSeconds(&fFileEnded, true);
+        }
+        if (++fMargedSpillIndex < fMargedSpillEnd) {
+          fMargedEntry = fMargedSpills[fMargedSpillIndex].First;
+        }
+        return 0;
+      }
+
+      fDate    = spill.Date;
+      fSpill   = spill.Spill;
+      fEMCount = spill.EMCount;
+      hitsInMrSync.EMCount = fEMCount;
+      for (auto&& pair : fMargedTimePerTdc) {
+        hitsInMrSync.SetTimePerTdc(pair.first, pair.second);
+      }
+      for (Int_t i = 0; i < spill.NofBoards; ++i) {
+        fDates [spill.Boards[i]] = spill.BoardDates [i];
+        fSpills[spill.Boards[i]] = spill.BoardSpills[i];
+        hitsInMrSync.SetSpill(spill.Boards[i], spill.BoardDates[i], spill.BoardSpills[i]);
+      }
+
+      fMargedItree->GetEntry(fMargedEntry);
+      fMrSyncCount = fMargedHit.LastMrSyncCount;
+      do {
+        hitsInMrSync.Push(fMargedHit);
+        if (++fMargedEntry >= spill.Last) {
+          break;
+        }
+        fMargedItree->GetEntry(fMargedEntry);
+      } while (fMargedHit.LastMrSyncCount == fMrSyncCount);
+
+      return 1;
+    }
+
+    Int_t MargedReader::Read(std::vector<TdcData>& tdcDataInMrSync) {
+      fMergedHits.Clear();
+      const Int_t ret = Read(fMergedHits);
+      for (std::size_t i = 0, n = fMergedHits.Size(); i < n; ++i) {
+        tdcDataInMrSync.push_back(fMergedHits.GetTdcData(i));
+      }
+      return ret;
+    }
+
+    Int_t MargedReader::Read(SortedTdcData_t& tdcDataInMrSync) {
+      fMergedTdcData.clear();
+      const Int_t ret = Read(fMergedTdcData);
+      for (auto&& data : fMergedTdcData) {
+        const Tag_t tag { data.LastMrSyncCount, data.TdcFromMrSync, data.Channel };
+        tdcDataInMrSync.emplace_hint(tdcDataInMrSync.end(), tag, data);
+      }
+      return ret;
+    }
+
     Int_t MargedReader::Close() {
+      for (auto&& pair : fPrefetchers) {
+        pair.second->Stop();
+      }
+
       std::cout << "Close files" << std::endl;
       for (auto&& pair : fIfiles) {
         pair.second->Close();
       }
+      if (fMargedIfile) {
+        fMargedIfile->Close();
+        delete fMargedIfile;
+        fMargedIfile = nullptr;
+        fMargedItree = nullptr;
+      }
 
       return 0;
     }
 
     void MargedReader::ClearLastSpill() {
-      fTdcBuffers.clear();
+      for (auto&& pair : fTdcBuffers) {
+        pair.second.Clear();
+      }
       fDate        =  0;
+      fSpill       = -1;
       fEMCount     = -1;
       fMrSyncCount =  0;
       fReadFirst   = true;
@@ -533,6 +1349,8 @@ namespace Extinction {
 
       for (auto&& pair : fProviders) {
         const Int_t board = pair.first;
+        fDates      [board] =  0;
+        fSpills     [board] = -1;
         fLastMrSync [board].Clear();
         fNextMrSync [board].Clear();
         fNext2MrSync[board].Clear();
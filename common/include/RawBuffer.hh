@@ -0,0 +1,166 @@
+#ifndef Extinction_RawBuffer_hh
+#define Extinction_RawBuffer_hh
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Rtypes.h"
+#include "GzipReader.hh"
+
+namespace Extinction {
+
+  // Sequential byte source for raw data files.
+  // A regular file is memory-mapped as a whole and walked by pointer,
+  // other inputs (e.g. pipe from std::cin) are read in large blocks.
+  // A ".gz" or ".tar.gz" file is decompressed on a background thread and read in blocks.
+  class RawBuffer {
+  public:
+    static const std::size_t kBlockSize = 16UL * 1024UL * 1024UL;
+
+  private:
+    Int_t                fFd       = -1;
+    UChar_t*             fMapped   = nullptr;
+    UChar_t*             fData     = nullptr;
+    std::size_t          fSize     = 0;
+    std::size_t          fPosition = 0;
+    std::size_t          fOffset   = 0; // file offset of fData[0] (block mode)
+    Bool_t               fEnded    = false;
+    std::vector<UChar_t> fBlock;
+    GzipReader           fGzip;
+
+  public:
+    RawBuffer() = default;
+    RawBuffer(const RawBuffer&) = delete;
+    RawBuffer& operator=(const RawBuffer&) = delete;
+    ~RawBuffer() {
+      Close();
+    }
+
+    Bool_t Open(const std::string& filename) {
+      Close();
+
+      if (GzipReader::IsCompressed(filename)) {
+        if (!fGzip.Open(filename)) {
+          return false;
+        }
+        fBlock.resize(kBlockSize);
+        fData = fBlock.data();
+        return true;
+      } else if (filename == "std::cin") {
+        fFd = STDIN_FILENO;
+      } else if ((fFd = open(filename.data(), O_RDONLY)) < 0) {
+        std::cerr << "[error] file is not opened, " << filename << std::endl;
+        return false;
+      }
+
+      struct stat st;
+      if (fFd != STDIN_FILENO && fstat(fFd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        // Private mapping, so that packet accessors taking non-const pointers never touch the file
+        void* addr = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fFd, 0);
+        if (addr != MAP_FAILED) {
+          madvise(addr, st.st_size, MADV_SEQUENTIAL);
+          fMapped = fData = (UChar_t*)addr;
+          fSize   = st.st_size;
+          return true;
+        }
+        std::cerr << "[warning] mmap failed, fall back to block read, " << filename << std::endl;
+      }
+
+      fBlock.resize(kBlockSize);
+      fData = fBlock.data();
+      return true;
+    }
+
+    void Close() {
+      if (fMapped) {
+        munmap(fMapped, fSize);
+      }
+      if (fFd >= 0 && fFd != STDIN_FILENO) {
+        close(fFd);
+      }
+      fFd       = -1;
+      fMapped   = nullptr;
+      fData     = nullptr;
+      fSize     = 0;
+      fPosition = 0;
+      fOffset   = 0;
+      fEnded    = false;
+      fBlock.clear();
+      fGzip.Close();
+    }
+
+    inline Bool_t IsOpen() const {
+      return fFd >= 0 || fGzip.IsOpen();
+    }
+
+    inline Bool_t IsMapped() const {
+      return fMapped;
+    }
+
+    // Returns pointer to next n bytes and advances, or nullptr if less than n bytes remain.
+    // The pointer is valid until the next call in block mode.
+    inline UChar_t* Take(std::size_t n) {
+      if (fSize - fPosition < n && (fMapped || !Fill(n))) {
+        fPosition = fSize;
+        return nullptr;
+      }
+      UChar_t* p = fData + fPosition;
+      fPosition += n;
+      return p;
+    }
+
+    // Returns pointer to the buffered bytes without advancing, at least n bytes are ensured.
+    // The number of available bytes is set to length, nullptr if less than n bytes remain.
+    inline UChar_t* Peek(std::size_t n, std::size_t& length) {
+      if (fSize - fPosition < n && (fMapped || !Fill(n))) {
+        length = 0;
+        return nullptr;
+      }
+      length = fSize - fPosition;
+      return fData + fPosition;
+    }
+
+    // Advances n bytes which were obtained by Peek()
+    inline void Skip(std::size_t n) {
+      fPosition += n;
+    }
+
+    // Byte offset from the beginning of the file
+    inline std::size_t Tell() const {
+      return fOffset + fPosition;
+    }
+
+  private:
+    Bool_t Fill(std::size_t n) {
+      if (fEnded) {
+        return false;
+      }
+
+      const std::size_t rest = fSize - fPosition;
+      std::memmove(fBlock.data(), fBlock.data() + fPosition, rest);
+      fOffset  += fPosition;
+      fPosition = 0;
+      fSize     = rest;
+
+      while (fSize < n) {
+        const ssize_t length = fGzip.IsOpen() ?
+          (ssize_t)fGzip.Read(fBlock.data() + fSize, fBlock.size() - fSize) :
+          read(fFd, fBlock.data() + fSize, fBlock.size() - fSize);
+        if (length <= 0) {
+          fEnded = true;
+          return false;
+        }
+        fSize += length;
+      }
+      return true;
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef Extinction_RawFileStream_hh
+#define Extinction_RawFileStream_hh
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include "GzipReader.hh"
+
+namespace Extinction {
+
+  // Stream buffer over GzipReader, sequential read only
+  class GzipStreamBuf : public std::streambuf {
+  private:
+    GzipReader        fReader;
+    std::vector<char> fBuffer;
+
+  public:
+    Bool_t Open(const std::string& filename) {
+      fBuffer.resize(64 * 1024);
+      setg(fBuffer.data(), fBuffer.data(), fBuffer.data());
+      return fReader.Open(filename);
+    }
+
+    void Close() {
+      fReader.Close();
+      setg(nullptr, nullptr, nullptr);
+    }
+
+    inline Bool_t IsOpen() const {
+      return fReader.IsOpen();
+    }
+
+  protected:
+    virtual int_type underflow() override {
+      if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+      }
+      const std::size_t n = fReader.Read(fBuffer.data(), fBuffer.size());
+      if (n == 0) {
+        return traits_type::eof();
+      }
+      setg(fBuffer.data(), fBuffer.data(), fBuffer.data() + n);
+      return traits_type::to_int_type(*gptr());
+    }
+  };
+
+  // Stream buffer following a file still being written.
+  // At the current end of file, underflow waits for appended bytes until isFinished() returns true,
+  // so a packet is never cut in the middle and the reader sees end of file only when the writer has finished.
+  class TailStreamBuf : public std::streambuf {
+  private:
+    std::FILE*               fFile = nullptr;
+    std::vector<char>        fBuffer;
+    std::function<Bool_t()>  fIsFinished;
+    std::function<void()>    fOnWait;
+    std::chrono::milliseconds fInterval { 100 };
+
+  public:
+    ~TailStreamBuf() {
+      Close();
+    }
+
+    Bool_t Open(const std::string&             filename,
+                const std::function<Bool_t()>& isFinished,
+                const std::function<void()>&   onWait   = nullptr,
+                std::chrono::milliseconds      interval = std::chrono::milliseconds(100)) {
+      Close();
+      fFile = std::fopen(filename.data(), "rb");
+      if (!fFile) {
+        return false;
+      }
+      fBuffer.resize(64 * 1024);
+      setg(fBuffer.data(), fBuffer.data(), fBuffer.data());
+      fIsFinished = isFinished;
+      fOnWait     = onWait;
+      fInterval   = interval;
+      return true;
+    }
+
+    void Close() {
+      if (fFile) {
+        std::fclose(fFile);
+        fFile = nullptr;
+      }
+      setg(nullptr, nullptr, nullptr);
+    }
+
+    inline Bool_t IsOpen() const {
+      return fFile;
+    }
+
+  protected:
+    virtual int_type underflow() override {
+      if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+      }
+      while (true) {
+        // Check before reading, bytes written just before the writer finished are still read here
+        const Bool_t      finished = !fIsFinished || fIsFinished();
+        const std::size_t n        = std::fread(fBuffer.data(), 1, fBuffer.size(), fFile);
+        if (n) {
+          setg(fBuffer.data(), fBuffer.data(), fBuffer.data() + n);
+          return traits_type::to_int_type(*gptr());
+        } else if (finished || std::ferror(fFile)) {
+          return traits_type::eof();
+        }
+        std::clearerr(fFile);
+        if (fOnWait) {
+          fOnWait();
+        }
+        std::this_thread::sleep_for(fInterval);
+      }
+    }
+  };
+
+  // Drop-in replacement of std::ifstream for raw data files, which also reads ".gz" and ".tar.gz" transparently.
+  // A compressed file can not be sought.
+  class RawFileStream : public std::istream {
+  private:
+    std::filebuf  fFileBuf;
+    GzipStreamBuf fGzipBuf;
+    TailStreamBuf fTailBuf;
+
+  public:
+    RawFileStream() : std::istream(nullptr) {
+    }
+    explicit RawFileStream(const std::string& filename) : RawFileStream() {
+      open(filename);
+    }
+
+    void open(const std::string& filename) {
+      close();
+      if (GzipReader::IsCompressed(filename)) {
+        if (fGzipBuf.Open(filename)) {
+          rdbuf(&fGzipBuf);
+          return;
+        }
+      } else if (fFileBuf.open(filename, std::ios::in | std::ios::binary)) {
+        rdbuf(&fFileBuf);
+        return;
+      }
+      setstate(std::ios::failbit);
+    }
+
+    // Follow a growing file, see TailStreamBuf. A compressed file is read as a finished file.
+    void open(const std::string&             filename,
+              const std::function<Bool_t()>& isFinished,
+              const std::function<void()>&   onWait = nullptr) {
+      if (GzipReader::IsCompressed(filename)) {
+        open(filename);
+        return;
+      }
+      close();
+      if (fTailBuf.Open(filename, isFinished, onWait)) {
+        rdbuf(&fTailBuf);
+        return;
+      }
+      setstate(std::ios::failbit);
+    }
+
+    void close() {
+      rdbuf(nullptr);
+      fFileBuf.close();
+      fGzipBuf.Close();
+      fTailBuf.Close();
+    }
+
+    inline bool is_open() const {
+      return fFileBuf.is_open() || fGzipBuf.IsOpen() || fTailBuf.IsOpen();
+    }
+
+    inline Bool_t IsFollowing() const {
+      return fTailBuf.IsOpen();
+    }
+
+    inline Bool_t IsCompressed() const {
+      return fGzipBuf.IsOpen();
+    }
+  };
+
+}
+
+#endif
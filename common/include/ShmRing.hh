@@ -0,0 +1,337 @@
+#ifndef Extinction_ShmRing_hh
+#define Extinction_ShmRing_hh
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <cstring>
+#include <cerrno>
+#include <new>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Rtypes.h"
+
+namespace Extinction {
+
+  // Raw data ring buffer in POSIX shared memory, "/<name>" is created by the daq and attached read-only by monitors.
+  // The writer never waits for readers. A reader which falls more than the ring size behind drops the overwritten
+  // bytes and resumes at the next packet boundary, packets are fixed size units counted from the head of the stream.
+  // A reader sees end of stream when the writer closes, exits without closing, or a new writer takes the name over.
+  struct ShmRingHeader_t {
+    static constexpr const char* kMagic   = "EXTSHMRG";
+    static const     UInt_t      kVersion = 1;
+
+    char                   Magic[8];
+    UInt_t                 Version;
+    UInt_t                 UnitSize;
+    ULong64_t              Capacity;      // bytes of data area
+    std::atomic<ULong64_t> WritePosition; // bytes written since the start of the stream
+    std::atomic<ULong64_t> WriteReserve;  // end of the bytes being written, ahead of WritePosition during a write
+    std::atomic<UInt_t>    Closed;        // set when the writer has finished
+    Int_t                  WriterPid;     // process of the writer
+  };
+
+  class ShmRingWriter {
+  private:
+    std::string      fName;
+    ShmRingHeader_t* fHeader = nullptr;
+    char*            fData   = nullptr;
+    std::size_t      fMapSize = 0;
+
+  public:
+    ShmRingWriter() = default;
+    ShmRingWriter(const ShmRingWriter&) = delete;
+    ShmRingWriter& operator=(const ShmRingWriter&) = delete;
+    ~ShmRingWriter() {
+      Close();
+      Unmap();
+    }
+
+    Bool_t Open(const std::string& name, std::size_t capacity, UInt_t unitSize) {
+      Close();
+      Unmap();
+      shm_unlink(name.data());
+      const int fd = shm_open(name.data(), O_CREAT | O_EXCL | O_RDWR, 0644);
+      if (fd < 0) {
+        std::cerr << "[error] shared memory is not created, " << name << std::endl;
+        return false;
+      }
+      const std::size_t mapSize = sizeof(ShmRingHeader_t) + capacity;
+      if (ftruncate(fd, mapSize) < 0) {
+        std::cerr << "[error] shared memory is not allocated, " << name << std::endl;
+        close(fd);
+        shm_unlink(name.data());
+        return false;
+      }
+      void* map = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      close(fd);
+      if (map == MAP_FAILED) {
+        std::cerr << "[error] shared memory is not mapped, " << name << std::endl;
+        shm_unlink(name.data());
+        return false;
+      }
+
+      fName    = name;
+      fMapSize = mapSize;
+      fHeader  = new (map) ShmRingHeader_t();
+      fData    = (char*)map + sizeof(ShmRingHeader_t);
+      std::memcpy(fHeader->Magic, ShmRingHeader_t::kMagic, sizeof(fHeader->Magic));
+      fHeader->Version   = ShmRingHeader_t::kVersion;
+      fHeader->UnitSize  = unitSize;
+      fHeader->Capacity  = capacity;
+      fHeader->WriterPid = getpid();
+      fHeader->WritePosition.store(0, std::memory_order_relaxed);
+      fHeader->WriteReserve .store(0, std::memory_order_relaxed);
+      fHeader->Closed   .store(0, std::memory_order_release);
+      return true;
+    }
+
+    // Readers which are still attached see end of stream, the name is removed for new readers.
+    // The mapping is kept until destruction, so that an error path on any thread may close while another one writes.
+    void Close() {
+      if (fHeader && !fHeader->Closed.exchange(1, std::memory_order_acq_rel)) {
+        shm_unlink(fName.data());
+      }
+    }
+
+    inline Bool_t IsOpen() const {
+      return fHeader && !fHeader->Closed.load(std::memory_order_acquire);
+    }
+
+    void Write(const void* data, std::size_t size) {
+      if (!fHeader) {
+        return;
+      }
+      const ULong64_t   capacity = fHeader->Capacity;
+      const char*       src      = (const char*)data;
+      ULong64_t         position = fHeader->WritePosition.load(std::memory_order_relaxed);
+      if (size > capacity) {
+        // Only the tail survives anyway
+        src      += size - capacity;
+        position += size - capacity;
+        size      = capacity;
+      }
+      const std::size_t offset   = position % capacity;
+      const std::size_t first    = std::min<std::size_t>(size, capacity - offset);
+      fHeader->WriteReserve.store(position + size, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      std::memcpy(fData + offset, src, first);
+      std::memcpy(fData, src + first, size - first);
+      fHeader->WritePosition.store(position + size, std::memory_order_release);
+    }
+
+  private:
+    void Unmap() {
+      if (fHeader) {
+        munmap(fHeader, fMapSize);
+        fHeader = nullptr;
+        fData   = nullptr;
+      }
+    }
+  };
+
+  class ShmRingReader {
+  private:
+    std::string            fName;
+    ino_t                  fInode    = 0;
+    const ShmRingHeader_t* fHeader   = nullptr;
+    const char*            fData     = nullptr;
+    std::size_t            fMapSize  = 0;
+    ULong64_t              fPosition = 0;
+    ULong64_t              fDropped  = 0;
+
+  public:
+    ShmRingReader() = default;
+    ShmRingReader(const ShmRingReader&) = delete;
+    ShmRingReader& operator=(const ShmRingReader&) = delete;
+    ~ShmRingReader() {
+      Close();
+    }
+
+    // Reading starts from the latest data
+    Bool_t Open(const std::string& name) {
+      Close();
+      const int fd = shm_open(name.data(), O_RDONLY, 0);
+      if (fd < 0) {
+        std::cerr << "[error] shared memory is not opened, " << name << std::endl;
+        return false;
+      }
+      struct stat st;
+      if (fstat(fd, &st) < 0 || (std::size_t)st.st_size < sizeof(ShmRingHeader_t)) {
+        std::cerr << "[error] invalid shared memory, " << name << std::endl;
+        close(fd);
+        return false;
+      }
+      void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      close(fd);
+      if (map == MAP_FAILED) {
+        std::cerr << "[error] shared memory is not mapped, " << name << std::endl;
+        return false;
+      }
+
+      fName    = name;
+      fInode   = st.st_ino;
+      fHeader  = (const ShmRingHeader_t*)map;
+      fData    = (const char*)map + sizeof(ShmRingHeader_t);
+      fMapSize = st.st_size;
+      if (std::memcmp(fHeader->Magic, ShmRingHeader_t::kMagic, sizeof(fHeader->Magic)) ||
+          fHeader->Version != ShmRingHeader_t::kVersion ||
+          sizeof(ShmRingHeader_t) + fHeader->Capacity > fMapSize) {
+        std::cerr << "[error] invalid shared memory, " << name << std::endl;
+        Close();
+        return false;
+      }
+      fPosition = Align(fHeader->WritePosition.load(std::memory_order_acquire));
+      fDropped  = 0;
+      return true;
+    }
+
+    void Close() {
+      if (fHeader) {
+        munmap((void*)fHeader, fMapSize);
+        fHeader = nullptr;
+        fData   = nullptr;
+      }
+    }
+
+    inline Bool_t IsOpen() const {
+      return fHeader;
+    }
+
+    inline Bool_t IsClosed() const {
+      return fHeader->Closed.load(std::memory_order_acquire);
+    }
+
+    // The writer exited without closing, or the name was removed or taken over by a new writer
+    Bool_t IsAbandoned() const {
+      if (kill(fHeader->WriterPid, 0) < 0 && errno == ESRCH) {
+        return true;
+      }
+      const int fd = shm_open(fName.data(), O_RDONLY, 0);
+      if (fd < 0) {
+        return true;
+      }
+      struct stat st;
+      const Bool_t replaced = fstat(fd, &st) < 0 || st.st_ino != fInode;
+      close(fd);
+      return replaced;
+    }
+
+    inline ULong64_t GetDroppedBytes() const {
+      return fDropped;
+    }
+
+    // Copy up to size bytes of whole packets, returns 0 if no new data.
+    // A drop never splits a packet since every read ends at a packet boundary.
+    std::size_t Read(void* data, std::size_t size) {
+      const ULong64_t capacity = fHeader->Capacity;
+      const ULong64_t written  = fHeader->WritePosition.load(std::memory_order_acquire);
+      if (written <= fPosition) {
+        return 0;
+      } else if (written - fPosition > capacity) {
+        Drop(written);
+      }
+
+      const UInt_t unit = fHeader->UnitSize ? fHeader->UnitSize : 1;
+      size = std::min<std::size_t>(size, written - fPosition) / unit * unit;
+      if (size == 0) {
+        return 0;
+      }
+      const std::size_t offset = fPosition % capacity;
+      const std::size_t first  = std::min<std::size_t>(size, capacity - offset);
+      std::memcpy((char*)data, fData + offset, first);
+      std::memcpy((char*)data + first, fData, size - first);
+
+      // The writer may have overwritten the copied bytes meanwhile
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const ULong64_t reserved = fHeader->WriteReserve.load(std::memory_order_relaxed);
+      if (reserved - fPosition > capacity) {
+        Drop(reserved);
+        return 0;
+      }
+      fPosition += size;
+      return size;
+    }
+
+  private:
+    inline ULong64_t Align(ULong64_t position) const {
+      const UInt_t unit = fHeader->UnitSize ? fHeader->UnitSize : 1;
+      return (position + unit - 1) / unit * unit;
+    }
+
+    void Drop(ULong64_t written) {
+      // Resume at half of the ring behind the writer, not to be overtaken again at once
+      const ULong64_t position = Align(written - fHeader->Capacity / 2);
+      fDropped  += position - fPosition;
+      fPosition  = position;
+    }
+  };
+
+  // Stream buffer over ShmRingReader. Underflow waits for new data until the writer closes or is gone, or isFinished() returns true.
+  class ShmRingStreamBuf : public std::streambuf {
+  private:
+    ShmRingReader            fReader;
+    std::vector<char>        fBuffer;
+    std::function<Bool_t()>  fIsFinished;
+    std::function<void()>    fOnWait;
+
+  public:
+    Bool_t Open(const std::string&             name,
+                const std::function<Bool_t()>& isFinished = nullptr,
+                const std::function<void()>&   onWait     = nullptr) {
+      fBuffer.resize(64 * 1024);
+      setg(fBuffer.data(), fBuffer.data(), fBuffer.data());
+      fIsFinished = isFinished;
+      fOnWait     = onWait;
+      return fReader.Open(name);
+    }
+
+    void Close() {
+      fReader.Close();
+      setg(nullptr, nullptr, nullptr);
+    }
+
+    inline Bool_t IsOpen() const {
+      return fReader.IsOpen();
+    }
+
+    inline ULong64_t GetDroppedBytes() const {
+      return fReader.GetDroppedBytes();
+    }
+
+  protected:
+    virtual int_type underflow() override {
+      if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+      }
+      // Once the writer is found finished, read what it left once more before end of stream
+      for (Bool_t closed = false; ; ) {
+        const std::size_t n = fReader.Read(fBuffer.data(), fBuffer.size());
+        if (n) {
+          setg(fBuffer.data(), fBuffer.data(), fBuffer.data() + n);
+          return traits_type::to_int_type(*gptr());
+        } else if (closed || (fIsFinished && fIsFinished())) {
+          return traits_type::eof();
+        }
+        closed = fReader.IsClosed() || fReader.IsAbandoned();
+        if (closed) {
+          continue;
+        }
+        if (fOnWait) {
+          fOnWait();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef Extinction_SpillIndex_hh
+#define Extinction_SpillIndex_hh
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include "Rtypes.h"
+
+namespace Extinction {
+
+  // Byte range and summary of a spill in a raw data file
+  struct SpillIndexEntry_t {
+    Long64_t  HeaderOffset = -1; // offset of the spill header
+    Long64_t  FooterOffset = -1; // offset just after the spill footer
+    Int_t     Spill        = -1;
+    Int_t     EMCount      = -1;
+    Int_t     WRCount      = -1; // -1 if the format has no WR count
+    Int_t     Reserved     =  0;
+    ULong64_t Date         =  0;
+  };
+
+  // Spill index sidecar of a raw data file, "<raw filename>.idx".
+  // The file is a 16 byte file header followed by fixed size entries in host byte order,
+  // entries are appended and flushed one by one, so a partial index of a running daq is readable.
+  class SpillIndex {
+  public:
+    static constexpr const char* kMagic   = "EXTSPIDX";
+    static const     UInt_t      kVersion = 1;
+
+  private:
+    FILE* fFile = nullptr;
+
+  public:
+    SpillIndex() = default;
+    SpillIndex(const SpillIndex&) = delete;
+    SpillIndex& operator=(const SpillIndex&) = delete;
+    ~SpillIndex() {
+      Close();
+    }
+
+    static std::string GetFilename(const std::string& rawFilename) {
+      return rawFilename + ".idx";
+    }
+
+    Bool_t Open(const std::string& filename) {
+      Close();
+      if ((fFile = fopen(filename.data(), "wb")) == nullptr) {
+        std::cerr << "[error] spill index is not opened, " << filename << std::endl;
+        return false;
+      }
+      const UInt_t version   = kVersion;
+      const UInt_t entrySize = sizeof(SpillIndexEntry_t);
+      fwrite(kMagic    , sizeof(char), 8, fFile);
+      fwrite(&version  , sizeof(UInt_t), 1, fFile);
+      fwrite(&entrySize, sizeof(UInt_t), 1, fFile);
+      fflush(fFile);
+      return true;
+    }
+
+    inline Bool_t IsOpen() const {
+      return fFile;
+    }
+
+    void Write(const SpillIndexEntry_t& entry) {
+      if (fFile) {
+        fwrite(&entry, sizeof(SpillIndexEntry_t), 1, fFile);
+        fflush(fFile);
+      }
+    }
+
+    void Close() {
+      if (fFile) {
+        fclose(fFile);
+        fFile = nullptr;
+      }
+    }
+
+    static Bool_t Read(const std::string& filename, std::vector<SpillIndexEntry_t>& entries) {
+      entries.clear();
+      FILE* file = fopen(filename.data(), "rb");
+      if (!file) {
+        return false;
+      }
+
+      char   magic[8];
+      UInt_t version = 0, entrySize = 0;
+      if (fread(magic     , sizeof(char)  , 8, file) != 8 ||
+          fread(&version  , sizeof(UInt_t), 1, file) != 1 ||
+          fread(&entrySize, sizeof(UInt_t), 1, file) != 1 ||
+          std::memcmp(magic, kMagic, 8) || version != kVersion || entrySize != sizeof(SpillIndexEntry_t)) {
+        std::cerr << "[error] invalid spill index, " << filename << std::endl;
+        fclose(file);
+        return false;
+      }
+
+      for (SpillIndexEntry_t entry; fread(&entry, sizeof(SpillIndexEntry_t), 1, file) == 1; ) {
+        entries.push_back(entry);
+      }
+      fclose(file);
+      return true;
+    }
+  };
+
+}
+
+#endif
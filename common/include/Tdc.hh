@@ -2,6 +2,9 @@
 #define Extinction_Tdc_hh
 
 #include <vector>
+#include <map>
+#include <cstdint>
+#include <type_traits>
 #include "TTree.h"
 #include "TMath.h"
 #include "Units.hh"
@@ -216,11 +219,400 @@ namespace Extinction {
     
   };
 
-  using Tag_t = std::tuple<Int_t/*MrSyncCount*/, Long64_t/*TdcFromMrSync*/, Int_t/*GlobalChannel*/>;
+  // Compact hit record, trivially copyable in 32 bytes.
+  // Spill information and time per tdc are common in a spill or a board, they are kept in HitBatch_t.
+  // Time, tdc from mr sync and next mr sync tdc are derived from the others.
+  struct TdcHit_t {
+    Long64_t    Tdc             =  0;
+    Long64_t    LastMrSyncTdc   =  0;
+    Int_t       LastMrSyncCount =  0;
+    Int_t       MrSyncInterval  =  0; // next - last mr sync tdc, 0 if either is unknown
+    Short_t     Channel         = -1;
+    Short_t     RawChannel      = -1;
+    std::int8_t Board           = -1;
+    std::int8_t MrSyncChannel   = -2;
+    UChar_t     Tot             =  0;
+    UChar_t     Reserved        =  0;
+
+    TdcHit_t() = default;
+    explicit TdcHit_t(const TdcData& data)
+      : Tdc            (data.Tdc            ),
+        LastMrSyncTdc  (data.LastMrSyncTdc  ),
+        LastMrSyncCount(data.LastMrSyncCount),
+        MrSyncInterval (0                   ),
+        Channel        (data.Channel        ),
+        RawChannel     (data.RawChannel     ),
+        Board          (data.Board          ),
+        MrSyncChannel  (data.MrSyncChannel  ),
+        Tot            (data.Tot            ) {
+      SetNextMrSyncTdc(data.NextMrSyncTdc);
+    }
+
+    inline void Clear() {
+      *this = TdcHit_t();
+    }
+
+    inline Long64_t GetTdcFromMrSync() const {
+      return Tdc - LastMrSyncTdc;
+    }
+
+    inline Long64_t GetNextMrSyncTdc() const {
+      return MrSyncInterval ? LastMrSyncTdc + MrSyncInterval : 0;
+    }
+
+    inline void SetNextMrSyncTdc(Long64_t nextMrSyncTdc) {
+      const Long64_t interval = nextMrSyncTdc - LastMrSyncTdc;
+      MrSyncInterval = (LastMrSyncTdc && nextMrSyncTdc && interval == (Int_t)interval) ? interval : 0;
+    }
+
+    inline void CreateBranch(TTree* tree) {
+      tree->Branch("mscount"      , &LastMrSyncCount, "mscount"      "/I");
+      tree->Branch("tdc"          , &Tdc            , "tdc"          "/L");
+      tree->Branch("mstdc"        , &LastMrSyncTdc  , "mstdc"        "/L");
+      tree->Branch("msinterval"   , &MrSyncInterval , "msinterval"   "/I");
+      tree->Branch("ch"           , &Channel        , "ch"           "/S");
+      tree->Branch("rawch"        , &RawChannel     , "rawch"        "/S");
+      tree->Branch("board"        , &Board          , "board"        "/B");
+      tree->Branch("msch"         , &MrSyncChannel  , "msch"         "/B");
+      tree->Branch("tot"          , &Tot            , "tot"          "/b");
+    }
+
+    inline void SetBranchAddress(TTree* tree) {
+      tree->SetBranchAddress("mscount"      , &LastMrSyncCount        );
+      tree->SetBranchAddress("tdc"          , &Tdc                    );
+      tree->SetBranchAddress("mstdc"        , &LastMrSyncTdc          );
+      tree->SetBranchAddress("msinterval"   , &MrSyncInterval         );
+      tree->SetBranchAddress("ch"           , &Channel                );
+      tree->SetBranchAddress("rawch"        , &RawChannel             );
+      tree->SetBranchAddress("board"        , (Char_t*)&Board         );
+      tree->SetBranchAddress("msch"         , (Char_t*)&MrSyncChannel );
+      tree->SetBranchAddress("tot"          , &Tot                    );
+    }
+
+    TdcData ToTdcData(ULong64_t date, Int_t spill, Int_t emcount, Double_t timePerTdc) const {
+      TdcData data;
+      data.Date            = date;
+      data.Spill           = spill;
+      data.EMCount         = emcount;
+      data.Board           = Board;
+      data.TimePerTdc      = timePerTdc;
+      data.RawChannel      = RawChannel;
+      data.Channel         = Channel;
+      data.Tdc             = Tdc;
+      data.Time            = Tdc * timePerTdc;
+      data.Tot             = Tot;
+      data.MrSyncChannel   = MrSyncChannel;
+      data.LastMrSyncCount = LastMrSyncCount;
+      data.LastMrSyncTdc   = LastMrSyncTdc;
+      data.NextMrSyncTdc   = GetNextMrSyncTdc();
+      data.TdcFromMrSync   = GetTdcFromMrSync();
+      return data;
+    }
+  };
+  static_assert(std::is_trivially_copyable<TdcHit_t>::value, "TdcHit_t must be trivially copyable");
+  static_assert(sizeof(TdcHit_t) <= 32, "TdcHit_t must fit in 32 bytes");
+
+  // Hits of a spill in structure of arrays, with the spill information and time per tdc of each board.
+  // Loops over one field, e.g. channel, touch only its column.
+  class HitBatch_t {
+  public:
+    Int_t                    EMCount = -1; // common to the boards
+
+    std::vector<Long64_t>    Tdc;
+    std::vector<Long64_t>    LastMrSyncTdc;
+    std::vector<Int_t>       LastMrSyncCount;
+    std::vector<Int_t>       MrSyncInterval;
+    std::vector<Short_t>     Channel;
+    std::vector<Short_t>     RawChannel;
+    std::vector<std::int8_t> Board;
+    std::vector<std::int8_t> MrSyncChannel;
+    std::vector<UChar_t>     Tot;
+
+  private:
+    // By board, kept over Clear()
+    std::vector<Double_t>    fTimePerTdc;
+    std::vector<ULong64_t>   fDate;
+    std::vector<Int_t>       fSpill;
+
+  public:
+    inline std::size_t Size() const {
+      return Tdc.size();
+    }
+
+    inline Bool_t Empty() const {
+      return Tdc.empty();
+    }
+
+    void Reserve(std::size_t size) {
+      Tdc            .reserve(size);
+      LastMrSyncTdc  .reserve(size);
+      LastMrSyncCount.reserve(size);
+      MrSyncInterval .reserve(size);
+      Channel        .reserve(size);
+      RawChannel     .reserve(size);
+      Board          .reserve(size);
+      MrSyncChannel  .reserve(size);
+      Tot            .reserve(size);
+    }
+
+    void Clear() {
+      Tdc            .clear();
+      LastMrSyncTdc  .clear();
+      LastMrSyncCount.clear();
+      MrSyncInterval .clear();
+      Channel        .clear();
+      RawChannel     .clear();
+      Board          .clear();
+      MrSyncChannel  .clear();
+      Tot            .clear();
+    }
+
+    inline void SetTimePerTdc(Int_t board, Double_t timePerTdc) {
+      if (board < 0) {
+        return;
+      } else if ((std::size_t)board >= fTimePerTdc.size()) {
+        fTimePerTdc.resize(board + 1, 1.0);
+      }
+      fTimePerTdc[board] = timePerTdc;
+    }
+
+    inline Double_t GetTimePerTdc(Int_t board) const {
+      return (0 <= board && (std::size_t)board < fTimePerTdc.size()) ? fTimePerTdc[board] : 1.0;
+    }
+
+    inline void SetSpill(Int_t board, ULong64_t date, Int_t spill) {
+      if (board < 0) {
+        return;
+      } else if ((std::size_t)board >= fDate.size()) {
+        fDate .resize(board + 1,  0);
+        fSpill.resize(board + 1, -1);
+      }
+      fDate [board] = date;
+      fSpill[board] = spill;
+    }
+
+    inline ULong64_t GetDate(Int_t board) const {
+      return (0 <= board && (std::size_t)board < fDate.size()) ? fDate[board] : 0;
+    }
+
+    inline Int_t GetSpill(Int_t board) const {
+      return (0 <= board && (std::size_t)board < fSpill.size()) ? fSpill[board] : -1;
+    }
+
+    inline void Push(const TdcHit_t& hit) {
+      Tdc            .push_back(hit.Tdc            );
+      LastMrSyncTdc  .push_back(hit.LastMrSyncTdc  );
+      LastMrSyncCount.push_back(hit.LastMrSyncCount);
+      MrSyncInterval .push_back(hit.MrSyncInterval );
+      Channel        .push_back(hit.Channel        );
+      RawChannel     .push_back(hit.RawChannel     );
+      Board          .push_back(hit.Board          );
+      MrSyncChannel  .push_back(hit.MrSyncChannel  );
+      Tot            .push_back(hit.Tot            );
+    }
+
+    inline TdcHit_t GetHit(std::size_t i) const {
+      TdcHit_t hit;
+      hit.Tdc             = Tdc            [i];
+      hit.LastMrSyncTdc   = LastMrSyncTdc  [i];
+      hit.LastMrSyncCount = LastMrSyncCount[i];
+      hit.MrSyncInterval  = MrSyncInterval [i];
+      hit.Channel         = Channel        [i];
+      hit.RawChannel      = RawChannel     [i];
+      hit.Board           = Board          [i];
+      hit.MrSyncChannel   = MrSyncChannel  [i];
+      hit.Tot             = Tot            [i];
+      return hit;
+    }
+
+    inline Long64_t GetTdcFromMrSync(std::size_t i) const {
+      return Tdc[i] - LastMrSyncTdc[i];
+    }
+
+    inline Double_t GetTime(std::size_t i) const {
+      return Tdc[i] * GetTimePerTdc(Board[i]);
+    }
+
+    inline Double_t GetTime(const TdcHit_t& hit) const {
+      return hit.Tdc * GetTimePerTdc(hit.Board);
+    }
+
+    inline TdcData GetTdcData(std::size_t i) const {
+      const Int_t board = Board[i];
+      return GetHit(i).ToTdcData(GetDate(board), GetSpill(board), EMCount, GetTimePerTdc(board));
+    }
+
+    // Same as TdcData::GetTimeDifference
+    Double_t GetTimeDifference(const TdcHit_t& hit1, const TdcHit_t& hit2) const {
+      const Int_t dmscount = hit2.LastMrSyncCount - hit1.LastMrSyncCount;
+      Long64_t tdc1 = hit1.GetTdcFromMrSync();
+      Long64_t tdc2 = hit2.GetTdcFromMrSync();
+      if        (dmscount > 0) {
+        if (hit1.MrSyncInterval) {
+          tdc1 -= (+dmscount) * (Long64_t)hit1.MrSyncInterval;
+        } else {
+          tdc1 = hit1.Tdc;
+          tdc2 = hit2.Tdc;
+        }
+      } else if (dmscount < 0) {
+        if (hit2.MrSyncInterval) {
+          tdc2 -= (-dmscount) * (Long64_t)hit2.MrSyncInterval;
+        } else {
+          tdc1 = hit1.Tdc;
+          tdc2 = hit2.Tdc;
+        }
+      }
+      return tdc1 * GetTimePerTdc(hit1.Board) - tdc2 * GetTimePerTdc(hit2.Board);
+    }
+  };
+
+  // Sliding history of recent tdc data or hits in order of arrival.
+  // Data is expired from the front in O(1) and the ring grows by doubling, without size limit.
+  template <typename T>
+  class History_t {
+  private:
+    std::vector<T> fData; // size is zero or a power of two
+    std::size_t    fHead = 0;
+    std::size_t    fSize = 0;
+
+    inline std::size_t Index(std::size_t i) const { return (fHead + i) & (fData.size() - 1); }
+
+    void Grow(std::size_t capacity) {
+      std::vector<T> data(capacity);
+      for (std::size_t i = 0; i < fSize; ++i) {
+        data[i] = fData[Index(i)];
+      }
+      fData.swap(data);
+      fHead = 0;
+    }
+
+  public:
+    class const_iterator {
+    private:
+      const History_t* fHistory;
+      std::size_t      fI;
+    public:
+      const_iterator(const History_t* history, std::size_t i) : fHistory(history), fI(i) { }
+      inline const T&        operator* () const { return (*fHistory)[fI]; }
+      inline const T*        operator->() const { return &(*fHistory)[fI]; }
+      inline const_iterator& operator++() { ++fI; return *this; }
+      inline Bool_t          operator==(const const_iterator& other) const { return fI == other.fI; }
+      inline Bool_t          operator!=(const const_iterator& other) const { return fI != other.fI; }
+    };
+
+    inline const_iterator  begin() const { return const_iterator(this, 0    ); }
+    inline const_iterator  end  () const { return const_iterator(this, fSize); }
+    inline std::size_t     size () const { return fSize; }
+    inline Bool_t          empty() const { return !fSize; }
+    inline const T&        front() const { return fData[fHead]; }
+    inline const T&        back () const { return fData[Index(fSize - 1)]; }
+    inline const T&        operator[](std::size_t i) const { return fData[Index(i)]; }
+
+    void Reserve(std::size_t capacity) {
+      std::size_t size = 1;
+      while (size < capacity) {
+        size <<= 1;
+      }
+      if (size > fData.size()) {
+        Grow(size);
+      }
+    }
+
+    inline void Push(const T& data) {
+      if (fSize == fData.size()) {
+        Grow(fData.empty() ? 64 : 2 * fData.size());
+      }
+      fData[Index(fSize++)] = data;
+    }
+
+    inline void Pop() {
+      fHead = Index(1);
+      --fSize;
+    }
+
+    // Index of the first data whose key is not less than value, for data pushed in non-decreasing order of key
+    template <typename Value, typename Key>
+    inline std::size_t LowerBound(const Value& value, Key key) const {
+      std::size_t first = 0;
+      for (std::size_t count = fSize; count;) {
+        const std::size_t step = count / 2;
+        if (key((*this)[first + step]) < value) {
+          first += step + 1;
+          count -= step + 1;
+        } else {
+          count  = step;
+        }
+      }
+      return first;
+    }
+
+    // Pops data from the front while isOld returns true, and returns the remaining size
+    template <typename Predicate>
+    inline std::size_t PopWhile(Predicate isOld) {
+      while (fSize && isOld(front())) {
+        Pop();
+      }
+      return fSize;
+    }
+
+    inline void Clear() {
+      fHead = 0;
+      fSize = 0;
+    }
+  };
 
   template <typename V>
   using BoardMap_t = std::map<Int_t, V>;
 
+  // Sliding history kept by board for lookup, and expired in order of arrival over all boards.
+  // Tdc increases in a board, so data of a board can be searched with History_t::LowerBound.
+  template <typename T>
+  class BoardHistory_t {
+  private:
+    BoardMap_t<History_t<T>> fHistories;
+    History_t<Int_t>         fBoards; // board of each data in order of arrival
+
+  public:
+    using const_iterator = typename BoardMap_t<History_t<T>>::const_iterator;
+
+    inline const_iterator begin() const { return fHistories.begin(); }
+    inline const_iterator end  () const { return fHistories.end  (); }
+    inline std::size_t    size () const { return fBoards.size(); }
+    inline Bool_t         empty() const { return fBoards.empty(); }
+
+    inline void Push(const T& data) {
+      fHistories[data.Board].Push(data);
+      fBoards.Push(data.Board);
+    }
+
+    // Pops the oldest data over all boards while isOld returns true, and returns the remaining size
+    template <typename Predicate>
+    inline std::size_t PopWhile(Predicate isOld) {
+      while (fBoards.size()) {
+        History_t<T>& history = fHistories[fBoards.front()];
+        if (!isOld(history.front())) {
+          break;
+        }
+        history.Pop();
+        fBoards.Pop();
+      }
+      return fBoards.size();
+    }
+
+    inline void Clear() {
+      for (auto&& pair : fHistories) {
+        pair.second.Clear();
+      }
+      fBoards.Clear();
+    }
+  };
+
+  using TdcHistory_t = History_t<TdcData>;
+  using HitHistory_t = History_t<TdcHit_t>;
+  using TdcBoardHistory_t = BoardHistory_t<TdcData>;
+
+  using Tag_t = std::tuple<Int_t/*MrSyncCount*/, Long64_t/*TdcFromMrSync*/, Int_t/*GlobalChannel*/>;
+
   using SortedTdcData_t = std::map<Tag_t, TdcData>;
 
   class ITdcDataProvider {
@@ -236,6 +628,8 @@ namespace Extinction {
     virtual Int_t                GetEMCount() const = 0;
     virtual Double_t             GetTime() const = 0;
     virtual std::vector<TdcData> GetTdcData(Int_t) const = 0;
+    // Appends data into caller-owned buffer, reuse it across entries to avoid allocation
+    virtual void                 AppendTdcData(Int_t, std::vector<TdcData>&) const = 0;
     virtual Int_t                FindBoard(Int_t) const = 0;
     virtual void                 SetBranchAddress(TTree*) = 0;
     virtual Int_t                DecodeEventMatchNumber(const std::vector<TdcData>&) const = 0;
@@ -3,6 +3,9 @@
 
 #include <iostream>
 #include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <algorithm>
 
 #include "TROOT.h"
 #include "TSystem.h"
@@ -71,13 +74,13 @@ namespace Extinction {
         return pTdcs[tdc];
       }
 
-      inline void FillHit(TdcData& data, Int_t width) {
-        const Int_t x = data.TdcFromMrSync;
+      inline void FillHit(const TdcHit_t& data, Int_t width) {
+        const Int_t x = data.GetTdcFromMrSync();
         const Int_t last = std::min((std::size_t)(x + width), fSize);
         if (x < 0 || last <= x) { return; }
-        std::fill(fTdcs          .begin() + x, fTdcs          .begin() + last, data.Tdc            );
-        std::fill(fMrSyncCounts  .begin() + x, fMrSyncCounts  .begin() + last, data.LastMrSyncCount);
-        std::fill(fTdcFromMrSyncs.begin() + x, fTdcFromMrSyncs.begin() + last, data.TdcFromMrSync  );
+        std::fill(fTdcs          .begin() + x, fTdcs          .begin() + last, data.Tdc              );
+        std::fill(fMrSyncCounts  .begin() + x, fMrSyncCounts  .begin() + last, data.LastMrSyncCount  );
+        std::fill(fTdcFromMrSyncs.begin() + x, fTdcFromMrSyncs.begin() + last, data.GetTdcFromMrSync());
         std::fill(fTots          .begin() + x, fTots          .begin() + last, data.Tot            );
       }
 
@@ -94,6 +97,80 @@ namespace Extinction {
       }
     };
     
+    // One bit per tdc bin, set where the timeline has a hit
+    class HitBitset_t {
+    private:
+      std::size_t            fSize = 0;
+      std::vector<ULong64_t> fWords;
+
+    public:
+      void Resize(std::size_t size) {
+        fSize = size;
+        fWords.resize((fSize + 63) / 64);
+        Clear();
+      }
+
+      inline std::size_t Size() const {
+        return fSize;
+      }
+
+      inline std::size_t NofWords() const {
+        return fWords.size();
+      }
+
+      inline ULong64_t* Words() {
+        return fWords.data();
+      }
+
+      inline const ULong64_t* Words() const {
+        return fWords.data();
+      }
+
+      inline void Clear() {
+        std::fill(fWords.begin(), fWords.end(), 0);
+      }
+
+      inline Bool_t Test(std::size_t i) const {
+        return (fWords[i >> 6] >> (i & 63)) & 1;
+      }
+
+      inline void Assign(std::size_t first, std::size_t last, Bool_t value) {
+        for (std::size_t i = first; i < last; ) {
+          const std::size_t bit  = i & 63;
+          const std::size_t nbit = std::min<std::size_t>(64 - bit, last - i);
+          const ULong64_t   mask = (nbit == 64 ? ~0ULL : ((1ULL << nbit) - 1)) << bit;
+          if (value) {
+            fWords[i >> 6] |=  mask;
+          } else {
+            fWords[i >> 6] &= ~mask;
+          }
+          i += nbit;
+        }
+      }
+
+      // First bin in [first, last) whose bit equals value, or last
+      inline std::size_t Find(std::size_t first, std::size_t last, Bool_t value) const {
+        std::size_t i = first;
+        while (i < last) {
+          ULong64_t word = value ? fWords[i >> 6] : ~fWords[i >> 6];
+          word &= ~0ULL << (i & 63);
+          if (word) {
+            return std::min<std::size_t>((i & ~(std::size_t)63) + __builtin_ctzll(word), last);
+          }
+          i = (i & ~(std::size_t)63) + 64;
+        }
+        return last;
+      }
+    };
+
+    struct CoinEngine {
+      enum : Int_t {
+            Timeline,  // dense timeline of each channel, scan every tdc bin
+            SweepLine, // sweep over start/end of sorted hit intervals
+            Bitset,    // word-wise and/or of hit bitsets, run search with ctz
+      };
+    };
+
     class TimelineCoincidence {
     public:
       struct PlotsProfiles {
@@ -167,6 +244,66 @@ namespace Extinction {
       Bool_t                     fEfficiencyTargetTc2;
 
       Long64_t                   fCoinTdcWidth;
+      Int_t                      fCoinEngine             = CoinEngine::Timeline;
+
+      // Hit interval [Start, End) on a timeline, used by sweep line engine
+      struct HitInterval_t {
+        Long64_t Start;
+        Long64_t End;
+        Long64_t Tdc;
+        Int_t    MrSyncCount;
+        Long64_t TdcFromMrSync;
+        Int_t    Tot;
+      };
+      // Timeline index of sweep line engine: ext channels, then bh1, bh2, tc1, tc2
+      enum : std::size_t {
+            kSweepBh1 = ExtinctionDetector::NofChannels,
+            kSweepBh2,
+            kSweepTc1,
+            kSweepTc2,
+            kNofSweepTimelines,
+      };
+      struct SweepEdge_t {
+        Long64_t    Tdc;
+        Bool_t      Start;
+        std::size_t Index;
+        std::size_t Interval;
+      };
+      std::vector<std::vector<HitInterval_t>> fSweepHits;
+      std::vector<std::vector<HitInterval_t>> fSweepIntervals;
+      std::vector<SweepEdge_t>                fSweepEdges;
+      // Work buffers of ResolveSweepIntervals, kept to reuse their capacity
+      std::vector<Long64_t>                   fSweepBounds;
+      std::vector<std::size_t>                fSweepOrder;
+      std::vector<std::size_t>                fSweepActive;
+
+      // Hit bitsets of bitset engine, same index as sweep line engine.
+      // They are set from resolved hit intervals, which also give hits of coincidence
+      std::vector<HitBitset_t>   fHitBits;
+      std::vector<Bool_t>        fHitBitsDirty;
+      std::vector<std::size_t>   fDirtyTimelines;
+      HitBitset_t                fExtAnyBits;
+      HitBitset_t                fCoinBits;
+      Bool_t                     fCoinCrossCheck         = false;
+      Long64_t                   fCrossCheckErrors       = 0;
+
+      struct CoinHit_t {
+        Long64_t MrSyncCount;
+        Long64_t TdcFromMrSync;
+        Long64_t Tot;
+      };
+      using CoinHits_t = std::map<std::pair<Long64_t/*tdc*/, Int_t/*ch*/>, CoinHit_t>;
+
+      // Coincidence found in an mr sync, before filling hists and ctree
+      struct CoinEvent_t {
+        Long64_t   Tdc;           // first bin of coincidence
+        Long64_t   Width;         // # of coincident bins
+        Int_t      EfficiencyBin; // bin filled as efficient, -1 if none
+        Bool_t     Closed;        // ended before end of mr sync
+        CoinHits_t Hits;
+      };
+      std::vector<CoinEvent_t>   fCoinEvents;
+      std::vector<CoinEvent_t>   fCheckEvents;
 
       // Coincidence data
       ULong64_t                  fDate;
@@ -237,6 +374,21 @@ namespace Extinction {
       }
       inline Long64_t      GetCoinTdcWidth() const { return fCoinTdcWidth; }
 
+      inline void          SetCoinEngine(Int_t engine) {
+        std::cout << "SetCoinEngine ... " << (engine == CoinEngine::SweepLine ? "sweep line" :
+                                              engine == CoinEngine::Bitset    ? "bitset"     : "timeline") << std::endl;
+        fCoinEngine = engine;
+      }
+      inline Int_t         GetCoinEngine() const { return fCoinEngine; }
+
+      // Compare bitset engine with timeline scan in every mr sync
+      inline void          SetCoinCrossCheck(Bool_t check) {
+        std::cout << "SetCoinCrossCheck ... " << (check ? "true" : "false") << std::endl;
+        fCoinCrossCheck = check;
+      }
+      inline Bool_t        GetCoinCrossCheck() const { return fCoinCrossCheck; }
+      inline Long64_t      GetCrossCheckErrors() const { return fCrossCheckErrors; }
+
       inline void          SetBunchEdgeMargin(Double_t margin) {
         std::cout << "SetBunchEdgeMargin ... " << margin / nsec << " nsec";
         fBunchEdgeMargin = TMath::Nint(margin / fProvider->GetTimePerTdc());
@@ -269,6 +421,18 @@ namespace Extinction {
       void                 ClearLastSpill(Bool_t clearHists);
 
       void                 DrawTmpTimeline(Int_t bin, Int_t range);
+
+      Timeline_t&          GetSweepTimeline(std::size_t index);
+      void                 AddSweepHit(std::size_t index, const TdcHit_t& data, Int_t width);
+      void                 ResolveSweepIntervals(std::size_t index);
+      void                 SweepCoincidence(Double_t mrSyncTime);
+      void                 AddBitsetHit(std::size_t index, const TdcHit_t& data, Int_t width);
+      void                 BitsetCoincidence(Double_t mrSyncTime);
+      void                 CrossCheckBitset();
+      void                 ClearBitsetTimelines();
+      void                 ScanTimelines(std::vector<CoinEvent_t>& events);
+      void                 FillCoinEvents(const std::vector<CoinEvent_t>& events, Double_t mrSyncTime, Bool_t drawCoinTimeline);
+      void                 FillCoinEvent(const CoinHits_t& hits, Double_t mrSyncTime, Long64_t dtdc);
     };
 
     TimelineCoincidence::TimelineCoincidence(ITdcDataProvider* provider)
@@ -703,7 +867,11 @@ namespace Extinction {
             (fCoincidenceTargetTc1 && fEfficiencyTargetTc1) ||
             (fCoincidenceTargetTc2 && fEfficiencyTargetTc2) ||
             (i == 6)) {
-          reader->Open(providers, ifilenames, itreename);
+          if (reader->IsMargedInput()) {
+            reader->OpenMarged(reader->GetMargedFilename(), reader->GetMargedTreename());
+          } else {
+            reader->Open(providers, ifilenames, itreename);
+          }
           GeneratePlots(reader);
           reader->Close();
         }
@@ -717,6 +885,28 @@ namespace Extinction {
                                              Int_t         mscountSelection) {
       const clock_t startClock = clock();
 
+      // Drawing needs dense timelines
+      Int_t coinEngine = fCoinEngine;
+      if (coinEngine != CoinEngine::Timeline && (drawCoinTimeline || mscountSelection >= 0)) {
+        std::cout << "[warning] timeline drawing is available only with timeline engine" << std::endl;
+        coinEngine = CoinEngine::Timeline;
+      }
+      if (coinEngine == CoinEngine::SweepLine || coinEngine == CoinEngine::Bitset) {
+        fSweepHits     .resize(kNofSweepTimelines);
+        fSweepIntervals.resize(kNofSweepTimelines);
+      }
+      if (coinEngine == CoinEngine::Bitset) {
+        fHitBits.resize(kNofSweepTimelines);
+        for (auto&& bits : fHitBits) {
+          bits.Resize(fBh1Timeline.Size());
+        }
+        fHitBitsDirty.assign(kNofSweepTimelines, false);
+        fDirtyTimelines.clear();
+        fExtAnyBits.Resize(fBh1Timeline.Size());
+        fCoinBits  .Resize(fBh1Timeline.Size());
+        fCrossCheckErrors = 0;
+      }
+
       if (mscountSelection < 0) {
         mscountSelection = std::numeric_limits<Int_t>::max();
       }
@@ -726,9 +916,9 @@ namespace Extinction {
 
       // std::cout << "[debug] check end of spill" << std::endl;
       // Throw away first mr sync
-      SortedTdcData_t tdcDataInMrSync;
-      reader->Read(tdcDataInMrSync);
-      tdcDataInMrSync.clear();
+      HitBatch_t hitsInMrSync;
+      reader->Read(hitsInMrSync);
+      hitsInMrSync.Clear();
 
       fDate    = reader->GetDate();
       fEMCount = reader->GetEMCount();
@@ -747,194 +937,74 @@ namespace Extinction {
           fCoincidenceTargetTc1 *     10 +
           fCoincidenceTargetTc2 *      1;
 
-        Int_t dtdc = 0;
+        auto fillHit =
+          [&] (Timeline_t& timeline, std::size_t index, const TdcHit_t& data) {
+            if (coinEngine == CoinEngine::SweepLine) {
+              AddSweepHit(index, data, fCoinTdcWidth);
+            } else if (coinEngine == CoinEngine::Bitset) {
+              AddBitsetHit(index, data, fCoinTdcWidth);
+              if (fCoinCrossCheck) {
+                timeline.FillHit(data, fCoinTdcWidth);
+              }
+            } else {
+              timeline.FillHit(data, fCoinTdcWidth);
+            }
+          };
+
         while (true) {
-          for (; reader->Read(tdcDataInMrSync); tdcDataInMrSync.clear()) {
+          for (; reader->Read(hitsInMrSync); hitsInMrSync.Clear()) {
             fMrSyncCount = reader->GetMrSyncCount();
 
             // std::cout << "[debug] data process" << std::endl;
-            for (auto&& pair : tdcDataInMrSync) {
-              // auto& tag  = pair.first;
-              auto& data = pair.second;
+            for (std::size_t i = 0, n = hitsInMrSync.Size(); i < n; ++i) {
+              const Int_t channel = hitsInMrSync.Channel[i];
+              if (!BeamlineHodoscope::Contains(channel) && !ExtinctionDetector::Contains(channel) &&
+                  !TimingCounter::Contains(channel) && !MrSync::Contains(channel)) {
+                // std::cout << "[debug] skip others" << std::endl;
+                continue;
+              }
 
+              const TdcHit_t data = hitsInMrSync.GetHit(i);
               if (BeamlineHodoscope::Contains(data.Channel)) {
                 // std::cout << "[debug] fill bh timeline" << std::endl;
                 const std::size_t bhCh = BeamlineHodoscope::GetChannel(data.Channel);
                 if (bhCh == 0) {
-                  fBh1Timeline.FillHit(data, fCoinTdcWidth);
+                  fillHit(fBh1Timeline, kSweepBh1, data);
                 } else {
-                  fBh2Timeline.FillHit(data, fCoinTdcWidth);
+                  fillHit(fBh2Timeline, kSweepBh2, data);
                 }
 
               } else if (ExtinctionDetector::Contains(data.Channel)) {
                 // std::cout << "[debug] fill ext timeline" << std::endl;
                 const std::size_t extCh = ExtinctionDetector::GetChannel(data.Channel);
-                fExtTimeline[extCh].FillHit(data, fCoinTdcWidth);
+                fillHit(fExtTimeline[extCh], extCh, data);
 
               } else if (TimingCounter::Contains(data.Channel)) {
                 // std::cout << "[debug] fill tc timeline" << std::endl;
                 const std::size_t tcCh = TimingCounter::GetChannel(data.Channel);
                 if (tcCh == 0) {
-                  fTc1Timeline.FillHit(data, fCoinTdcWidth);
+                  fillHit(fTc1Timeline, kSweepTc1, data);
                 } else {
-                  fTc2Timeline.FillHit(data, fCoinTdcWidth);
+                  fillHit(fTc2Timeline, kSweepTc2, data);
                 }
 
               } else if (MrSync::Contains(data.Channel)) {
                 // std::cout << "[debug] get mrsync" << std::endl;
-                mrSyncTime = data.Time;
-
-              } else {
-                // std::cout << "[debug] skip others" << std::endl;
-                continue;
+                mrSyncTime = hitsInMrSync.GetTime(i);
 
               }
             }
 
-            {
-              static const Int_t xmax = fBh1Timeline.Size();
-
-              static Bool_t hitBh1 = false, hitBh2 = false, hitTc1 = false, hitTc2 = false, hitExt = false;
-              auto isCoincident =
-                [&] (Int_t i) {
-                  {
-                    hitBh1 = fBh1Timeline.HasHit(i);
-                    hitBh2 = fBh2Timeline.HasHit(i);
-                    hitExt = std::any_of(fExtTimeline.begin(), fExtTimeline.end(), [&](Timeline_t& tl) { return tl.HasHit(i); });
-                    hitTc1 = fTc1Timeline.HasHit(i);
-                    hitTc2 = fTc2Timeline.HasHit(i);
-                  }
-
-                  return
-                    (hitBh1 || !fCoincidenceTargetBh1 || fEfficiencyTargetBh1) &&
-                    (hitBh2 || !fCoincidenceTargetBh2 || fEfficiencyTargetBh2) &&
-                 // (hitHod || !fCoincidenceTargetHod || fEfficiencyTargetHod) &&
-                    (hitExt || !fCoincidenceTargetExt || fEfficiencyTargetExt) &&
-                    (hitTc1 || !fCoincidenceTargetTc1 || fEfficiencyTargetTc1) &&
-                    (hitTc2 || !fCoincidenceTargetTc2 || fEfficiencyTargetTc2);
-                };
-
-              // std::cout << "[debug] seek timeline" << std::endl;
-              for (dtdc = 0; dtdc < xmax; ++dtdc) {
-
-                if (isCoincident(dtdc)) {
-                  ClearCoinEvent();
-
-                  fTdcFromMrSync = dtdc;
-                  hCoinTlTdcInSync->Fill(dtdc);
-                  hCoinTlMountain ->Fill(dtdc, mrSyncTime / msec);
-                  ++fSpillData.CoinCount;
-
-                  if (drawCoinTimeline) {
-                    DrawTmpTimeline(dtdc, 2 * fCoinTdcWidth);
-                    gPad->WaitPrimitive();
-                  }
-
-                  // std::cout << "[debug] skip dead time" << std::endl;
-                  // Skip dead time
-                  fCoinWidth = 0;
-                  Bool_t filled = false;
-                  std::map<std::pair<Long64_t/*tdc*/, Int_t/*ch*/>, Long64_t> hitmscounts;
-                  std::map<std::pair<Long64_t/*tdc*/, Int_t/*ch*/>, Long64_t> hitdtdcs;
-                  std::map<std::pair<Long64_t/*tdc*/, Int_t/*ch*/>, Long64_t> hittots;
-                  auto fillCoincidenceData =
-                    [&] (Timeline_t& tl) {
-                      if (tl.HasHit(dtdc)) {
-                        const std::pair<Int_t, Long64_t> tag { tl.fTdcFromMrSyncs[dtdc], tl.fChannel };
-                        hitmscounts.emplace(tag, tl.fMrSyncCounts  [dtdc]);
-                        hitdtdcs   .emplace(tag, tl.fTdcFromMrSyncs[dtdc]);
-                        hittots    .emplace(tag, tl.fTots          [dtdc]);
-                      }
-                    };
-                  for (; dtdc < xmax; ++dtdc) {
-                    if (isCoincident(dtdc)) {
-                      ++fCoinWidth;
-
-                      // std::cout << "[debug] fill coincidence data" << std::endl;
-                      for (std::size_t ch = 0; ch < ExtinctionDetector::NofChannels; ++ch) {
-                        fillCoincidenceData(fExtTimeline[ch]);
-                      }
-                      fillCoincidenceData(fTc1Timeline);
-                      fillCoincidenceData(fTc2Timeline);
-                      fillCoincidenceData(fBh1Timeline);
-                      fillCoincidenceData(fBh2Timeline);
-
-                      if (fEfficiencyTargetBh1 && hitBh1 && !filled) { hEfficiency->Fill(true, 0); filled = true; }
-                      if (fEfficiencyTargetBh2 && hitBh2 && !filled) { hEfficiency->Fill(true, 1); filled = true; }
-                   // if (fEfficiencyTargetHod && hitHod && !filled) { hEfficiency->Fill(true, 2); filled = true; }
-                      if (fEfficiencyTargetExt && hitExt && !filled) { hEfficiency->Fill(true, 3); filled = true; }
-                      if (fEfficiencyTargetTc1 && hitTc1 && !filled) { hEfficiency->Fill(true, 4); filled = true; }
-                      if (fEfficiencyTargetTc2 && hitTc2 && !filled) { hEfficiency->Fill(true, 5); filled = true; }
-
-                    } else {
-                      if (fEfficiencyTargetBh1 && !filled) { hEfficiency->Fill(false, 0); }
-                      if (fEfficiencyTargetBh2 && !filled) { hEfficiency->Fill(false, 1); }
-                   // if (fEfficiencyTargetHod && !filled) { hEfficiency->Fill(false, 2); }
-                      if (fEfficiencyTargetExt && !filled) { hEfficiency->Fill(false, 3); }
-                      if (fEfficiencyTargetTc1 && !filled) { hEfficiency->Fill(false, 4); }
-                      if (fEfficiencyTargetTc2 && !filled) { hEfficiency->Fill(false, 5); }
-
-                      break;
-                    }
-                  }
-
-                  fBlurWidth = fTdcFromMrSync - hitdtdcs.begin()->first.first;
-
-                  for (auto&& pair : hitmscounts) {
-                    auto& tag = pair.first;
-                    auto& gch = tag.second;
-
-                    if        (ExtinctionDetector::Contains(gch)) {
-                      hCoinExtTdcInSync->Fill(hitdtdcs[tag]);
-                      hCoinExtMountain ->Fill(hitdtdcs[tag], mrSyncTime / msec);
-                      ++fSpillData.ExtEntries;
-                    } else if (BeamlineHodoscope::Contains(gch)) {
-                      const Int_t bhch = BeamlineHodoscope::GetChannel(gch);
-                      if (bhch == 0) {
-                        ++fSpillData.Bh1Entries;
-                      } else {
-                        ++fSpillData.Bh2Entries;
-                      }
-                    } else if (TimingCounter::Contains(gch)) {
-                      const Int_t tcch = TimingCounter::GetChannel(gch);
-                      if (tcch == 0) {
-                        ++fSpillData.Tc1Entries;
-                      } else {
-                        ++fSpillData.Tc2Entries;
-                      }
-                    }
-                  }
-
-                  for (auto&& pair : hitmscounts) {
-                    auto& tag = pair.first;
-                    auto& ch  = tag.second;
-
-                    fHitChannels      [fNofHits] = ch;
-                 // fHitMrSyncCounts  [fNofHits] = pair.second;
-                    fHitTdcFromMrSyncs[fNofHits] = hitdtdcs[tag];
-                    fHitTots          [fNofHits] = hittots [tag];
-                    fNofHits++;
-
-                    if (fNofHits == Detectors::NofChannels) {
-                      std::cerr << "[warning] coincidence of too many multiple hit" << std::endl
-                                << "  # of hits    \t" << hitmscounts.size() << std::endl
-                                << "  begin of dtdc\t" << dtdc - fCoinWidth  << std::endl
-                                << "  end   of dtdc\t" << dtdc - 1           << std::endl
-                                << "  coin width   \t" << fCoinWidth         << std::endl
-                                << "  mr sync count\t" << fMrSyncCount       << std::endl;
-                      Int_t ipair = 0;
-                      for (auto&& pair2 : hitmscounts) {
-                        std::cerr << (ipair++ == 0 ?  "  dtdc ch      \t" : "               \t") << std::setw(8) << pair2.first.first << "\t" << std::setw(3) << pair2.first.second << std::endl;
-                      }
-                      break;
-                    }
-                  }
-
-                  if (fCoinTree) {
-                    fCoinTree->Fill();
-                  }
-                }
-              }
+            if (coinEngine == CoinEngine::SweepLine) {
+              SweepCoincidence(mrSyncTime);
+
+            } else if (coinEngine == CoinEngine::Bitset) {
+              BitsetCoincidence(mrSyncTime);
+
+            } else {
+              fCoinEvents.clear();
+              ScanTimelines(fCoinEvents);
+              FillCoinEvents(fCoinEvents, mrSyncTime, drawCoinTimeline);
 
               if (mscountSelection <= fMrSyncCount) {
                 DrawTmpTimeline(0, 0);
@@ -944,14 +1014,22 @@ namespace Extinction {
 
             // std::cout << "[debug] Shift timeline" << std::endl;
             // Shift timeline
-            {
-              fBh1Timeline.Clear();
-              fBh2Timeline.Clear();
-              fTc1Timeline.Clear();
-              fTc2Timeline.Clear();
-            }
-            for (std::size_t ch = 0; ch < ExtinctionDetector::NofChannels; ++ch) {
-              fExtTimeline[ch].Clear();
+            if (coinEngine == CoinEngine::SweepLine) {
+              for (auto&& hits : fSweepHits) {
+                hits.clear();
+              }
+            } else if (coinEngine == CoinEngine::Bitset) {
+              ClearBitsetTimelines();
+            } else {
+              {
+                fBh1Timeline.Clear();
+                fBh2Timeline.Clear();
+                fTc1Timeline.Clear();
+                fTc2Timeline.Clear();
+              }
+              for (std::size_t ch = 0; ch < ExtinctionDetector::NofChannels; ++ch) {
+                fExtTimeline[ch].Clear();
+              }
             }
           }
 
@@ -972,8 +1050,8 @@ namespace Extinction {
             reader->ClearLastSpill();
             // std::cout << "[debug] Throw away first mr sync" << std::endl;
             // Throw away first mr sync
-            reader->Read(tdcDataInMrSync);
-            tdcDataInMrSync.clear();
+            reader->Read(hitsInMrSync);
+            hitsInMrSync.Clear();
 
             fDate        = reader->GetDate();
             fEMCount     = reader->GetEMCount();
@@ -990,12 +1068,510 @@ namespace Extinction {
         }
       }
 
+      if (coinEngine == CoinEngine::Bitset && fCoinCrossCheck) {
+        std::cout << "[info] cross check of bitset engine, " << fCrossCheckErrors << " mismatched coincidences" << std::endl;
+      }
+
       const clock_t stopClock = clock();
       std::cout << "time: " << (double)(stopClock - startClock) / CLOCKS_PER_SEC << " sec\n";
 
       return 0;
     }
 
+    void TimelineCoincidence::ScanTimelines(std::vector<CoinEvent_t>& events) {
+      const Long64_t xmax = fBh1Timeline.Size();
+
+      Bool_t hitBh1 = false, hitBh2 = false, hitTc1 = false, hitTc2 = false, hitExt = false;
+      auto isCoincident =
+        [&] (Int_t i) {
+          {
+            hitBh1 = fBh1Timeline.HasHit(i);
+            hitBh2 = fBh2Timeline.HasHit(i);
+            hitExt = std::any_of(fExtTimeline.begin(), fExtTimeline.end(), [&](Timeline_t& tl) { return tl.HasHit(i); });
+            hitTc1 = fTc1Timeline.HasHit(i);
+            hitTc2 = fTc2Timeline.HasHit(i);
+          }
+
+          return
+            (hitBh1 || !fCoincidenceTargetBh1 || fEfficiencyTargetBh1) &&
+            (hitBh2 || !fCoincidenceTargetBh2 || fEfficiencyTargetBh2) &&
+         // (hitHod || !fCoincidenceTargetHod || fEfficiencyTargetHod) &&
+            (hitExt || !fCoincidenceTargetExt || fEfficiencyTargetExt) &&
+            (hitTc1 || !fCoincidenceTargetTc1 || fEfficiencyTargetTc1) &&
+            (hitTc2 || !fCoincidenceTargetTc2 || fEfficiencyTargetTc2);
+        };
+
+      // std::cout << "[debug] seek timeline" << std::endl;
+      for (Long64_t dtdc = 0; dtdc < xmax; ++dtdc) {
+
+        if (isCoincident(dtdc)) {
+          events.push_back({ dtdc, 0, -1, false, {} });
+          CoinEvent_t& event = events.back();
+
+          // std::cout << "[debug] skip dead time" << std::endl;
+          // Skip dead time
+          auto fillCoincidenceData =
+            [&] (Timeline_t& tl) {
+              if (tl.HasHit(dtdc)) {
+                const std::pair<Int_t, Long64_t> tag { tl.fTdcFromMrSyncs[dtdc], tl.fChannel };
+                event.Hits.emplace(tag, CoinHit_t { tl.fMrSyncCounts[dtdc], tl.fTdcFromMrSyncs[dtdc], tl.fTots[dtdc] });
+              }
+            };
+          for (; dtdc < xmax; ++dtdc) {
+            if (isCoincident(dtdc)) {
+              ++event.Width;
+
+              // std::cout << "[debug] fill coincidence data" << std::endl;
+              for (std::size_t ch = 0; ch < ExtinctionDetector::NofChannels; ++ch) {
+                fillCoincidenceData(fExtTimeline[ch]);
+              }
+              fillCoincidenceData(fTc1Timeline);
+              fillCoincidenceData(fTc2Timeline);
+              fillCoincidenceData(fBh1Timeline);
+              fillCoincidenceData(fBh2Timeline);
+
+              if (event.EfficiencyBin < 0) {
+                if      (fEfficiencyTargetBh1 && hitBh1) { event.EfficiencyBin = 0; }
+                else if (fEfficiencyTargetBh2 && hitBh2) { event.EfficiencyBin = 1; }
+             // else if (fEfficiencyTargetHod && hitHod) { event.EfficiencyBin = 2; }
+                else if (fEfficiencyTargetExt && hitExt) { event.EfficiencyBin = 3; }
+                else if (fEfficiencyTargetTc1 && hitTc1) { event.EfficiencyBin = 4; }
+                else if (fEfficiencyTargetTc2 && hitTc2) { event.EfficiencyBin = 5; }
+              }
+
+            } else {
+              event.Closed = true;
+              break;
+            }
+          }
+        }
+      }
+    }
+
+    void TimelineCoincidence::FillCoinEvents(const std::vector<CoinEvent_t>& events, Double_t mrSyncTime, Bool_t drawCoinTimeline) {
+      for (auto&& event : events) {
+        ClearCoinEvent();
+
+        fTdcFromMrSync = event.Tdc;
+        hCoinTlTdcInSync->Fill(event.Tdc);
+        hCoinTlMountain ->Fill(event.Tdc, mrSyncTime / msec);
+        ++fSpillData.CoinCount;
+
+        if (drawCoinTimeline) {
+          DrawTmpTimeline(event.Tdc, 2 * fCoinTdcWidth);
+          gPad->WaitPrimitive();
+        }
+
+        fCoinWidth = event.Width;
+
+        if (event.EfficiencyBin >= 0) {
+          hEfficiency->Fill(true, event.EfficiencyBin);
+        } else if (event.Closed) {
+          if (fEfficiencyTargetBh1) { hEfficiency->Fill(false, 0); }
+          if (fEfficiencyTargetBh2) { hEfficiency->Fill(false, 1); }
+       // if (fEfficiencyTargetHod) { hEfficiency->Fill(false, 2); }
+          if (fEfficiencyTargetExt) { hEfficiency->Fill(false, 3); }
+          if (fEfficiencyTargetTc1) { hEfficiency->Fill(false, 4); }
+          if (fEfficiencyTargetTc2) { hEfficiency->Fill(false, 5); }
+        }
+
+        FillCoinEvent(event.Hits, mrSyncTime, event.Tdc + event.Width);
+      }
+    }
+
+    void TimelineCoincidence::FillCoinEvent(const CoinHits_t& hits, Double_t mrSyncTime, Long64_t dtdc) {
+      fBlurWidth = hits.empty() ? 0 : fTdcFromMrSync - hits.begin()->first.first;
+
+      for (auto&& pair : hits) {
+        auto& tag = pair.first;
+        auto& gch = tag.second;
+
+        if        (ExtinctionDetector::Contains(gch)) {
+          hCoinExtTdcInSync->Fill(pair.second.TdcFromMrSync);
+          hCoinExtMountain ->Fill(pair.second.TdcFromMrSync, mrSyncTime / msec);
+          ++fSpillData.ExtEntries;
+        } else if (BeamlineHodoscope::Contains(gch)) {
+          const Int_t bhch = BeamlineHodoscope::GetChannel(gch);
+          if (bhch == 0) {
+            ++fSpillData.Bh1Entries;
+          } else {
+            ++fSpillData.Bh2Entries;
+          }
+        } else if (TimingCounter::Contains(gch)) {
+          const Int_t tcch = TimingCounter::GetChannel(gch);
+          if (tcch == 0) {
+            ++fSpillData.Tc1Entries;
+          } else {
+            ++fSpillData.Tc2Entries;
+          }
+        }
+      }
+
+      for (auto&& pair : hits) {
+        auto& tag = pair.first;
+        auto& ch  = tag.second;
+
+        fHitChannels      [fNofHits] = ch;
+     // fHitMrSyncCounts  [fNofHits] = pair.second.MrSyncCount;
+        fHitTdcFromMrSyncs[fNofHits] = pair.second.TdcFromMrSync;
+        fHitTots          [fNofHits] = pair.second.Tot;
+        fNofHits++;
+
+        if (fNofHits == Detectors::NofChannels) {
+          std::cerr << "[warning] coincidence of too many multiple hit" << std::endl
+                    << "  # of hits    \t" << hits.size()       << std::endl
+                    << "  begin of dtdc\t" << dtdc - fCoinWidth << std::endl
+                    << "  end   of dtdc\t" << dtdc - 1          << std::endl
+                    << "  coin width   \t" << fCoinWidth        << std::endl
+                    << "  mr sync count\t" << fMrSyncCount      << std::endl;
+          Int_t ipair = 0;
+          for (auto&& pair2 : hits) {
+            std::cerr << (ipair++ == 0 ?  "  dtdc ch      \t" : "               \t") << std::setw(8) << pair2.first.first << "\t" << std::setw(3) << pair2.first.second << std::endl;
+          }
+          break;
+        }
+      }
+
+      if (fCoinTree) {
+        fCoinTree->Fill();
+      }
+    }
+
+    Timeline_t& TimelineCoincidence::GetSweepTimeline(std::size_t index) {
+      switch (index) {
+      case kSweepBh1: return fBh1Timeline;
+      case kSweepBh2: return fBh2Timeline;
+      case kSweepTc1: return fTc1Timeline;
+      case kSweepTc2: return fTc2Timeline;
+      default:        return fExtTimeline[index];
+      }
+    }
+
+    void TimelineCoincidence::AddSweepHit(std::size_t index, const TdcHit_t& data, Int_t width) {
+      // Same range as Timeline_t::FillHit
+      const Int_t x = data.GetTdcFromMrSync();
+      const Int_t last = std::min((std::size_t)(x + width), fBh1Timeline.Size());
+      if (x < 0 || last <= x) { return; }
+      fSweepHits[index].push_back({ x, last, data.Tdc, data.LastMrSyncCount, data.GetTdcFromMrSync(), data.Tot });
+    }
+
+    void TimelineCoincidence::ResolveSweepIntervals(std::size_t index) {
+      const std::vector<HitInterval_t>& hits      = fSweepHits     [index];
+      std::vector<HitInterval_t>&       intervals = fSweepIntervals[index];
+      intervals.clear();
+
+      Bool_t disjoint = true;
+      for (std::size_t i = 1, n = hits.size(); i < n && disjoint; ++i) {
+        disjoint = hits[i - 1].End <= hits[i].Start;
+      }
+      if (disjoint) {
+        for (auto&& hit : hits) {
+          if (hit.Tdc) {
+            intervals.push_back(hit);
+          }
+        }
+        return;
+      }
+
+      // Overlapped hits, the later one overwrites as Timeline_t::FillHit does
+      std::vector<Long64_t>& bounds = fSweepBounds;
+      bounds.clear();
+      for (auto&& hit : hits) {
+        bounds.push_back(hit.Start);
+        bounds.push_back(hit.End);
+      }
+      std::sort(bounds.begin(), bounds.end());
+      bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+      std::vector<std::size_t>& order = fSweepOrder;
+      order.resize(hits.size());
+      std::iota(order.begin(), order.end(), 0);
+      std::stable_sort(order.begin(), order.end(),
+                       [&](std::size_t i, std::size_t j) { return hits[i].Start < hits[j].Start; });
+
+      // Active hits sorted by fill order, the last one owns the bin
+      std::vector<std::size_t>& active = fSweepActive;
+      active.clear();
+      std::size_t next      = 0;
+      std::size_t lastOwner = hits.size();
+      for (std::size_t k = 0; k + 1 < bounds.size(); ++k) {
+        const Long64_t from = bounds[k];
+        const Long64_t to   = bounds[k + 1];
+        for (; next < order.size() && hits[order[next]].Start <= from; ++next) {
+          active.insert(std::lower_bound(active.begin(), active.end(), order[next]), order[next]);
+        }
+        while (!active.empty() && hits[active.back()].End <= from) {
+          active.pop_back();
+        }
+        if (active.empty() || !hits[active.back()].Tdc) {
+          lastOwner = hits.size();
+          continue;
+        }
+
+        const std::size_t owner = active.back();
+        if (owner == lastOwner && intervals.back().End == from) {
+          intervals.back().End = to;
+        } else {
+          intervals.push_back(hits[owner]);
+          intervals.back().Start = from;
+          intervals.back().End   = to;
+        }
+        lastOwner = owner;
+      }
+    }
+
+    void TimelineCoincidence::SweepCoincidence(Double_t mrSyncTime) {
+      const Long64_t xmax = fBh1Timeline.Size();
+
+      fSweepEdges.clear();
+      for (std::size_t index = 0; index < kNofSweepTimelines; ++index) {
+        ResolveSweepIntervals(index);
+        for (std::size_t i = 0, n = fSweepIntervals[index].size(); i < n; ++i) {
+          fSweepEdges.push_back({ fSweepIntervals[index][i].Start, true , index, i });
+          fSweepEdges.push_back({ fSweepIntervals[index][i].End  , false, index, i });
+        }
+      }
+      // End edges first, intervals are half-open
+      std::sort(fSweepEdges.begin(), fSweepEdges.end(),
+                [](const SweepEdge_t& a, const SweepEdge_t& b) {
+                  return a.Tdc != b.Tdc ? a.Tdc < b.Tdc : a.Start < b.Start;
+                });
+
+      const HitInterval_t* active[kNofSweepTimelines] = { nullptr };
+      std::size_t          nofExtHits                 = 0;
+
+      Bool_t     inCoin = false;
+      Bool_t     filled = false;
+      CoinHits_t hits;
+      std::size_t iedge = 0;
+      for (Long64_t from = 0, to = 0; from < xmax; from = to) {
+        for (; iedge < fSweepEdges.size() && fSweepEdges[iedge].Tdc <= from; ++iedge) {
+          const SweepEdge_t& edge = fSweepEdges[iedge];
+          active[edge.Index] = edge.Start ? &fSweepIntervals[edge.Index][edge.Interval] : nullptr;
+          if (edge.Index < ExtinctionDetector::NofChannels) {
+            edge.Start ? ++nofExtHits : --nofExtHits;
+          }
+        }
+        to = iedge < fSweepEdges.size() ? std::min(fSweepEdges[iedge].Tdc, xmax) : xmax;
+
+        const Bool_t hitBh1 = active[kSweepBh1];
+        const Bool_t hitBh2 = active[kSweepBh2];
+        const Bool_t hitExt = nofExtHits;
+        const Bool_t hitTc1 = active[kSweepTc1];
+        const Bool_t hitTc2 = active[kSweepTc2];
+        const Bool_t coincident =
+          (hitBh1 || !fCoincidenceTargetBh1 || fEfficiencyTargetBh1) &&
+          (hitBh2 || !fCoincidenceTargetBh2 || fEfficiencyTargetBh2) &&
+       // (hitHod || !fCoincidenceTargetHod || fEfficiencyTargetHod) &&
+          (hitExt || !fCoincidenceTargetExt || fEfficiencyTargetExt) &&
+          (hitTc1 || !fCoincidenceTargetTc1 || fEfficiencyTargetTc1) &&
+          (hitTc2 || !fCoincidenceTargetTc2 || fEfficiencyTargetTc2);
+
+        if (coincident) {
+          if (!inCoin) {
+            ClearCoinEvent();
+
+            fTdcFromMrSync = from;
+            hCoinTlTdcInSync->Fill(from);
+            hCoinTlMountain ->Fill(from, mrSyncTime / msec);
+            ++fSpillData.CoinCount;
+
+            fCoinWidth = 0;
+            inCoin     = true;
+            filled     = false;
+            hits.clear();
+          }
+          fCoinWidth += to - from;
+
+          // The first appearance of each hit is kept, as timeline engine does
+          for (std::size_t index = 0; index < kNofSweepTimelines; ++index) {
+            if (const HitInterval_t* interval = active[index]) {
+              const std::pair<Int_t, Long64_t> tag { interval->TdcFromMrSync, GetSweepTimeline(index).fChannel };
+              hits.emplace(tag, CoinHit_t { interval->MrSyncCount, interval->TdcFromMrSync, interval->Tot });
+            }
+          }
+
+          if (fEfficiencyTargetBh1 && hitBh1 && !filled) { hEfficiency->Fill(true, 0); filled = true; }
+          if (fEfficiencyTargetBh2 && hitBh2 && !filled) { hEfficiency->Fill(true, 1); filled = true; }
+       // if (fEfficiencyTargetHod && hitHod && !filled) { hEfficiency->Fill(true, 2); filled = true; }
+          if (fEfficiencyTargetExt && hitExt && !filled) { hEfficiency->Fill(true, 3); filled = true; }
+          if (fEfficiencyTargetTc1 && hitTc1 && !filled) { hEfficiency->Fill(true, 4); filled = true; }
+          if (fEfficiencyTargetTc2 && hitTc2 && !filled) { hEfficiency->Fill(true, 5); filled = true; }
+
+        } else if (inCoin) {
+          if (fEfficiencyTargetBh1 && !filled) { hEfficiency->Fill(false, 0); }
+          if (fEfficiencyTargetBh2 && !filled) { hEfficiency->Fill(false, 1); }
+       // if (fEfficiencyTargetHod && !filled) { hEfficiency->Fill(false, 2); }
+          if (fEfficiencyTargetExt && !filled) { hEfficiency->Fill(false, 3); }
+          if (fEfficiencyTargetTc1 && !filled) { hEfficiency->Fill(false, 4); }
+          if (fEfficiencyTargetTc2 && !filled) { hEfficiency->Fill(false, 5); }
+
+          FillCoinEvent(hits, mrSyncTime, from);
+          inCoin = false;
+        }
+      }
+
+      if (inCoin) {
+        FillCoinEvent(hits, mrSyncTime, xmax);
+      }
+    }
+
+    void TimelineCoincidence::AddBitsetHit(std::size_t index, const TdcHit_t& data, Int_t width) {
+      AddSweepHit(index, data, width);
+      if (!fHitBitsDirty[index]) {
+        fHitBitsDirty[index] = true;
+        fDirtyTimelines.push_back(index);
+      }
+    }
+
+    void TimelineCoincidence::ClearBitsetTimelines() {
+      // Only touched timelines have to be cleared
+      for (auto&& index : fDirtyTimelines) {
+        if (fCoinCrossCheck) {
+          GetSweepTimeline(index).Clear();
+        }
+        fSweepHits[index].clear();
+        fHitBits  [index].Clear();
+        fHitBitsDirty[index] = false;
+      }
+      fDirtyTimelines.clear();
+    }
+
+    void TimelineCoincidence::BitsetCoincidence(Double_t mrSyncTime) {
+      const std::size_t xmax   = fBh1Timeline.Size();
+      const std::size_t nwords = fCoinBits.NofWords();
+
+      // Hit bits from resolved intervals, later hits overwrite as Timeline_t::FillHit does
+      for (auto&& index : fDirtyTimelines) {
+        ResolveSweepIntervals(index);
+        for (auto&& interval : fSweepIntervals[index]) {
+          fHitBits[index].Assign(interval.Start, interval.End, true);
+        }
+      }
+
+      // OR of ext channels
+      fExtAnyBits.Clear();
+      ULong64_t* extAny = fExtAnyBits.Words();
+      for (auto&& index : fDirtyTimelines) {
+        if (index < ExtinctionDetector::NofChannels) {
+          const ULong64_t* ext = fHitBits[index].Words();
+          for (std::size_t w = 0; w < nwords; ++w) {
+            extAny[w] |= ext[w];
+          }
+        }
+      }
+
+      // AND of required detectors
+      const ULong64_t* bh1 = fHitBits[kSweepBh1].Words();
+      const ULong64_t* bh2 = fHitBits[kSweepBh2].Words();
+      const ULong64_t* tc1 = fHitBits[kSweepTc1].Words();
+      const ULong64_t* tc2 = fHitBits[kSweepTc2].Words();
+      const ULong64_t  anyBh1 = (!fCoincidenceTargetBh1 || fEfficiencyTargetBh1) ? ~0ULL : 0ULL;
+      const ULong64_t  anyBh2 = (!fCoincidenceTargetBh2 || fEfficiencyTargetBh2) ? ~0ULL : 0ULL;
+      const ULong64_t  anyExt = (!fCoincidenceTargetExt || fEfficiencyTargetExt) ? ~0ULL : 0ULL;
+      const ULong64_t  anyTc1 = (!fCoincidenceTargetTc1 || fEfficiencyTargetTc1) ? ~0ULL : 0ULL;
+      const ULong64_t  anyTc2 = (!fCoincidenceTargetTc2 || fEfficiencyTargetTc2) ? ~0ULL : 0ULL;
+      ULong64_t* coin = fCoinBits.Words();
+      for (std::size_t w = 0; w < nwords; ++w) {
+        coin[w] =
+          (bh1   [w] | anyBh1) &
+          (bh2   [w] | anyBh2) &
+          (extAny[w] | anyExt) &
+          (tc1   [w] | anyTc1) &
+          (tc2   [w] | anyTc2);
+      }
+      if (xmax & 63) {
+        coin[nwords - 1] &= (1ULL << (xmax & 63)) - 1;
+      }
+
+      // Order of efficiency targets, as timeline engine fills
+      const struct { Bool_t Target; const HitBitset_t* Bits; Int_t Bin; } efficiencyTargets[] = {
+        { fEfficiencyTargetBh1, &fHitBits[kSweepBh1], 0 },
+        { fEfficiencyTargetBh2, &fHitBits[kSweepBh2], 1 },
+        { fEfficiencyTargetExt, &fExtAnyBits        , 3 },
+        { fEfficiencyTargetTc1, &fHitBits[kSweepTc1], 4 },
+        { fEfficiencyTargetTc2, &fHitBits[kSweepTc2], 5 },
+      };
+
+      fCoinEvents.clear();
+      for (std::size_t from = fCoinBits.Find(0, xmax, true), to = 0; from < xmax; from = fCoinBits.Find(to, xmax, true)) {
+        to = fCoinBits.Find(from, xmax, false);
+        fCoinEvents.push_back({ (Long64_t)from, (Long64_t)(to - from), -1, to < xmax, {} });
+        CoinEvent_t& event = fCoinEvents.back();
+
+        // Hits are taken from intervals overlapping the run, the first appearance is kept as timeline engine does
+        for (auto&& index : fDirtyTimelines) {
+          const std::vector<HitInterval_t>& intervals = fSweepIntervals[index];
+          const Long64_t                    channel   = GetSweepTimeline(index).fChannel;
+          auto interval = std::upper_bound(intervals.begin(), intervals.end(), (Long64_t)from,
+                                           [](Long64_t tdc, const HitInterval_t& hit) { return tdc < hit.End; });
+          for (; interval != intervals.end() && interval->Start < (Long64_t)to; ++interval) {
+            const std::pair<Int_t, Long64_t> tag { interval->TdcFromMrSync, channel };
+            event.Hits.emplace(tag, CoinHit_t { interval->MrSyncCount, interval->TdcFromMrSync, interval->Tot });
+          }
+        }
+
+        // Efficiency is filled at the first bin where any target has a hit
+        std::size_t efficiencyFirst = to;
+        for (auto&& target : efficiencyTargets) {
+          if (target.Target) {
+            const std::size_t first = target.Bits->Find(from, efficiencyFirst, true);
+            if (first < efficiencyFirst) {
+              efficiencyFirst     = first;
+              event.EfficiencyBin = target.Bin;
+            }
+          }
+        }
+      }
+
+      if (fCoinCrossCheck) {
+        CrossCheckBitset();
+      }
+
+      FillCoinEvents(fCoinEvents, mrSyncTime, false);
+    }
+
+    void TimelineCoincidence::CrossCheckBitset() {
+      // Coincidences of timeline engine over the dense timelines filled alongside
+      fCheckEvents.clear();
+      ScanTimelines(fCheckEvents);
+
+      auto isSameHits =
+        [] (const CoinHits_t& hits1, const CoinHits_t& hits2) {
+          return hits1.size() == hits2.size() &&
+            std::equal(hits1.begin(), hits1.end(), hits2.begin(),
+                       [](const CoinHits_t::value_type& pair1, const CoinHits_t::value_type& pair2) {
+                         return pair1.first                == pair2.first                &&
+                                pair1.second.MrSyncCount   == pair2.second.MrSyncCount   &&
+                                pair1.second.TdcFromMrSync == pair2.second.TdcFromMrSync &&
+                                pair1.second.Tot           == pair2.second.Tot;
+                       });
+        };
+
+      Long64_t errors = 0;
+      for (std::size_t i = 0, n = std::max(fCoinEvents.size(), fCheckEvents.size()); i < n; ++i) {
+        if (i >= fCoinEvents.size() || i >= fCheckEvents.size()) {
+          ++errors;
+          continue;
+        }
+        const CoinEvent_t& event = fCoinEvents [i];
+        const CoinEvent_t& check = fCheckEvents[i];
+        if (event.Tdc           != check.Tdc           ||
+            event.Width         != check.Width         ||
+            event.EfficiencyBin != check.EfficiencyBin ||
+            event.Closed        != check.Closed        ||
+            !isSameHits(event.Hits, check.Hits)) {
+          ++errors;
+        }
+      }
+      if (errors) {
+        std::cerr << "[error] bitset engine mismatch, mr sync count " << fMrSyncCount << ", "
+                  << fCoinEvents.size() << " / " << fCheckEvents.size() << " coincidences, "
+                  << errors << " mismatched" << std::endl;
+      }
+      fCrossCheckErrors += errors;
+    }
+
     void TimelineCoincidence::DrawTmpTimeline(Int_t dtdc, Int_t range) {
       std::cout << "DrawTmpTimeline: MR Sync Count = " << fMrSyncCount << std::endl;
 
@@ -21,6 +21,7 @@
 #include "Detector.hh"
 #include "Tdc.hh"
 #include "Spill.hh"
+#include "MargedReader.hh"
 
 #include "Math.hh"
 #include "Linq.hh"
@@ -31,66 +32,36 @@ namespace Extinction {
 
   namespace Analyzer {
 
+    // Merge stage of a run, writes the board trees into one marged hit file by MargedReader.
+    // Sorting, mr sync alignment and tdc offsets are paid here once, then analyses read the file by MargedReader::OpenMarged.
     class TreeMarger {
     private:
       ITdcDataProvider*            fProvider               = nullptr;
-      TdcData                      fTdcData;
-
-      TFile*                       fMargedFile             = nullptr;
-      TTree*                       fMargedTree             = nullptr;
+      MargedReader                 fReader;
+      Bool_t                       fInitialized            = false;
 
       std::map<Int_t, Double_t>    fStdTimePerTdc;
 
-      std::size_t                  fBufferSize             = 5000;
-      std::size_t                  fBufferMargin           =  100;
-
-      std::map<Int_t, TdcData>     fInitEmData;
-      std::map<ULong64_t, TdcData> fTdcBuffer;
-
     public:
       TreeMarger(ITdcDataProvider* provider);
       ~TreeMarger();
 
       void                 SetTimePerTdc(const std::map<Int_t, Double_t>& map);
 
-      inline void          SetReadBufferSize(std::size_t size) {
-        std::cout << "SetReadBufferSize ... " << size << std::endl;
-        fBufferSize = size;
-      }
-      inline std::size_t   GetReadBufferSize() const { return fBufferSize; }
-
-      inline void          SetReadBufferMargin(std::size_t size) {
-        std::cout << "SetReadBufferMargin ... " << size << std::endl;
-        fBufferMargin = size;
-      }
-      inline std::size_t   GetReadBufferMargin() const { return fBufferMargin; }
+      // Timing tuning and prefetch are set on the reader
+      inline MargedReader* GetReader() { return &fReader; }
 
-      Int_t                ReadPlots(const std::string& ifilename);
       Int_t                InitializeTree(const std::string& filename,
-                                          const std::string& treename);
+                                          const std::string& treename = "mtree");
       void                 WriteTree();
 
       Int_t                MargeTree(std::map<Int_t, ITdcDataProvider*> providers,
                                      const std::map<Int_t, std::string>& ifilenames,
                                      const std::string& treename);
-
-    private:
-      void                 ClearLastSpill();
-
-      template <typename T, typename V>
-      inline bool          IsAllOfSecondsTrue(const std::map<T, V> map) {
-        return std::all_of(map.begin(), map.end(), [](std::pair<T, V> p) { return p.second; });
-      }
-      template <typename T, typename V>
-      inline void          FillToSeconds(std::map<T, V>* map, V value) {
-        for (auto&& pair : *map) {
-          pair.second = value;
-        }
-      }
     };
 
     TreeMarger::TreeMarger(ITdcDataProvider* provider)
-      : fProvider(provider) {
+      : fProvider(provider), fReader(provider) {
     }
 
     TreeMarger::~TreeMarger() {
@@ -108,37 +79,23 @@ namespace Extinction {
     Int_t TreeMarger::InitializeTree(const std::string& filename,
                                      const std::string& treename) {
       std::cout << "Initialize tree" << std::endl;
-      fMargedFile = new TFile(filename.data(), "RECREATE");
-      if (!fMargedFile->IsOpen()) {
-        std::cout << "[error] output file is not opened, " << filename << std::endl;
-        delete fMargedFile; fMargedFile = nullptr;
+      if (fReader.InitializeMargedTree(filename, treename)) {
         return 1;
       }
-
-      fMargedTree = new TTree(treename.data(), "");
-      fTdcData.CreateBranch(fMargedTree);
-      fMargedTree->AutoSave();
+      fInitialized = true;
       return 0;
     }
 
     void TreeMarger::WriteTree() {
-      if (fMargedFile && fMargedTree) {
-        fMargedFile->cd();
-        fMargedTree->Write();
-        fMargedFile->Close();
-        delete fMargedFile; fMargedFile = nullptr; fMargedTree = nullptr;
+      if (fInitialized) {
+        fReader.WriteMargedTree();
+        fInitialized = false;
       }
     }
 
-    void TreeMarger::ClearLastSpill() {
-      fTdcBuffer.clear();
-    }
-
     Int_t TreeMarger::MargeTree(std::map<Int_t, ITdcDataProvider*> providers,
                                 const std::map<int, std::string>& ifilenames,
                                 const std::string& treename) {
-      const clock_t startClock = clock();
-
       std::cout << "Initialize decoder" << std::endl;
       for (auto&& pair : ifilenames) {
         const Int_t board = pair.first;
@@ -149,201 +106,15 @@ namespace Extinction {
         }
       }
 
-      std::cout << "Initialzie history" << std::endl;
-      ClearLastSpill();
-
-      std::cout << "Open file" << std::endl;
-      std::map<Int_t, TFile*>   ifiles;
-      std::map<Int_t, TTree*>   itrees;
-      std::map<Int_t, Long64_t> entrieses;
-      for (auto&& pair : ifilenames) {
-        const Int_t       board     = pair.first;
-        const std::string ifilename = pair.second;
-        std::cout << " - " << ifilename << std::endl;
-
-        ifiles[board] = new TFile(ifilename.data(), "READ");
-        if (!ifiles[board]->IsOpen()) {
-          std::cerr << "[error] input file is not opened, " << ifilename << std::endl;
-          return 1;
-        }
-
-        itrees[board] = dynamic_cast<TTree*>(ifiles[board]->Get(treename.data()));
-        if (!itrees[board]) {
-          std::cerr << "[error] input tree is not found, " << ifilename << " - " << treename << std::endl;
-          return 1;
-        }
-
-        entrieses[board] = itrees[board]->GetEntries();
-        std::cout << " + " << entrieses[board] << std::endl;
-
-        providers[board]->SetBranchAddress(itrees[board]);
-      }
-      std::cout << " = " << Tron::Linq::From(entrieses).Sum([](std::pair<Int_t, Long64_t> p) { return p.second; }) << std::endl;
-
-      {
-        Int_t targetBoard = 0;
-        std::map<Int_t, std::size_t>          mrcount;
-        std::map<Int_t, Long64_t>             mrtdc;
-        std::map<Int_t, Long64_t>             entries;
-        std::map<Int_t, Long64_t>             lastSpills;
-        std::map<Int_t, Bool_t>               spillEnded;
-        std::map<Int_t, Bool_t>               fileEnded;
-        std::map<Int_t, ULong64_t>            lastTdcTags;
-        std::map<Int_t, std::vector<TdcData>> firstData;
-        for (auto&& pair : ifilenames) {
-          targetBoard = pair.first;
-          entries         [pair.first] = 0;
-          lastSpills      [pair.first] = -1;
-          spillEnded      [pair.first] = false;
-          fileEnded       [pair.first] = false;
-          lastTdcTags     [pair.first] = 0;
-          firstData       [pair.first] = { };
-        }
-        // std::cout << "targetBoard = " << targetBoard << std::endl; 
-
-        Long64_t lastEMCount = -1;
-        for (std::size_t count = 0UL;;) {
-          {
-            ITdcDataProvider* provider   = providers  [targetBoard];
-            ULong64_t&        lastTdcTag = lastTdcTags[targetBoard];
-            Long64_t&         lastSpill  = lastSpills [targetBoard];
-            TTree*            itree      = itrees     [targetBoard];
-            Long64_t&         entry      = entries    [targetBoard];
-            const Long64_t    ientries   = entrieses  [targetBoard];
-            for (std::size_t ibuf = 0; ibuf < fBufferSize; ++ibuf, ++count, ++entry) {
-              if (count % 1000000UL == 0) {
-                std::cout << ">> " << count << std::endl;
-              }
-
-              if (entry >= ientries) {
-                std::cout << "[info] detect file end @ " << targetBoard << std::endl;
-                fileEnded[targetBoard] = true;
-                break;
-
-              } else if (!itree->GetEntry(entry)) {
-                std::cout << "[info] detect file end @ " << targetBoard << " (TTree::GetEntry)" << std::endl;
-                fileEnded[targetBoard] = true;
-                break;
-
-              }
-
-              if (!provider->IsData()) {
-                continue;
-
-              } else if (lastSpill != -1 && lastSpill != provider->GetSpill()) {
-                std::cout << "[info] detect spill end @ " << targetBoard << std::endl;
-                lastSpill               = provider->GetSpill();
-                spillEnded[targetBoard] = true;
-                firstData [targetBoard] = provider->GetTdcData(targetBoard);
-                fInitEmData.clear();
-                break;
-
-              } else {
-                // std::cout << "[info] detect data @ " << targetBoard << std::endl;
-                if (lastSpill != -1 && lastEMCount != provider->GetEMCount()) {
-                  std::cout << "[error] conflict EMCount, " << lastEMCount << " <--> " << provider->GetEMCount() << std::endl;
-                  exit(1);
-                }
-                lastSpill    = provider->GetSpill();
-                lastEMCount  = provider->GetEMCount();
-                auto tdcData = provider->GetTdcData(targetBoard);
-
-                for (auto&& data : tdcData) {
-                  if (MrSync::Contains(data.Channel)) {
-                    mrcount[data.Board]++;
-                    mrtdc  [data.Board] = data.Tdc;
-                  }
-                }
-
-                ULong64_t tdcTag = 0;
-                for (auto&& data : tdcData) {
-                  tdcTag             = data.GetTdcTag(mrcount[data.Board], mrtdc[data.Board]);
-                  fTdcBuffer[tdcTag] = data;
-                }
-                if (ibuf < fBufferSize - fBufferMargin) {
-                  lastTdcTag = tdcTag;
-                }
-              }
-            }
-          }
-
-          {
-            Int_t boardNotLoadedYet = -1;
-            for (auto&& pair : lastTdcTags) {
-              const Int_t board = pair.first;
-              if (pair.second == 0 &&
-                  !(spillEnded[board] || fileEnded[board])) {
-                boardNotLoadedYet = board;
-                break;
-              }
-            }
-            if (boardNotLoadedYet >= 0) {
-              // std::cout << "[info] there is a board not loaded yet @ " << boardNotLoadedYet << std::endl;
-              targetBoard = boardNotLoadedYet;
-              // std::cout << "targetBoard = " << targetBoard << std::endl; 
-              continue;
-            }
-          }
-
-          for (auto&& itr = fTdcBuffer.begin(); itr != fTdcBuffer.end(); itr = fTdcBuffer.begin()) {
-            const ULong64_t tdcTag = itr->first;
-            const TdcData&  data   = itr->second;
-            fTdcBuffer.erase(itr);
-
-            const Int_t board = data.Board;
-
-            fTdcData = data;
-            fMargedTree->Fill();
-
-            if (tdcTag == lastTdcTags[board] &&
-                !(spillEnded[board] || fileEnded[board])) {
-              // std::cout << "[info] detect read last buffer @ " << board << std::endl;
-              // std::cout << "lastTdcTag =  " << tdcTag << std::endl;
-              targetBoard = board;
-              break;
-            }
-          }
-
-          if (IsAllOfSecondsTrue(spillEnded) || IsAllOfSecondsTrue(fileEnded)) {
-            std::cout << "[info] end of spill" << std::endl;
-            mrcount.clear();
-            mrtdc  .clear();
-            for (auto&& pair : firstData) {
-              auto& board      = pair.first;
-              auto& tdcData    = pair.second;
-              auto& lastTdcTag = lastTdcTags[board];
-              for (auto&& data : tdcData) {
-                if (MrSync::Contains(data.Channel)) {
-                  mrcount[data.Board]++;
-                  mrtdc  [data.Board] = data.Tdc;
-                }
-                lastTdcTag = data.GetTdcTag(mrcount[data.Board], mrtdc[data.Board]);
-                fTdcBuffer[lastTdcTag] = data;
-              }
-              tdcData.clear();
-            }
-
-            if (IsAllOfSecondsTrue(fileEnded)) {
-              break;
-            }
-
-            // Clear buffers
-            ClearLastSpill();
-            FillToSeconds(&spillEnded , false);
-            FillToSeconds(&lastTdcTags, 0ULL );
-          }
-        }
+      if (fReader.Open(providers, ifilenames, treename)) {
+        return 1;
       }
 
-      std::cout << "Close files" << std::endl;
-      for (auto&& pair : ifiles) {
-        pair.second->Close();
-      }
+      const Int_t ret = fReader.MargeTree();
 
-      const clock_t stopClock = clock();
-      std::cout << "time: " << (double)(stopClock - startClock) / CLOCKS_PER_SEC << " sec\n";
+      fReader.Close();
 
-      return 0;
+      return ret;
     }
 
   }
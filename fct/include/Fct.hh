@@ -5,10 +5,12 @@
 #include <fstream>
 #include <string>
 #include <cstring>
+#include <algorithm>
 #include "TTree.h"
 #include "Units.hh"
 #include "Tdc.hh"
 #include "Detector.hh"
+#include "RawBuffer.hh"
 
 #include "ConfReader.hh"
 #include "String.hh"
@@ -34,6 +36,59 @@ namespace Extinction {
       std::map<Int_t/*board*/, std::map<Int_t/*raw*/, Int_t>> Veto;
       std::map<Int_t/*global*/, Int_t/*board*/>               Board;
 
+      // Dense raw -> global channel table of each board, built by Load(), -1 for unmapped
+      struct Lookup_t {
+        Int_t Channels[NofChannels];
+        Int_t MrSyncChannel;
+      };
+      std::vector<Lookup_t>                                   Lookup;
+
+      inline const Lookup_t* FindLookup(Int_t board) {
+        return (0 <= board && board < (Int_t)Lookup.size()) ? &Lookup[board] : nullptr;
+      }
+
+      void BuildLookup() {
+        Int_t maxBoard = -1;
+        for (auto&& map : { &Ext, &Hod, &Tc, &Bh, &MrSync, &Evm, &Veto }) {
+          if (!map->empty()) {
+            maxBoard = std::max(maxBoard, map->rbegin()->first);
+          }
+        }
+
+        Lookup_t empty;
+        std::fill(std::begin(empty.Channels), std::end(empty.Channels), -1);
+        empty.MrSyncChannel = -1;
+        Lookup.assign(maxBoard + 1, empty);
+
+        // Fill in reverse priority of GetTdcData, so that preferred detector overwrites
+        auto fill =
+          [&](const std::map<Int_t, std::map<Int_t, Int_t>>& map, Int_t offset) {
+            for (auto&& pair : map) {
+              if (pair.first < 0) {
+                continue;
+              }
+              for (auto&& rawCh : pair.second) {
+                if (0 <= rawCh.first && rawCh.first < (Int_t)NofChannels) {
+                  Lookup[pair.first].Channels[rawCh.first] = rawCh.second + offset;
+                }
+              }
+            }
+          };
+        fill(Veto  , Veto              ::GlobalChannelOffset);
+        fill(Evm   , EventMatch        ::GlobalChannelOffset);
+        fill(MrSync, MrSync            ::GlobalChannelOffset);
+        fill(Bh    , BeamlineHodoscope ::GlobalChannelOffset);
+        fill(Tc    , TimingCounter     ::GlobalChannelOffset);
+        fill(Hod   , Hodoscope         ::GlobalChannelOffset);
+        fill(Ext   , ExtinctionDetector::GlobalChannelOffset);
+
+        for (auto&& pair : MrSync) {
+          if (pair.first >= 0 && !pair.second.empty()) {
+            Lookup[pair.first].MrSyncChannel = pair.second.begin()->second + MrSync::GlobalChannelOffset;
+          }
+        }
+      }
+
       void Load(const Tron::ConfReader* conf, const std::vector<Int_t>& boards) {
         for (auto&& board : boards) {
           const std::string key = Form("ChannelMap.%d", board);
@@ -98,6 +153,8 @@ namespace Extinction {
         checkDouplicate("MRSync"            , MrSync, MrSync            ::NofChannels);
         checkDouplicate("EventMatch"        , Evm   , EventMatch        ::NofChannels);
         checkDouplicate("Veto"              , Veto  , Veto              ::NofChannels);
+
+        BuildLookup();
       }
     }
 
@@ -141,6 +198,21 @@ namespace Extinction {
           ((data & 0xf0000000) == 0xc0000000) ||
           ((data & 0xf0000000) == 0xd0000000);
       }
+      // Selects a if cond, otherwise b, by masks instead of branches
+      inline UInt_t Select(Bool_t cond, UInt_t a, UInt_t b) {
+        const UInt_t mask = 0U - (UInt_t)cond;
+        return (a & mask) | (b & ~mask);
+      }
+      // Type in the precedence of FctData::Read(), written with mask compares to vectorize over words
+      inline UChar_t GetType(Packet_t data) {
+        UInt_t type = DataType::Error;
+        type = Select((data & 0xe0000000) == 0xc0000000, DataType::Data     , type); // IsData()
+        type = Select(IsCarry    (data)                , DataType::Carry    , type);
+        type = Select(IsGateEnd  (data)                , DataType::GateEnd  , type);
+        type = Select(IsGateStart(data)                , DataType::GateStart, type);
+        type = Select(IsHeader   (data)                , DataType::Header   , type);
+        return type;
+      }
 
       inline Int_t GetCarry(Packet_t data) {
         return data & 0xff;
@@ -154,6 +226,36 @@ namespace Extinction {
 
     }
 
+    // Values of the tree branches of a word, kept by the decoder until the spill is filled
+    struct TreeRecord_t {
+      ULong64_t Date;
+      Int_t     Spill;
+      UChar_t   Type;
+      Int_t     Channel;
+      Int_t     Tdc;
+      Int_t     MrSyncCount;
+      Int_t     TdcFromMrSync;
+    };
+
+    // Columnar words decoded by FctData::ReadBatch(), a run of words up to the next gate start
+    struct WordBatch_t {
+      std::vector<UChar_t> Type;
+      std::vector<Int_t>   Channel;
+      std::vector<Int_t>   Tdc;
+      std::vector<Int_t>   Carry;
+
+      inline std::size_t Size() const {
+        return Type.size();
+      }
+
+      inline void Resize(std::size_t size) {
+        Type   .resize(size);
+        Channel.resize(size);
+        Tdc    .resize(size);
+        Carry  .resize(size);
+      }
+    };
+
     class FctData : public ITdcDataProvider {
     public:
       ULong64_t Date;
@@ -238,10 +340,8 @@ namespace Extinction {
         Channel = 0;
         Tdc     = 0;
         Carry   = 0;
-        for (std::size_t ch = 0; ch < NofChannels; ++ch) {
-          PreviousCarry[ch] = 0;
-          PreviousTdc  [ch] = 0;
-        }
+        std::fill(std::begin(PreviousCarry), std::end(PreviousCarry), 0);
+        std::fill(std::begin(PreviousTdc  ), std::end(PreviousTdc  ), 0);
       }
 
       inline void SetDataAsGateEnd(Packet_t) {
@@ -250,10 +350,12 @@ namespace Extinction {
 
       inline void SetDataAsCarry(Packet_t data) {
         Type  = DataType::Carry;
-        Carry = Packet::GetCarry(data);
-        for (std::size_t ch = 0; ch < NofChannels; ++ch) {
-          PreviousCarry[ch] = Carry - 1;
-        }
+        SetCarry(Packet::GetCarry(data));
+      }
+
+      inline void SetCarry(Int_t carry) {
+        Carry = carry;
+        std::fill(std::begin(PreviousCarry), std::end(PreviousCarry), Carry - 1);
         // std::cerr << "[info] Carry was detected, Carry " << Carry << std::endl;
         // std::cerr << "       PreviousTdc = ";
         // for (std::size_t ch = 0; ch < NofChannels; ++ch) {
@@ -263,15 +365,19 @@ namespace Extinction {
       }
 
       inline void SetDataAsData(Packet_t data) {
-        Type      = DataType::Data;
-        Channel   = Packet::GetChannel(data);
-        Int_t tdc = Packet::GetTdc(data);
+        Type    = DataType::Data;
+        Channel = Packet::GetChannel(data);
 
         if (Channel < 0 || (Long64_t)NofChannels <= Channel) {
           Type = DataType::Error;
           return;
         }
 
+        ExpandTdc(Packet::GetTdc(data));
+      }
+
+      // Sets Tdc of the current channel from the 24 bit tdc with the carry expansion
+      inline void ExpandTdc(Int_t tdc) {
         // Tdc = tdc + PreviousCarry[Channel] * 0x1000000;
         // if ((Long64_t)Tdc < PreviousTdc[Channel]) {
         //   PreviousCarry[Channel] = Carry;
@@ -331,27 +437,17 @@ namespace Extinction {
           return ret1;
         }
 
-        if        (Packet::IsHeader(buff)) {
-          SetDataAsHeader(buff);
-        } else if (Packet::IsGateStart(buff)) {
-          SetDataAsGateStart(buff);
+        SetDataAsWord(buff);
 #if FCT_FORMAT_VERSION == 1
-          // No time stamp
+        // No time stamp
 #else
+        if (Type == DataType::GateStart) {
           auto& ret2 = file.read((char*)&Date, sizeof(ULong64_t));
           if (!ret2) {
             return ret2;
           }
-#endif
-        } else if (Packet::IsGateEnd(buff)) {
-          SetDataAsGateEnd(buff);
-        } else if (Packet::IsCarry(buff)) {
-          SetDataAsCarry(buff);
-        } else if (Packet::IsData(buff)) {
-          SetDataAsData(buff);
-        } else {
-          Type = DataType::Error;
         }
+#endif
 
         if (packet) {
           *packet = buff;
@@ -360,6 +456,126 @@ namespace Extinction {
         return file;
       }
 
+      Bool_t Read(RawBuffer& buffer,
+                  Packet_t* packet = nullptr) {
+        const UChar_t* word = buffer.Take(sizeof(Packet_t));
+        if (!word) {
+          return false;
+        }
+
+        Packet_t buff;
+        std::memcpy(&buff, word, sizeof(Packet_t));
+
+        SetDataAsWord(buff);
+#if FCT_FORMAT_VERSION == 1
+        // No time stamp
+#else
+        if (Type == DataType::GateStart) {
+          const UChar_t* date = buffer.Take(sizeof(ULong64_t));
+          if (!date) {
+            return false;
+          }
+          std::memcpy(&Date, date, sizeof(ULong64_t));
+        }
+#endif
+
+        if (packet) {
+          *packet = buff;
+        }
+
+        return true;
+      }
+
+      // Extracts type, channel, tdc and carry of a block of words at once with mask compares,
+      // then applies the carry expansion to data words in a second pass.
+      // A gate start is decoded alone by Read(), since the date follows it. The data represents the last word of the batch.
+      std::size_t ReadBatch(RawBuffer& buffer, WordBatch_t& batch, std::size_t maxSize = 4096) {
+        std::size_t    length = 0;
+        const UChar_t* buff   = buffer.Peek(sizeof(Packet_t), length);
+        if (!buff) {
+          batch.Resize(0);
+          return 0;
+        }
+
+        // Extract all fields regardless of type
+        const std::size_t n = std::min(length / sizeof(Packet_t), maxSize);
+        batch.Resize(n);
+        UChar_t* types    = batch.Type   .data();
+        Int_t*   channels = batch.Channel.data();
+        Int_t*   tdcs     = batch.Tdc    .data();
+        Int_t*   carries  = batch.Carry  .data();
+        for (std::size_t i = 0; i < n; ++i) {
+          Packet_t word;
+          std::memcpy(&word, buff + i * sizeof(Packet_t), sizeof(Packet_t));
+          types   [i] = Packet::GetType   (word);
+          channels[i] = Packet::GetChannel(word);
+          tdcs    [i] = Packet::GetTdc    (word);
+          carries [i] = Packet::GetCarry  (word);
+        }
+
+        const std::size_t size = std::find(types, types + n, (UChar_t)DataType::GateStart) - types;
+        if (size == 0) {
+          if (!Read(buffer)) {
+            batch.Resize(0);
+            return 0;
+          }
+          batch.Resize(1);
+          batch.Type   [0] = Type;
+          batch.Channel[0] = Channel;
+          batch.Tdc    [0] = Tdc;
+          batch.Carry  [0] = Carry;
+          return 1;
+        }
+
+        // Expand tdc of data words by the carry in effect, other words hold the last values as Read() does
+        batch.Resize(size);
+        for (std::size_t i = 0; i < size; ++i) {
+          if (types[i] == DataType::Data) {
+            Channel = channels[i];
+            ExpandTdc(tdcs[i]);
+          } else if (types[i] == DataType::Carry) {
+            SetCarry(carries[i]);
+          }
+          channels[i] = Channel;
+          tdcs    [i] = Tdc;
+          carries [i] = Carry;
+        }
+        Type = types[size - 1];
+
+        buffer.Skip(size * sizeof(Packet_t));
+        return size;
+      }
+
+      inline void SetDataAsWord(const WordBatch_t& batch, std::size_t i) {
+        Type    = batch.Type   [i];
+        Channel = batch.Channel[i];
+        Tdc     = batch.Tdc    [i];
+        Carry   = batch.Carry  [i];
+      }
+
+      inline void SetDataAsWord(Packet_t data) {
+        switch (Packet::GetType(data)) {
+        case DataType::Header:
+          SetDataAsHeader(data);
+          break;
+        case DataType::GateStart:
+          SetDataAsGateStart(data);
+          break;
+        case DataType::GateEnd:
+          SetDataAsGateEnd(data);
+          break;
+        case DataType::Carry:
+          SetDataAsCarry(data);
+          break;
+        case DataType::Data:
+          SetDataAsData(data);
+          break;
+        default:
+          Type = DataType::Error;
+          break;
+        }
+      }
+
       inline virtual Bool_t IsData() const override {
         return Type == DataType::Data;
       }
@@ -402,9 +618,16 @@ namespace Extinction {
                   << "TDC = "     << Tdc     << std::endl;
       }
 
-      inline virtual std::vector<TdcData> GetTdcData(int board) const override {
-        using namespace ChannelMapWithBoard;
-        TdcData datum;
+      inline virtual std::vector<TdcData> GetTdcData(Int_t board) const override {
+        std::vector<TdcData> data;
+        AppendTdcData(board, data);
+        return data;
+      }
+
+      inline virtual void AppendTdcData(Int_t board, std::vector<TdcData>& data) const override {
+        const ChannelMapWithBoard::Lookup_t* lookup = ChannelMapWithBoard::FindLookup(board);
+        data.emplace_back();
+        TdcData& datum = data.back();
         datum.Date            = Date;
         datum.Spill           = Spill;
         datum.EMCount         = EMCount;
@@ -418,35 +641,12 @@ namespace Extinction {
         datum.LastMrSyncTdc   = MrSyncTdc;
         datum.NextMrSyncTdc   = 0;
         datum.TdcFromMrSync   = TdcFromMrSync;
-        typename decltype(MrSync      )::const_iterator itr1;
-        typename decltype(itr1->second)::const_iterator itr2;
-        if        ((itr1 = MrSync      .find(board  )) != MrSync      .end() &&
-                   (itr2 = itr1->second.begin()      ) != itr1->second.end()) {
-          datum.MrSyncChannel = itr2->second + MrSync::GlobalChannelOffset;
+        if (lookup && lookup->MrSyncChannel >= 0) {
+          datum.MrSyncChannel = lookup->MrSyncChannel;
         }
-        if        ((itr1 = Ext         .find(board  )) != Ext         .end() &&
-                   (itr2 = itr1->second.find(Channel)) != itr1->second.end()) {
-          datum.Channel     = itr2->second + ExtinctionDetector::GlobalChannelOffset;
-        } else if ((itr1 = Hod         .find(board  )) != Hod         .end() &&
-                   (itr2 = itr1->second.find(Channel)) != itr1->second.end()) {
-          datum.Channel     = itr2->second + Hodoscope         ::GlobalChannelOffset;
-        } else if ((itr1 = Tc          .find(board  )) != Tc          .end() &&
-                   (itr2 = itr1->second.find(Channel)) != itr1->second.end()) {
-          datum.Channel     = itr2->second + TimingCounter     ::GlobalChannelOffset;
-        } else if ((itr1 = Bh          .find(board  )) != Bh          .end() &&
-                   (itr2 = itr1->second.find(Channel)) != itr1->second.end()) {
-          datum.Channel     = itr2->second + BeamlineHodoscope ::GlobalChannelOffset;
-        } else if ((itr1 = MrSync      .find(board  )) != MrSync      .end() &&
-                   (itr2 = itr1->second.find(Channel)) != itr1->second.end()) {
-          datum.Channel     = itr2->second + MrSync            ::GlobalChannelOffset;
-        } else if ((itr1 = Evm         .find(board  )) != Evm         .end() &&
-                   (itr2 = itr1->second.find(Channel)) != itr1->second.end()) {
-          datum.Channel     = itr2->second + EventMatch        ::GlobalChannelOffset;
-        } else if ((itr1 = Veto        .find(board  )) != Veto        .end() &&
-                   (itr2 = itr1->second.find(Channel)) != itr1->second.end()) {
-          datum.Channel     = itr2->second + Veto              ::GlobalChannelOffset;
+        if (lookup && 0 <= Channel && Channel < (Int_t)NofChannels && lookup->Channels[Channel] >= 0) {
+          datum.Channel       = lookup->Channels[Channel];
         }
-        return { datum };
       }
 
       inline virtual Int_t FindBoard(Int_t globalChannel) const override {
@@ -469,6 +669,18 @@ namespace Extinction {
      // tree->Branch("mstdc"  , &MrSyncTdc    , "mstdc"  "/I");
         tree->Branch("dtdc"   , &TdcFromMrSync, "dtdc"   "/I");
       }
+      inline TreeRecord_t GetTreeRecord() const {
+        return { Date, Spill, Type, Channel, Tdc, MrSyncCount, TdcFromMrSync };
+      }
+      inline void SetTreeRecord(const TreeRecord_t& record) {
+        Date          = record.Date;
+        Spill         = record.Spill;
+        Type          = record.Type;
+        Channel       = record.Channel;
+        Tdc           = record.Tdc;
+        MrSyncCount   = record.MrSyncCount;
+        TdcFromMrSync = record.TdcFromMrSync;
+      }
       inline TBranch* AddEMBranch(TTree* tree) {
         return tree->Branch("emcount", &EMCount, "emcount/I");
       }
@@ -561,6 +773,15 @@ namespace Extinction {
                                             Packet_t* packet = nullptr) {
         return Data.Read(file, packet);
       }
+
+      inline Bool_t Read(RawBuffer& buffer,
+                         Packet_t* packet = nullptr) {
+        return Data.Read(buffer, packet);
+      }
+
+      inline std::size_t ReadBatch(RawBuffer& buffer, WordBatch_t& batch) {
+        return Data.ReadBatch(buffer, batch);
+      }
     };
     
   }
@@ -4,7 +4,13 @@
 #include <iostream>
 #include <fstream>
 #include <time.h>
+#include <csignal>
+#include <pthread.h>
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <limits>
 
 #include "TROOT.h"
 #include "TApplication.h"
@@ -17,6 +23,7 @@
 #include "TGraphErrors.h"
 
 #include "Linq.hh"
+#include "RawFileStream.hh"
 #include "Units.hh"
 #include "Detector.hh"
 #include "Tdc.hh"
@@ -56,9 +63,6 @@ namespace Extinction {
         } TimeDiff;
       };
 
-    private:
-      static const std::size_t kHistLimit = 10000;
-
     private:
       using CoinOffset = Analyzer::AnaTimeOffset::CoinOffset;
       using CoinInfo   = Analyzer::AnaCoin::CoinInfo;
@@ -85,6 +89,7 @@ namespace Extinction {
 
       FctData                      fProvider;
       CoinDiffs                    fStdCoinDiffs;
+      std::map<std::size_t/*index*/, std::pair<Double_t, Double_t>> fExtCoinDiffRanges; // min and max over ext channels
       Contains                     fContains;
 
       TApplication*                fApplication         = nullptr;
@@ -127,6 +132,24 @@ namespace Extinction {
       TH1**                        hMrSyncInterval      = nullptr;
       TH2**                        hExtTdcOffset        = nullptr;
 
+      // Plots above are filled by the worker thread running UpdatePlots.
+      // The worker copies them to "Staged" at every end of spill, and the gui thread copies "Staged" to "Shown" and draws "Shown",
+      // so drawing never blocks decoding and the worker never touches objects in pads.
+      struct PlotBuffer_t {
+        TObject* Staged;
+        TObject* Shown;
+      };
+      std::map<const TObject*, PlotBuffer_t> fPlotBuffers;
+      std::mutex                   fStagedMutex;
+      std::atomic<Bool_t>          fStagedUpdated       { false };
+      Bool_t                       fPublishPending      = false;
+      TDatime                      fStagedDate;
+      TDatime                      fShownDate;
+      Int_t                        fStagedEventMatchNumber = -1;
+      Int_t                        fShownEventMatchNumber  = -1;
+      std::thread                  fWorker;
+      std::atomic<Bool_t>          fIsUpdating          { false };
+
       TDatime                      fDate;
       Long64_t                     fSpillCount          = 0;
       Long64_t                     fPreCoinCount        = 0;
@@ -140,16 +163,17 @@ namespace Extinction {
       Double_t                     fStdBunchCenters[SpillData::kNofBunches] = { 0 };
       Double_t                     fStdBunchWidths [SpillData::kNofBunches] = { 0 };
       std::map<ULong64_t, TdcData> fTdcBuffer;
+      std::vector<TdcData>         fTdcData;
 
-      std::vector<TdcData>         fLastExtData;
-      std::vector<TdcData>         fLastHodData;
-      std::vector<TdcData>         fLastTcData;
-      std::vector<TdcData>         fLastBhData;
+      TdcBoardHistory_t            fLastExtData;
+      TdcBoardHistory_t            fLastHodData;
+      TdcBoardHistory_t            fLastTcData;
+      TdcBoardHistory_t            fLastBhData;
       std::map<Int_t, TdcData>     fLastMrSyncData;
       std::map<Int_t, std::size_t> fLastMrSyncCount;
       std::map<Int_t, std::vector<TdcData>> fEventMatchData;
 
-      Bool_t                       fIsTerminated        = false;
+      std::atomic<Bool_t>          fIsTerminated        { false };
       ChannelAlign                 fChannelAlign        = ChannelAlign::Raw;
       MonitorMode                  fMonitorMode         = MonitorMode::Coincidence;
       Int_t                        fMonitorChannel      = -1; // global channel
@@ -168,6 +192,9 @@ namespace Extinction {
       Bool_t                       fAccumulate          = false; 
       Bool_t                       fLeakageMode         = false;
 
+      // Tail-following mode, set if input files are read while being written
+      std::function<Bool_t(const std::string&)> fIsFileFinished;
+
     public:
       MonitorWindow();
       ~MonitorWindow();
@@ -242,14 +269,28 @@ namespace Extinction {
       std::string          GetMrSyncIntervalFilename() const { return fMrSyncIntervalFilename; }
       std::string          GetCoinDiffsFilename() const { return fCoinDiffsFilename; }
 
+      // Follow growing input files, isFinished(filename) tells that the writer has closed the file.
+      // Appended packets are decoded as they come and plots are drawn at every end of spill.
+      void                 SetFollowMode(const std::function<Bool_t(const std::string&)>& isFinished) {
+        std::cout << "SetFollowMode\t" << (Bool_t)isFinished << std::endl;
+        fIsFileFinished = isFinished;
+      }
+      inline Bool_t        IsFollowMode() const { return (Bool_t)fIsFileFinished; }
+
       Int_t                LoadOffset(const std::string& ffilename);
       void                 InitializeWindow(Int_t width = 1600, Int_t height = 1200);
       void                 InitializePlots(const PlotsProfiles& profile);
 
       void                 DrawPlots();
+      // Draw plots if the worker has published new ones, call from the gui thread
+      void                 DrawUpdatedPlots();
 
       Int_t                UpdatePlots(const std::map<Int_t, std::string>& ifilenames,
                                        const std::function<TDatime(const std::string&)>& parser = nullptr);
+      // Run UpdatePlots on the worker thread
+      void                 StartUpdatePlots(const std::map<Int_t, std::string>& ifilenames,
+                                            const std::function<TDatime(const std::string&)>& parser = nullptr);
+      inline Bool_t        IsUpdating() const { return fIsUpdating; }
 
       inline void          Run() { fApplication->Run(true); }
 
@@ -262,9 +303,21 @@ namespace Extinction {
       }
 
     private:
+      void                 RegisterPlot(TObject* object);
+      void                 PublishPlots(Bool_t wait = false);
+      static void          CopyPlot(const TObject* source, TObject* target);
+      template <typename T>
+      inline T*            Shown(T* object) const {
+        return static_cast<T*>(fPlotBuffers.at(object).Shown);
+      }
+
       void                 ClearLastSpill();
       void                 FillCoincidence(const TdcData& tdcData);
-      std::size_t          RemoveOldTdc(std::vector<TdcData>* lastData, const TdcData& tdc);
+      std::size_t          RemoveOldTdc(TdcBoardHistory_t* lastData, const TdcData& tdc);
+      Double_t             GetTimeDifference(const TdcData& lastTdc, const TdcData& tdc);
+      template <typename Function>
+      void                 ForEachInWindow(const TdcBoardHistory_t& lastData, const TdcData& tdc,
+                                           Double_t lower, Double_t upper, Function function);
 
       Bool_t               InBunch(Double_t timeFromMrSync) const {
         for (std::size_t bunch = 0; bunch < SpillData::kNofBunches; ++bunch) {
@@ -290,14 +343,15 @@ namespace Extinction {
     };
 
     MonitorWindow::MonitorWindow() {
+      ROOT::EnableThreadSafety();
       fApplication = new TApplication("monitor", nullptr, nullptr);
-      fLastExtData.reserve(100);
-      fLastHodData.reserve(100);
-      fLastTcData .reserve(100);
-      fLastBhData .reserve(100);
     }
 
     MonitorWindow::~MonitorWindow() {
+      fIsTerminated = true;
+      if (fWorker.joinable()) {
+        fWorker.join();
+      }
       delete fApplication;
       fApplication = nullptr;
     }
@@ -386,6 +440,23 @@ namespace Extinction {
         }
       }
 
+      // Ext hits in coincidence with a hit of the index are looked up within these offsets
+      fExtCoinDiffRanges.clear();
+      for (std::size_t index = 0; index < CoinOffset::N; ++index) {
+        Double_t minDiff = +std::numeric_limits<Double_t>::max();
+        Double_t maxDiff = -std::numeric_limits<Double_t>::max();
+        for (std::size_t extCh = 0; extCh < ExtinctionDetector::NofChannels; ++extCh) {
+          Double_t diff = 0.0;
+          const auto itr = fStdCoinDiffs.find(extCh);
+          if (itr != fStdCoinDiffs.end() && itr->second.find(index) != itr->second.end()) {
+            diff = itr->second.at(index);
+          }
+          minDiff = std::min(minDiff, diff);
+          maxDiff = std::max(maxDiff, diff);
+        }
+        fExtCoinDiffRanges[index] = { minDiff, maxDiff };
+      }
+
       for (std::size_t extCh = 0; extCh < ExtinctionDetector::NofChannels; ++extCh) {
         for (std::size_t index = 0; index < CoinOffset::N; ++index) {
           fContains[extCh][index] = false;
@@ -664,146 +735,277 @@ namespace Extinction {
           hExtTdcOffset[ch]->SetStats(false);
         }
       }
+
+      RegisterPlot(hExtTdcInSpill_Any);
+      RegisterPlot(hHodTdcInSpill_Any);
+      for (std::size_t ch = 0; ch < TimingCounter::NofChannels; ++ch) {
+        RegisterPlot(hTcTdcInSpill[ch]);
+      }
+      for (std::size_t ch = 0; ch < BeamlineHodoscope::NofChannels; ++ch) {
+        RegisterPlot(hBhTdcInSpill[ch]);
+      }
+      RegisterPlot(hExtHitMap);
+      RegisterPlot(hExtEntryByCh);
+      RegisterPlot(hExtEntryByChBottom);
+      RegisterPlot(hExtEntryByChCenter1);
+      RegisterPlot(hExtEntryByChCenter2);
+      RegisterPlot(hExtEntryByChTop);
+      RegisterPlot(hHodHitMap);
+      RegisterPlot(hHodEntryByCh);
+      RegisterPlot(hExtMountain_Any);
+      RegisterPlot(hExtTdcInSync_Any);
+      RegisterPlot(gHitInSpill);
+      if (hMountain) {
+        RegisterPlot(hMountain);
+        RegisterPlot(hTdcInSync);
+        RegisterPlot(hTdcInSpill);
+      }
+      if (hMrSyncInterval) {
+        for (std::size_t ch = 0; ch < MrSync::NofChannels; ++ch) {
+          RegisterPlot(hMrSyncInterval[ch]);
+        }
+      }
+      if (hExtTdcOffset) {
+        for (std::size_t ch = 0; ch < ExtinctionDetector::NofChannels; ++ch) {
+          RegisterPlot(hExtTdcOffset[ch]);
+        }
+      }
+    }
+
+    void MonitorWindow::RegisterPlot(TObject* object) {
+      PlotBuffer_t buffer;
+      buffer.Staged = object->Clone(Form("%s_staged", object->GetName()));
+      buffer.Shown  = object->Clone(Form("%s_shown" , object->GetName()));
+      if (auto hist = dynamic_cast<TH1*>(buffer.Staged)) {
+        hist->SetDirectory(nullptr);
+      }
+      if (auto hist = dynamic_cast<TH1*>(buffer.Shown)) {
+        hist->SetDirectory(nullptr);
+      }
+      fPlotBuffers[object] = buffer;
+    }
+
+    void MonitorWindow::CopyPlot(const TObject* source, TObject* target) {
+      if        (auto hist  = dynamic_cast<const TH1*>(source)) {
+        auto targetHist = static_cast<TH1*>(target);
+        targetHist->Reset();
+        targetHist->Add(hist);
+      } else if (auto graph = dynamic_cast<const TGraphErrors*>(source)) {
+        auto targetGraph = static_cast<TGraphErrors*>(target);
+        const Int_t n = graph->GetN();
+        targetGraph->Set(n);
+        for (Int_t i = 0; i < n; ++i) {
+          targetGraph->SetPoint     (i, graph->GetX ()[i], graph->GetY ()[i]);
+          targetGraph->SetPointError(i, graph->GetEX()[i], graph->GetEY()[i]);
+        }
+      }
+    }
+
+    void MonitorWindow::PublishPlots(Bool_t wait) {
+      std::unique_lock<std::mutex> lock(fStagedMutex, std::defer_lock);
+      if (wait) {
+        lock.lock();
+      } else if (!lock.try_lock()) {
+        // Gui thread is taking the last plots, retry later not to stall decoding
+        fPublishPending = true;
+        return;
+      }
+      for (auto&& pair : fPlotBuffers) {
+        CopyPlot(pair.first, pair.second.Staged);
+      }
+      fStagedDate             = fDate;
+      fStagedEventMatchNumber = fEventMatchNumber;
+      fPublishPending         = false;
+      fStagedUpdated          = true;
+    }
+
+    void MonitorWindow::DrawUpdatedPlots() {
+      if (!fStagedUpdated.exchange(false)) {
+        return;
+      }
+      {
+        std::lock_guard<std::mutex> lock(fStagedMutex);
+        for (auto&& pair : fPlotBuffers) {
+          CopyPlot(pair.second.Staged, pair.second.Shown);
+        }
+        fShownDate             = fStagedDate;
+        fShownEventMatchNumber = fStagedEventMatchNumber;
+      }
+      DrawPlots();
+    }
+
+    void MonitorWindow::StartUpdatePlots(const std::map<Int_t, std::string>& ifilenames,
+                                         const std::function<TDatime(const std::string&)>& parser) {
+      if (fWorker.joinable()) {
+        fWorker.join();
+      }
+      fIsUpdating = true;
+
+      // Leave timer signals, which drive the gui, to the gui thread.
+      // The mask is inherited from the creating thread, so block it before the worker starts.
+      sigset_t signals, oldSignals;
+      sigemptyset(&signals);
+      sigaddset(&signals, SIGALRM);
+      pthread_sigmask(SIG_BLOCK, &signals, &oldSignals);
+      fWorker = std::thread([this, ifilenames, parser]() {
+          try {
+            UpdatePlots(ifilenames, parser);
+          } catch (...) {
+            std::cerr << "[error] exception while updating plots" << std::endl;
+            Terminate();
+          }
+          fIsUpdating = false;
+        });
+      pthread_sigmask(SIG_SETMASK, &oldSignals, nullptr);
     }
 
     void MonitorWindow::DrawPlots() {
       std::cout << "Draw plots" << std::endl;
       Int_t padnumber = 0;
 
-      if (fEventMatchNumber >= 0) {
+      if (fShownEventMatchNumber >= 0) {
         fCanvas->SetTitle((fProvider.GetName() + " | Semi-online Monitor" +
                            Form(" (%04d/%02d/%02d %02d:%02d:%02d - %d)",
-                                fDate.GetYear(),
-                                fDate.GetMonth(),
-                                fDate.GetDay(),
-                                fDate.GetHour(),
-                                fDate.GetMinute(),
-                                fDate.GetSecond(),
-                                fEventMatchNumber)).data());
+                                fShownDate.GetYear(),
+                                fShownDate.GetMonth(),
+                                fShownDate.GetDay(),
+                                fShownDate.GetHour(),
+                                fShownDate.GetMinute(),
+                                fShownDate.GetSecond(),
+                                fShownEventMatchNumber)).data());
       } else {
         fCanvas->SetTitle((fProvider.GetName() + " | Semi-online Monitor" +
                            Form(" (%04d/%02d/%02d %02d:%02d:%02d)",
-                                fDate.GetYear(),
-                                fDate.GetMonth(),
-                                fDate.GetDay(),
-                                fDate.GetHour(),
-                                fDate.GetMinute(),
-                                fDate.GetSecond()
+                                fShownDate.GetYear(),
+                                fShownDate.GetMonth(),
+                                fShownDate.GetDay(),
+                                fShownDate.GetHour(),
+                                fShownDate.GetMinute(),
+                                fShownDate.GetSecond()
                                 )).data());
       }
 
       if (fCanvas->cd(++padnumber)) {
-        hBhTdcInSpill[0]->Draw();
-        hBhTdcInSpill[0]->SetMinimum(0.2);
-        hBhTdcInSpill[0]->GetXaxis()->SetLabelSize(0.07);
-        hBhTdcInSpill[0]->GetYaxis()->SetLabelSize(0.07);
-        hBhTdcInSpill[0]->GetXaxis()->SetTitleSize(0.07);
-        hBhTdcInSpill[0]->GetYaxis()->SetTitleSize(0.07);
-        hBhTdcInSpill[0]->GetXaxis()->SetTitleOffset(0.6);
-        hBhTdcInSpill[0]->GetYaxis()->SetTitleOffset(0.5);
+        TH1* hist = Shown(hBhTdcInSpill[0]);
+        hist->Draw();
+        hist->SetMinimum(0.2);
+        hist->GetXaxis()->SetLabelSize(0.07);
+        hist->GetYaxis()->SetLabelSize(0.07);
+        hist->GetXaxis()->SetTitleSize(0.07);
+        hist->GetYaxis()->SetTitleSize(0.07);
+        hist->GetXaxis()->SetTitleOffset(0.6);
+        hist->GetYaxis()->SetTitleOffset(0.5);
       }
 
       if (fCanvas->cd(++padnumber)) {
-        hBhTdcInSpill[1]->Draw();
-        hBhTdcInSpill[1]->SetMinimum(0.2);
-        hBhTdcInSpill[1]->GetXaxis()->SetLabelSize(0.07);
-        hBhTdcInSpill[1]->GetYaxis()->SetLabelSize(0.07);
-        hBhTdcInSpill[1]->GetXaxis()->SetTitleSize(0.07);
-        hBhTdcInSpill[1]->GetYaxis()->SetTitleSize(0.07);
-        hBhTdcInSpill[1]->GetXaxis()->SetTitleOffset(0.6);
-        hBhTdcInSpill[1]->GetYaxis()->SetTitleOffset(0.5);
+        TH1* hist = Shown(hBhTdcInSpill[1]);
+        hist->Draw();
+        hist->SetMinimum(0.2);
+        hist->GetXaxis()->SetLabelSize(0.07);
+        hist->GetYaxis()->SetLabelSize(0.07);
+        hist->GetXaxis()->SetTitleSize(0.07);
+        hist->GetYaxis()->SetTitleSize(0.07);
+        hist->GetXaxis()->SetTitleOffset(0.6);
+        hist->GetYaxis()->SetTitleOffset(0.5);
       }
 
       if (fCanvas->cd(++padnumber)) {
-        hHodTdcInSpill_Any->Draw();
-        hHodTdcInSpill_Any->SetMinimum(0.2);
-        hHodTdcInSpill_Any->GetXaxis()->SetLabelSize(0.07);
-        hHodTdcInSpill_Any->GetYaxis()->SetLabelSize(0.07);
-        hHodTdcInSpill_Any->GetXaxis()->SetTitleSize(0.07);
-        hHodTdcInSpill_Any->GetYaxis()->SetTitleSize(0.07);
-        hHodTdcInSpill_Any->GetXaxis()->SetTitleOffset(0.6);
-        hHodTdcInSpill_Any->GetYaxis()->SetTitleOffset(0.5);
+        TH1* hist = Shown(hHodTdcInSpill_Any);
+        hist->Draw();
+        hist->SetMinimum(0.2);
+        hist->GetXaxis()->SetLabelSize(0.07);
+        hist->GetYaxis()->SetLabelSize(0.07);
+        hist->GetXaxis()->SetTitleSize(0.07);
+        hist->GetYaxis()->SetTitleSize(0.07);
+        hist->GetXaxis()->SetTitleOffset(0.6);
+        hist->GetYaxis()->SetTitleOffset(0.5);
       }
 
       if (fCanvas->cd(++padnumber)) {
-        hExtTdcInSpill_Any->Draw();
-        hExtTdcInSpill_Any->SetMinimum(0.2);
-        hExtTdcInSpill_Any->GetXaxis()->SetLabelSize(0.07);
-        hExtTdcInSpill_Any->GetYaxis()->SetLabelSize(0.07);
-        hExtTdcInSpill_Any->GetXaxis()->SetTitleSize(0.07);
-        hExtTdcInSpill_Any->GetYaxis()->SetTitleSize(0.07);
-        hExtTdcInSpill_Any->GetXaxis()->SetTitleOffset(0.6);
-        hExtTdcInSpill_Any->GetYaxis()->SetTitleOffset(0.5);
+        TH1* hist = Shown(hExtTdcInSpill_Any);
+        hist->Draw();
+        hist->SetMinimum(0.2);
+        hist->GetXaxis()->SetLabelSize(0.07);
+        hist->GetYaxis()->SetLabelSize(0.07);
+        hist->GetXaxis()->SetTitleSize(0.07);
+        hist->GetYaxis()->SetTitleSize(0.07);
+        hist->GetXaxis()->SetTitleOffset(0.6);
+        hist->GetYaxis()->SetTitleOffset(0.5);
       }
 
       if (fCanvas->cd(++padnumber)) {
-        hTcTdcInSpill[0]->Draw();
-        hTcTdcInSpill[0]->SetMinimum(0.2);
-        hTcTdcInSpill[0]->GetXaxis()->SetLabelSize(0.07);
-        hTcTdcInSpill[0]->GetYaxis()->SetLabelSize(0.07);
-        hTcTdcInSpill[0]->GetXaxis()->SetTitleSize(0.07);
-        hTcTdcInSpill[0]->GetYaxis()->SetTitleSize(0.07);
-        hTcTdcInSpill[0]->GetXaxis()->SetTitleOffset(0.6);
-        hTcTdcInSpill[0]->GetYaxis()->SetTitleOffset(0.5);
+        TH1* hist = Shown(hTcTdcInSpill[0]);
+        hist->Draw();
+        hist->SetMinimum(0.2);
+        hist->GetXaxis()->SetLabelSize(0.07);
+        hist->GetYaxis()->SetLabelSize(0.07);
+        hist->GetXaxis()->SetTitleSize(0.07);
+        hist->GetYaxis()->SetTitleSize(0.07);
+        hist->GetXaxis()->SetTitleOffset(0.6);
+        hist->GetYaxis()->SetTitleOffset(0.5);
       }
 
       if (fCanvas->cd(++padnumber)) {
-        hTcTdcInSpill[1]->Draw();
-        hTcTdcInSpill[1]->SetMinimum(0.2);
-        hTcTdcInSpill[1]->GetXaxis()->SetLabelSize(0.07);
-        hTcTdcInSpill[1]->GetYaxis()->SetLabelSize(0.07);
-        hTcTdcInSpill[1]->GetXaxis()->SetTitleSize(0.07);
-        hTcTdcInSpill[1]->GetYaxis()->SetTitleSize(0.07);
-        hTcTdcInSpill[1]->GetXaxis()->SetTitleOffset(0.6);
-        hTcTdcInSpill[1]->GetYaxis()->SetTitleOffset(0.5);
+        TH1* hist = Shown(hTcTdcInSpill[1]);
+        hist->Draw();
+        hist->SetMinimum(0.2);
+        hist->GetXaxis()->SetLabelSize(0.07);
+        hist->GetYaxis()->SetLabelSize(0.07);
+        hist->GetXaxis()->SetTitleSize(0.07);
+        hist->GetYaxis()->SetTitleSize(0.07);
+        hist->GetXaxis()->SetTitleOffset(0.6);
+        hist->GetYaxis()->SetTitleOffset(0.5);
       }
 
       if (fCanvas->cd(++padnumber)) {
-        hHodHitMap->Draw("col");
+        TH2* hist = Shown(hHodHitMap);
+        hist->Draw("col");
         lHodBorderLine->Draw();
-        hHodHitMap->GetXaxis()->SetLabelSize(0.06);
-        hHodHitMap->GetYaxis()->SetLabelSize(0.06);
-        hHodHitMap->GetXaxis()->SetTitleSize(0.06);
-        hHodHitMap->GetYaxis()->SetTitleSize(0.06);
-        hHodHitMap->GetXaxis()->SetTitleOffset(0.6);
-        hHodHitMap->GetYaxis()->SetTitleOffset(0.5);
+        hist->GetXaxis()->SetLabelSize(0.06);
+        hist->GetYaxis()->SetLabelSize(0.06);
+        hist->GetXaxis()->SetTitleSize(0.06);
+        hist->GetYaxis()->SetTitleSize(0.06);
+        hist->GetXaxis()->SetTitleOffset(0.6);
+        hist->GetYaxis()->SetTitleOffset(0.5);
       }
 
       if (fCanvas->cd(++padnumber)) {
-        hHodEntryByCh->Draw();
-        hHodEntryByCh->GetXaxis()->SetLabelSize(0.06);
-        hHodEntryByCh->GetYaxis()->SetLabelSize(0.06);
-        hHodEntryByCh->GetXaxis()->SetTitleSize(0.06);
-        hHodEntryByCh->GetYaxis()->SetTitleSize(0.06);
-        hHodEntryByCh->GetXaxis()->SetTitleOffset(0.6);
-        hHodEntryByCh->GetYaxis()->SetTitleOffset(0.5);
+        TH1* hist = Shown(hHodEntryByCh);
+        hist->Draw();
+        hist->GetXaxis()->SetLabelSize(0.06);
+        hist->GetYaxis()->SetLabelSize(0.06);
+        hist->GetXaxis()->SetTitleSize(0.06);
+        hist->GetYaxis()->SetTitleSize(0.06);
+        hist->GetXaxis()->SetTitleOffset(0.6);
+        hist->GetYaxis()->SetTitleOffset(0.5);
       }
 
       if (fCanvas->cd(++padnumber)) {
-        hExtHitMap->Draw("col");
+        TH2* hist = Shown(hExtHitMap);
+        hist->Draw("col");
         lExtBorderLine->Draw();
-        hExtHitMap->GetXaxis()->SetLabelSize(0.06);
-        hExtHitMap->GetYaxis()->SetLabelSize(0.06);
-        hExtHitMap->GetXaxis()->SetTitleSize(0.06);
-        hExtHitMap->GetYaxis()->SetTitleSize(0.06);
-        hExtHitMap->GetXaxis()->SetTitleOffset(0.6);
-        hExtHitMap->GetYaxis()->SetTitleOffset(0.5);
+        hist->GetXaxis()->SetLabelSize(0.06);
+        hist->GetYaxis()->SetLabelSize(0.06);
+        hist->GetXaxis()->SetTitleSize(0.06);
+        hist->GetYaxis()->SetTitleSize(0.06);
+        hist->GetXaxis()->SetTitleOffset(0.6);
+        hist->GetYaxis()->SetTitleOffset(0.5);
       }
 
       if (fCanvas->cd(++padnumber)) {
         TH1* hist = nullptr;
         switch (fChannelAlign) {
         case ChannelAlign::Raw:
-          hist = hExtEntryByCh;
-          hExtEntryByCh->Draw();
+          hist = Shown(hExtEntryByCh);
+          hist->Draw();
           break;
         case ChannelAlign::Projection:
-          hist = hExtEntryByChBottom;
-          hExtEntryByChBottom ->Draw();
-          hExtEntryByChCenter1->Draw("same");
-          hExtEntryByChCenter2->Draw("same");
-          hExtEntryByChTop    ->Draw("same");
-          hExtEntryByChBottom->SetMaximum(2.0 * hExtHitMap->GetBinContent(hExtHitMap->GetMaximumBin()));
+          hist = Shown(hExtEntryByChBottom);
+          hist                        ->Draw();
+          Shown(hExtEntryByChCenter1)->Draw("same");
+          Shown(hExtEntryByChCenter2)->Draw("same");
+          Shown(hExtEntryByChTop    )->Draw("same");
+          hist->SetMaximum(2.0 * Shown(hExtHitMap)->GetBinContent(Shown(hExtHitMap)->GetMaximumBin()));
           break;
         }
         if (hist) {
@@ -818,89 +1020,97 @@ namespace Extinction {
 
       if (fMonitorMode == MonitorMode::Coincidence) {
         if (fCanvas->cd(++padnumber)) {
-          hExtMountain_Any->Draw("col");
-          hExtMountain_Any->GetXaxis()->SetLabelSize(0.05);
-          hExtMountain_Any->GetYaxis()->SetLabelSize(0.05);
-          hExtMountain_Any->GetXaxis()->SetTitleSize(0.05);
-          hExtMountain_Any->GetYaxis()->SetTitleSize(0.05);
-          hExtMountain_Any->GetXaxis()->SetTitleOffset(0.6);
-          hExtMountain_Any->GetYaxis()->SetTitleOffset(0.5);
+          TH2* hist = Shown(hExtMountain_Any);
+          hist->Draw("col");
+          hist->GetXaxis()->SetLabelSize(0.05);
+          hist->GetYaxis()->SetLabelSize(0.05);
+          hist->GetXaxis()->SetTitleSize(0.05);
+          hist->GetYaxis()->SetTitleSize(0.05);
+          hist->GetXaxis()->SetTitleOffset(0.6);
+          hist->GetYaxis()->SetTitleOffset(0.5);
         }
 
         if (fCanvas->cd(++padnumber)) {
-          hExtTdcInSync_Any->Draw();
-          hExtTdcInSync_Any->SetMinimum(0.2);
-          hExtTdcInSync_Any->GetXaxis()->SetLabelSize(0.05);
-          hExtTdcInSync_Any->GetYaxis()->SetLabelSize(0.05);
-          hExtTdcInSync_Any->GetXaxis()->SetTitleSize(0.05);
-          hExtTdcInSync_Any->GetYaxis()->SetTitleSize(0.05);
-          hExtTdcInSync_Any->GetXaxis()->SetTitleOffset(0.6);
-          hExtTdcInSync_Any->GetYaxis()->SetTitleOffset(0.5);
+          TH1* hist = Shown(hExtTdcInSync_Any);
+          hist->Draw();
+          hist->SetMinimum(0.2);
+          hist->GetXaxis()->SetLabelSize(0.05);
+          hist->GetYaxis()->SetLabelSize(0.05);
+          hist->GetXaxis()->SetTitleSize(0.05);
+          hist->GetYaxis()->SetTitleSize(0.05);
+          hist->GetXaxis()->SetTitleOffset(0.6);
+          hist->GetYaxis()->SetTitleOffset(0.5);
         }
 
         if (fCanvas->cd(++padnumber)) {
-          gHitInSpill->Draw("AP");
-          gHitInSpill->GetXaxis()->SetLabelSize(0.05);
-          gHitInSpill->GetYaxis()->SetLabelSize(0.05);
-          gHitInSpill->GetXaxis()->SetTitleSize(0.05);
-          gHitInSpill->GetYaxis()->SetTitleSize(0.05);
-          gHitInSpill->GetXaxis()->SetTitleOffset(0.6);
-          gHitInSpill->GetYaxis()->SetTitleOffset(0.5);
+          TGraphErrors* graph = Shown(gHitInSpill);
+          graph->Draw("AP");
+          graph->GetXaxis()->SetLabelSize(0.05);
+          graph->GetYaxis()->SetLabelSize(0.05);
+          graph->GetXaxis()->SetTitleSize(0.05);
+          graph->GetYaxis()->SetTitleSize(0.05);
+          graph->GetXaxis()->SetTitleOffset(0.6);
+          graph->GetYaxis()->SetTitleOffset(0.5);
         }
 
       } else if (fMonitorMode == MonitorMode::Offset) {
         if (fCanvas->cd(++padnumber)) {
-          hMrSyncInterval[fMonitorBoard]->Draw("col");
-          hMrSyncInterval[fMonitorBoard]->GetXaxis()->SetLabelSize(0.05);
-          hMrSyncInterval[fMonitorBoard]->GetYaxis()->SetLabelSize(0.05);
-          hMrSyncInterval[fMonitorBoard]->GetXaxis()->SetTitleSize(0.05);
-          hMrSyncInterval[fMonitorBoard]->GetYaxis()->SetTitleSize(0.05);
-          hMrSyncInterval[fMonitorBoard]->GetXaxis()->SetTitleOffset(0.6);
-          hMrSyncInterval[fMonitorBoard]->GetYaxis()->SetTitleOffset(0.5);
+          TH1* hist = Shown(hMrSyncInterval[fMonitorBoard]);
+          hist->Draw("col");
+          hist->GetXaxis()->SetLabelSize(0.05);
+          hist->GetYaxis()->SetLabelSize(0.05);
+          hist->GetXaxis()->SetTitleSize(0.05);
+          hist->GetYaxis()->SetTitleSize(0.05);
+          hist->GetXaxis()->SetTitleOffset(0.6);
+          hist->GetYaxis()->SetTitleOffset(0.5);
         }
 
         if (fCanvas->cd(++padnumber)) {
-          hExtTdcOffset[fMonitorChannel]->Draw("col");
-          hExtTdcOffset[fMonitorChannel]->GetXaxis()->SetLabelSize(0.03);
-          hExtTdcOffset[fMonitorChannel]->GetYaxis()->SetLabelSize(0.03);
-          hExtTdcOffset[fMonitorChannel]->GetXaxis()->SetTitleSize(0.03);
-          hExtTdcOffset[fMonitorChannel]->GetYaxis()->SetTitleSize(0.03);
-          hExtTdcOffset[fMonitorChannel]->GetXaxis()->SetTitleOffset(1.0);
-          hExtTdcOffset[fMonitorChannel]->GetYaxis()->SetTitleOffset(0.9);
+          TH2* hist = Shown(hExtTdcOffset[fMonitorChannel]);
+          hist->Draw("col");
+          hist->GetXaxis()->SetLabelSize(0.03);
+          hist->GetYaxis()->SetLabelSize(0.03);
+          hist->GetXaxis()->SetTitleSize(0.03);
+          hist->GetYaxis()->SetTitleSize(0.03);
+          hist->GetXaxis()->SetTitleOffset(1.0);
+          hist->GetYaxis()->SetTitleOffset(0.9);
         }
 
       } else if (fMonitorMode == MonitorMode::Channel ||
                  fMonitorMode == MonitorMode::Ext ||
                  fMonitorMode == MonitorMode::Hod) {
         if (fCanvas->cd(++padnumber)) {
-          hMountain->Draw("col");
-          hMountain->GetXaxis()->SetLabelSize(0.05);
-          hMountain->GetYaxis()->SetLabelSize(0.05);
-          hMountain->GetXaxis()->SetTitleSize(0.05);
-          hMountain->GetYaxis()->SetTitleSize(0.05);
-          hMountain->GetXaxis()->SetTitleOffset(0.6);
-          hMountain->GetYaxis()->SetTitleOffset(0.5);
+          TH2* hist = Shown(hMountain);
+          hist->Draw("col");
+          hist->GetXaxis()->SetLabelSize(0.05);
+          hist->GetYaxis()->SetLabelSize(0.05);
+          hist->GetXaxis()->SetTitleSize(0.05);
+          hist->GetYaxis()->SetTitleSize(0.05);
+          hist->GetXaxis()->SetTitleOffset(0.6);
+          hist->GetYaxis()->SetTitleOffset(0.5);
         }
 
         if (fCanvas->cd(++padnumber)) {
-          hTdcInSync->Draw();
-          hTdcInSync->SetMinimum(0.2);
-          hTdcInSync->GetXaxis()->SetLabelSize(0.05);
-          hTdcInSync->GetYaxis()->SetLabelSize(0.05);
-          hTdcInSync->GetXaxis()->SetTitleSize(0.05);
-          hTdcInSync->GetYaxis()->SetTitleSize(0.05);
-          hTdcInSync->GetXaxis()->SetTitleOffset(0.6);
-          hTdcInSync->GetYaxis()->SetTitleOffset(0.5);
+          TH1* hist = Shown(hTdcInSync);
+          hist->Draw();
+          hist->SetMinimum(0.2);
+          hist->GetXaxis()->SetLabelSize(0.05);
+          hist->GetYaxis()->SetLabelSize(0.05);
+          hist->GetXaxis()->SetTitleSize(0.05);
+          hist->GetYaxis()->SetTitleSize(0.05);
+          hist->GetXaxis()->SetTitleOffset(0.6);
+          hist->GetYaxis()->SetTitleOffset(0.5);
         }
 
         if (fCanvas->cd(++padnumber)) {
-          hTdcInSpill->Draw();
-          hTdcInSpill->GetXaxis()->SetLabelSize(0.05);
-          hTdcInSpill->GetYaxis()->SetLabelSize(0.05);
-          hTdcInSpill->GetXaxis()->SetTitleSize(0.05);
-          hTdcInSpill->GetYaxis()->SetTitleSize(0.05);
-          hTdcInSpill->GetXaxis()->SetTitleOffset(0.6);
-          hTdcInSpill->GetYaxis()->SetTitleOffset(0.5);
+          TH1* hist = Shown(hTdcInSpill);
+          hist->Draw();
+          hist->GetXaxis()->SetLabelSize(0.05);
+          hist->GetYaxis()->SetLabelSize(0.05);
+          hist->GetXaxis()->SetTitleSize(0.05);
+          hist->GetYaxis()->SetTitleSize(0.05);
+          hist->GetXaxis()->SetTitleOffset(0.6);
+          hist->GetYaxis()->SetTitleOffset(0.5);
         }
       }
 
@@ -917,10 +1127,10 @@ namespace Extinction {
 
       fTdcBuffer.clear();
 
-      fLastExtData.clear();
-      fLastHodData.clear();
-      fLastTcData .clear();
-      fLastBhData .clear();
+      fLastExtData.Clear();
+      fLastHodData.Clear();
+      fLastTcData .Clear();
+      fLastBhData .Clear();
       fLastMrSyncData.clear();
       fLastMrSyncCount.clear();
       for (auto&& pair: fEventMatchData) {
@@ -965,9 +1175,6 @@ namespace Extinction {
       }
 
       const Double_t    time       = tdcData.Time;
-      const Long64_t    tdc        = tdcData.Tdc;
-      const Double_t    timePerTdc = tdcData.TimePerTdc;
-      const Int_t       board      = tdcData.Board;
       std::size_t tdcCh = 0;
       std::size_t tdcI  = 0;
       if        (BeamlineHodoscope::Contains  (tdcData.Channel)) {
@@ -990,25 +1197,17 @@ namespace Extinction {
       for (std::size_t bhCh = 0; bhCh < BeamlineHodoscope::NofChannels; ++bhCh) {
         const std::size_t i = bhCh + CoinOffset::BH;
         coincidence[i] = !fContains[tdcCh][i];
-      }
-      for (auto&& lastData : fLastBhData) {
-        const std::size_t bhCh = BeamlineHodoscope::GetChannel(lastData.Channel);
-        const std::size_t i = bhCh + CoinOffset::BH;
         if (!coincidence[i]) {
-          const Double_t countDiff          = fLastMrSyncCount[lastData.Board] - fLastMrSyncCount[board];
-          const Double_t lastTdcCorrection  = countDiff < 0 ? std::abs(countDiff) * fMrSyncInterval[lastData.Board] : 0;
-          const Double_t     tdcCorrection  = countDiff > 0 ? std::abs(countDiff) * fMrSyncInterval[         board] : 0;
-          const Double_t lastTimeFromMrSync = (lastData.Tdc - fLastMrSyncData[lastData.Board].Tdc - lastTdcCorrection) * lastData.TimePerTdc;
-          const Double_t     timeFromMrSync = (         tdc - fLastMrSyncData[         board].Tdc -     tdcCorrection) *          timePerTdc;
-          const Double_t dt   = lastTimeFromMrSync - timeFromMrSync;
           // const Double_t mean = fStdCoinDiffs[tdcCh][i];
           const Double_t mean = fStdCoinDiffs[40][i] - fStdCoinDiffs[40][tdcI];
-          if (std::abs(dt - mean) < fCoinTimeWidth) {
-            coincidence[i] = true;
-            if (std::all_of(coincidence + CoinOffset::BH, coincidence + CoinOffset::BH + BeamlineHodoscope::NofChannels, [](Bool_t b) { return b; })) {
-              break;
-            }
-          }
+          ForEachInWindow(fLastBhData, tdcData, mean - fCoinTimeWidth, mean + fCoinTimeWidth,
+                          [&](const TdcData& lastData) -> Bool_t {
+                            if ((std::size_t)BeamlineHodoscope::GetChannel(lastData.Channel) != bhCh) {
+                              return false;
+                            }
+                            const Double_t dt = GetTimeDifference(lastData, tdcData);
+                            return coincidence[i] = std::abs(dt - mean) < fCoinTimeWidth;
+                          });
         }
       }
 
@@ -1016,65 +1215,47 @@ namespace Extinction {
         const std::size_t hodCh = 0;
         const std::size_t i = hodCh + CoinOffset::Hod;
         coincidence[i] = !fContains[tdcCh][i];
-      }
-      for (auto&& lastData : fLastHodData) {
-        const std::size_t hodCh = 0;
-        const std::size_t i = hodCh + CoinOffset::Hod;
         if (!coincidence[i]) {
-          const Double_t countDiff          = fLastMrSyncCount[lastData.Board] - fLastMrSyncCount[board];
-          const Double_t lastTdcCorrection  = countDiff < 0 ? std::abs(countDiff) * fMrSyncInterval[lastData.Board] : 0;
-          const Double_t     tdcCorrection  = countDiff > 0 ? std::abs(countDiff) * fMrSyncInterval[         board] : 0;
-          const Double_t lastTimeFromMrSync = (lastData.Tdc - fLastMrSyncData[lastData.Board].Tdc - lastTdcCorrection) * lastData.TimePerTdc;
-          const Double_t     timeFromMrSync = (         tdc - fLastMrSyncData[         board].Tdc -     tdcCorrection) *          timePerTdc;
-          const Double_t dt   = lastTimeFromMrSync - timeFromMrSync;
           // const Double_t mean = fStdCoinDiffs[tdcCh][i];
           const Double_t mean = fStdCoinDiffs[40][i] - fStdCoinDiffs[40][tdcI];
-          if (std::abs(dt - mean) < fCoinTimeWidth) {
-            coincidence[i] = true;
-            break;
-          }
+          ForEachInWindow(fLastHodData, tdcData, mean - fCoinTimeWidth, mean + fCoinTimeWidth,
+                          [&](const TdcData& lastData) -> Bool_t {
+                            const Double_t dt = GetTimeDifference(lastData, tdcData);
+                            return coincidence[i] = std::abs(dt - mean) < fCoinTimeWidth;
+                          });
         }
       }
 
       for (std::size_t tcCh = 0; tcCh < TimingCounter::NofChannels; ++tcCh) {
         const std::size_t i = tcCh + CoinOffset::TC;
         coincidence[i] = !fContains[tdcCh][i];
-      }
-      for (auto&& lastData : fLastTcData) {
-        const std::size_t tcCh = TimingCounter::GetChannel(lastData.Channel);
-        const std::size_t i = tcCh + CoinOffset::TC;
         if (!coincidence[i]) {
-          const Double_t countDiff          = fLastMrSyncCount[lastData.Board] - fLastMrSyncCount[board];
-          const Double_t lastTdcCorrection  = countDiff < 0 ? std::abs(countDiff) * fMrSyncInterval[lastData.Board] : 0;
-          const Double_t     tdcCorrection  = countDiff > 0 ? std::abs(countDiff) * fMrSyncInterval[         board] : 0;
-          const Double_t lastTimeFromMrSync = (lastData.Tdc - fLastMrSyncData[lastData.Board].Tdc - lastTdcCorrection) * lastData.TimePerTdc;
-          const Double_t     timeFromMrSync = (         tdc - fLastMrSyncData[         board].Tdc -     tdcCorrection) *          timePerTdc;
-          const Double_t dt   = lastTimeFromMrSync - timeFromMrSync;
           // const Double_t mean = fStdCoinDiffs[tdcCh][i];
           const Double_t mean = fStdCoinDiffs[40][i] - fStdCoinDiffs[40][tdcI];
-          if (std::abs(dt - mean) < fCoinTimeWidth) {
-            coincidence[i] = true;
-            if (std::all_of(coincidence + CoinOffset::TC, coincidence + CoinOffset::TC + TimingCounter::NofChannels, [](Bool_t b) { return b; })) {
-              break;
-            }
-          }
+          ForEachInWindow(fLastTcData, tdcData, mean - fCoinTimeWidth, mean + fCoinTimeWidth,
+                          [&](const TdcData& lastData) -> Bool_t {
+                            if ((std::size_t)TimingCounter::GetChannel(lastData.Channel) != tcCh) {
+                              return false;
+                            }
+                            const Double_t dt = GetTimeDifference(lastData, tdcData);
+                            return coincidence[i] = std::abs(dt - mean) < fCoinTimeWidth;
+                          });
         }
       }
 
       if (std::all_of(coincidence, coincidence + CoinOffset::N, [](Bool_t b) { return b; })) {
-        for (auto&& extData : fLastExtData) {
-          const std::size_t extCh = ExtinctionDetector::GetChannel(extData.Channel);
-          const Double_t countDiff         = fLastMrSyncCount[extData.Board] - fLastMrSyncCount[board];
-          const Double_t extTdcCorrection  = countDiff < 0 ? std::abs(countDiff) * fMrSyncInterval[extData.Board] : 0;
-          const Double_t    tdcCorrection  = countDiff > 0 ? std::abs(countDiff) * fMrSyncInterval[        board] : 0;
-          const Double_t extTimeFromMrSync = (extData.Tdc - fLastMrSyncData[extData.Board].Tdc - extTdcCorrection) * extData.TimePerTdc;
-          const Double_t    timeFromMrSync = (        tdc - fLastMrSyncData[        board].Tdc -    tdcCorrection) *         timePerTdc;
-          const Double_t dt   = timeFromMrSync - extTimeFromMrSync;
-          const Double_t mean = fStdCoinDiffs[extCh][tdcI];
-          if (std::abs(dt - mean) < fCoinTimeWidth) {
-            hits.push_back(extData);
-          }
-        }
+        // Time difference is opposite in sign to the offset
+        const auto& range = fExtCoinDiffRanges[tdcI];
+        ForEachInWindow(fLastExtData, tdcData, -range.second - fCoinTimeWidth, -range.first + fCoinTimeWidth,
+                        [&](const TdcData& extData) -> Bool_t {
+                          const std::size_t extCh = ExtinctionDetector::GetChannel(extData.Channel);
+                          const Double_t dt   = -GetTimeDifference(extData, tdcData);
+                          const Double_t mean = fStdCoinDiffs[extCh][tdcI];
+                          if (std::abs(dt - mean) < fCoinTimeWidth) {
+                            hits.push_back(extData);
+                          }
+                          return false;
+                        });
 
         ++fPreCoinCount;
         if (hits.size()) {
@@ -1104,21 +1285,36 @@ namespace Extinction {
       }
     }
 
-    std::size_t MonitorWindow::RemoveOldTdc(std::vector<TdcData>* lastData, const TdcData& tdc) {
-      for (std::size_t i = 0, n = lastData->size(); i < n; ++i) {
-        TdcData& lastTdc = lastData->at(0);
-        const Double_t countDiff          = fLastMrSyncCount[lastTdc.Board] - fLastMrSyncCount[tdc.Board];
-        const Double_t lastTdcCorrection  = countDiff > 0 ? 0 : std::abs(countDiff) * fMrSyncInterval[lastTdc.Board];
-        const Double_t     tdcCorrection  = countDiff < 0 ? 0 : std::abs(countDiff) * fMrSyncInterval[    tdc.Board];
-        const Double_t lastTimeFromMrSync = (lastTdc.Tdc - fLastMrSyncData[lastTdc.Board].Tdc - lastTdcCorrection) * lastTdc.TimePerTdc;
-        const Double_t     timeFromMrSync = (    tdc.Tdc - fLastMrSyncData[    tdc.Board].Tdc -     tdcCorrection) *     tdc.TimePerTdc;
-        if (std::abs(lastTimeFromMrSync - timeFromMrSync) > fHistoryWidth) {
-          lastData->erase(lastData->begin());
-        } else {
-          break;
+    std::size_t MonitorWindow::RemoveOldTdc(TdcBoardHistory_t* lastData, const TdcData& tdc) {
+      return lastData->PopWhile([&](const TdcData& lastTdc) {
+          return std::abs(GetTimeDifference(lastTdc, tdc)) > fHistoryWidth;
+        });
+    }
+
+    Double_t MonitorWindow::GetTimeDifference(const TdcData& lastTdc, const TdcData& tdc) {
+      const Double_t countDiff          = fLastMrSyncCount[lastTdc.Board] - fLastMrSyncCount[tdc.Board];
+      const Double_t lastTdcCorrection  = countDiff < 0 ? std::abs(countDiff) * fMrSyncInterval[lastTdc.Board] : 0;
+      const Double_t     tdcCorrection  = countDiff > 0 ? std::abs(countDiff) * fMrSyncInterval[    tdc.Board] : 0;
+      const Double_t lastTimeFromMrSync = (lastTdc.Tdc - fLastMrSyncData[lastTdc.Board].Tdc - lastTdcCorrection) * lastTdc.TimePerTdc;
+      const Double_t     timeFromMrSync = (    tdc.Tdc - fLastMrSyncData[    tdc.Board].Tdc -     tdcCorrection) *     tdc.TimePerTdc;
+      return lastTimeFromMrSync - timeFromMrSync;
+    }
+
+    // Calls function for history data whose time difference from tdc is in [lower, upper] until it returns true.
+    // The time difference increases with tdc in each board, so a binary search finds the first candidate.
+    template <typename Function>
+    void MonitorWindow::ForEachInWindow(const TdcBoardHistory_t& lastData, const TdcData& tdc,
+                                        Double_t lower, Double_t upper, Function function) {
+      auto timeDifference = [&](const TdcData& lastTdc) { return GetTimeDifference(lastTdc, tdc); };
+      for (auto&& pair : lastData) {
+        const TdcHistory_t& history = pair.second;
+        for (std::size_t i = history.LowerBound(lower, timeDifference);
+             i < history.size() && timeDifference(history[i]) <= upper; ++i) {
+          if (function(history[i])) {
+            return;
+          }
         }
       }
-      return lastData->size();
     }
 
     Int_t MonitorWindow::UpdatePlots(const std::map<int, std::string>& ifilenames,
@@ -1141,7 +1337,7 @@ namespace Extinction {
       ClearLastSpill();
 
       std::cout << "Open file" << std::endl;
-      std::map<Int_t, std::ifstream> ifiles;
+      std::map<Int_t, RawFileStream>  ifiles;
       std::vector<TDatime>           datimes;
       for (auto&& pair : ifilenames) {
         const Int_t       board     = pair.first;
@@ -1151,7 +1347,18 @@ namespace Extinction {
           datimes.push_back(parser(ifilename));
         }
 
-        ifiles[board].open(ifilename, std::ios::binary);
+        if (fIsFileFinished) {
+          ifiles[board].open(ifilename,
+                             [this, ifilename]() { return fIsTerminated || fIsFileFinished(ifilename); },
+                             [this]() {
+                               // Retry publishing while waiting for the daq
+                               if (fPublishPending) {
+                                 PublishPlots();
+                               }
+                             });
+        } else {
+          ifiles[board].open(ifilename);
+        }
         if (!ifiles[board]) {
           std::cerr << "[error] input file is not opened, " << ifilename << std::endl;
           return 1;
@@ -1187,8 +1394,8 @@ namespace Extinction {
             if (count % 1000000UL == 0) {
               std::cout << ">> " << count << std::endl;
             }
-            if (count % 3000000UL == 0) {
-              DrawPlots();
+            if (count % 3000000UL == 0 || fPublishPending) {
+              PublishPlots();
             }
 
             if (!decoder.Read(ifiles[targetBoard], &packet)) {
@@ -1214,9 +1421,10 @@ namespace Extinction {
 
               } else {
                 // std::cout << "[info] detect data @ " << targetBoard << std::endl;
-                auto tdcData = decoder.Data.GetTdcData(targetBoard);
+                fTdcData.clear();
+                decoder.Data.AppendTdcData(targetBoard, fTdcData);
 
-                for (auto&& data : tdcData) {
+                for (auto&& data : fTdcData) {
                   if (MrSync::Contains(data.Channel)) {
                     mrcount[data.Board]++;
                     mrtdc  [data.Board] = data.Tdc;
@@ -1224,7 +1432,7 @@ namespace Extinction {
                 }
 
                 ULong64_t tdcTag = 0;
-                for (auto&& data : tdcData) {
+                for (auto&& data : fTdcData) {
                   tdcTag             = data.GetTdcTag(mrcount[data.Board], mrtdc[data.Board]);
                   fTdcBuffer[tdcTag] = data;
                 }
@@ -1281,26 +1489,32 @@ namespace Extinction {
 
               if (fMonitorMode == MonitorMode::Offset) {
                 const Long64_t tdc = data.Tdc;
-                for (auto&& lastData : fLastHodData) {
-                  auto lastCh = Hodoscope::GetChannel(lastData.Channel);
-                  const Double_t dtdc0  = lastData.Tdc - tdc;
-                  const Double_t dsync  = fLastMrSyncData[lastData.Board].Tdc - fLastMrSyncData[board].Tdc;
-                  const Double_t dtdc   = dtdc0 - dsync;
-                  hExtTdcOffset[ch]->Fill(lastCh + CoinOffsetX::Hod, dtdc);
+                for (auto&& pair : fLastHodData) {
+                  for (auto&& lastData : pair.second) {
+                    auto lastCh = Hodoscope::GetChannel(lastData.Channel);
+                    const Double_t dtdc0  = lastData.Tdc - tdc;
+                    const Double_t dsync  = fLastMrSyncData[lastData.Board].Tdc - fLastMrSyncData[board].Tdc;
+                    const Double_t dtdc   = dtdc0 - dsync;
+                    hExtTdcOffset[ch]->Fill(lastCh + CoinOffsetX::Hod, dtdc);
+                  }
                 }
-                for (auto&& lastData : fLastTcData) {
-                  auto lastCh = TimingCounter::GetChannel(lastData.Channel);
-                  const Double_t dtdc0 = lastData.Tdc - tdc;
-                  const Double_t dsync = fLastMrSyncData[lastData.Board].Tdc - fLastMrSyncData[board].Tdc;
-                  const Double_t dtdc  = dtdc0 - dsync;
-                  hExtTdcOffset[ch]->Fill(lastCh + CoinOffsetX::TC, dtdc);
+                for (auto&& pair : fLastTcData) {
+                  for (auto&& lastData : pair.second) {
+                    auto lastCh = TimingCounter::GetChannel(lastData.Channel);
+                    const Double_t dtdc0 = lastData.Tdc - tdc;
+                    const Double_t dsync = fLastMrSyncData[lastData.Board].Tdc - fLastMrSyncData[board].Tdc;
+                    const Double_t dtdc  = dtdc0 - dsync;
+                    hExtTdcOffset[ch]->Fill(lastCh + CoinOffsetX::TC, dtdc);
+                  }
                 }
-                for (auto&& lastData : fLastBhData) {
-                  auto lastCh = BeamlineHodoscope::GetChannel(lastData.Channel);
-                  const Double_t dtdc0 = lastData.Tdc - tdc;
-                  const Double_t dsync = fLastMrSyncData[lastData.Board].Tdc - fLastMrSyncData[board].Tdc;
-                  const Double_t dtdc  = dtdc0 - dsync;
-                  hExtTdcOffset[ch]->Fill(lastCh + CoinOffsetX::BH, dtdc);
+                for (auto&& pair : fLastBhData) {
+                  for (auto&& lastData : pair.second) {
+                    auto lastCh = BeamlineHodoscope::GetChannel(lastData.Channel);
+                    const Double_t dtdc0 = lastData.Tdc - tdc;
+                    const Double_t dsync = fLastMrSyncData[lastData.Board].Tdc - fLastMrSyncData[board].Tdc;
+                    const Double_t dtdc  = dtdc0 - dsync;
+                    hExtTdcOffset[ch]->Fill(lastCh + CoinOffsetX::BH, dtdc);
+                  }
                 }
               } else if (fMonitorMode == MonitorMode::Coincidence) {
 
@@ -1317,11 +1531,8 @@ namespace Extinction {
 
               }
 
-              if (RemoveOldTdc(&fLastExtData, data) > kHistLimit) {
-                std::cerr << "[error] size of fLastExtData reaches " << kHistLimit << std::endl;
-                return 1;
-              }
-              fLastExtData.push_back(data);
+              RemoveOldTdc(&fLastExtData, data);
+              fLastExtData.Push(data);
 
             } else if (Hodoscope::Contains(globalChannel)) {
               const Int_t ch = Hodoscope::GetChannel(globalChannel);
@@ -1332,23 +1543,22 @@ namespace Extinction {
 
               if (fMonitorMode == MonitorMode::Offset) {
                 const Long64_t tdc = data.Tdc;
-                for (auto&& lastData : fLastExtData) {
-                  auto lastCh = ExtinctionDetector::GetChannel(lastData.Channel);
-                  const Double_t ddc0  = tdc - lastData.Tdc;
-                  const Double_t dsync = fLastMrSyncData[board].Tdc - fLastMrSyncData[lastData.Board].Tdc;
-                  const Double_t dtdc  = ddc0 - dsync;
-                  hExtTdcOffset[lastCh]->Fill(ch + CoinOffsetX::Hod, dtdc);
+                for (auto&& pair : fLastExtData) {
+                  for (auto&& lastData : pair.second) {
+                    auto lastCh = ExtinctionDetector::GetChannel(lastData.Channel);
+                    const Double_t ddc0  = tdc - lastData.Tdc;
+                    const Double_t dsync = fLastMrSyncData[board].Tdc - fLastMrSyncData[lastData.Board].Tdc;
+                    const Double_t dtdc  = ddc0 - dsync;
+                    hExtTdcOffset[lastCh]->Fill(ch + CoinOffsetX::Hod, dtdc);
+                  }
                 }
-                fLastHodData.push_back(data);
+                fLastHodData.Push(data);
               } else if (fMonitorMode == MonitorMode::Coincidence) {
-                fLastHodData.push_back(data);
+                fLastHodData.Push(data);
                 FillCoincidence(data);
               }
 
-              if (RemoveOldTdc(&fLastHodData, data) > kHistLimit) {
-                std::cerr << "[error] size of fLastHodData reaches " << kHistLimit << std::endl;
-                return 1;
-              }
+              RemoveOldTdc(&fLastHodData, data);
 
             } else if (TimingCounter::Contains(globalChannel)) {
               const Int_t ch = TimingCounter::GetChannel(globalChannel);
@@ -1357,23 +1567,22 @@ namespace Extinction {
 
               if (fMonitorMode == MonitorMode::Offset) {
                 const Long64_t tdc = data.Tdc;
-                for (auto&& lastData : fLastExtData) {
-                  auto lastCh = ExtinctionDetector::GetChannel(lastData.Channel);
-                  const Double_t dtdc0 = tdc - lastData.Tdc;
-                  const Double_t dsync = fLastMrSyncData[board].Tdc - fLastMrSyncData[lastData.Board].Tdc;
-                  const Double_t dtdc  = dtdc0 - dsync;
-                  hExtTdcOffset[lastCh]->Fill(ch + CoinOffsetX::TC, dtdc);
+                for (auto&& pair : fLastExtData) {
+                  for (auto&& lastData : pair.second) {
+                    auto lastCh = ExtinctionDetector::GetChannel(lastData.Channel);
+                    const Double_t dtdc0 = tdc - lastData.Tdc;
+                    const Double_t dsync = fLastMrSyncData[board].Tdc - fLastMrSyncData[lastData.Board].Tdc;
+                    const Double_t dtdc  = dtdc0 - dsync;
+                    hExtTdcOffset[lastCh]->Fill(ch + CoinOffsetX::TC, dtdc);
+                  }
                 }
-                fLastTcData.push_back(data);
+                fLastTcData.Push(data);
               } else if (fMonitorMode == MonitorMode::Coincidence) {
-                fLastTcData.push_back(data);
+                fLastTcData.Push(data);
                 FillCoincidence(data);
               }
 
-              if (RemoveOldTdc(&fLastTcData, data) > kHistLimit) {
-                std::cerr << "[error] size of fLastTcData reaches " << kHistLimit << std::endl;
-                return 1;
-              }
+              RemoveOldTdc(&fLastTcData, data);
 
             } else if (BeamlineHodoscope::Contains(globalChannel)) {
               const Int_t ch = BeamlineHodoscope::GetChannel(globalChannel);
@@ -1382,23 +1591,22 @@ namespace Extinction {
 
               if (fMonitorMode == MonitorMode::Offset) {
                 const Long64_t tdc = data.Tdc;
-                for (auto&& lastData : fLastExtData) {
-                  auto lastCh   = ExtinctionDetector::GetChannel(lastData.Channel);
-                  const Double_t dtdc0 = tdc - lastData.Tdc;
-                  const Double_t dsync = fLastMrSyncData[board].Tdc - fLastMrSyncData[lastData.Board].Tdc;
-                  const Double_t dtdc  = dtdc0 - dsync;
-                  hExtTdcOffset[lastCh]->Fill(ch + CoinOffsetX::BH, dtdc);
+                for (auto&& pair : fLastExtData) {
+                  for (auto&& lastData : pair.second) {
+                    auto lastCh   = ExtinctionDetector::GetChannel(lastData.Channel);
+                    const Double_t dtdc0 = tdc - lastData.Tdc;
+                    const Double_t dsync = fLastMrSyncData[board].Tdc - fLastMrSyncData[lastData.Board].Tdc;
+                    const Double_t dtdc  = dtdc0 - dsync;
+                    hExtTdcOffset[lastCh]->Fill(ch + CoinOffsetX::BH, dtdc);
+                  }
                 }
-                fLastBhData.push_back(data);
+                fLastBhData.Push(data);
               } else if (fMonitorMode == MonitorMode::Coincidence) {
-                fLastBhData.push_back(data);
+                fLastBhData.Push(data);
                 FillCoincidence(data);
               }
 
-              if (RemoveOldTdc(&fLastBhData, data) > kHistLimit) {
-                std::cerr << "[error] size of fLastBhData reaches " << kHistLimit << std::endl;
-                return 1;
-              }
+              RemoveOldTdc(&fLastBhData, data);
 
             } else if (MrSync::Contains(globalChannel)) {
               if (fMonitorMode == MonitorMode::Offset) {
@@ -1634,7 +1842,7 @@ namespace Extinction {
               // std::cout << "^^^^^^^^^^^^^^^^^^" << std::endl;
             }
 
-            DrawPlots();
+            PublishPlots();
 
             FillToSeconds(&gateEnded  , false);
             FillToSeconds(&lastTdcTags, 0ULL );
@@ -1653,6 +1861,8 @@ namespace Extinction {
         pair.second.close();
       }
 
+      PublishPlots(true);
+
       const clock_t stopClock = clock();
       std::cout << "time: " << (double)(stopClock - startClock) / CLOCKS_PER_SEC << " sec\n";
 
@@ -6,6 +6,7 @@
 #include "TFile.h"
 #include "TTree.h"
 #include "Fct.hh"
+#include "RawFileStream.hh"
 #include "Units.hh"
 #include "ArgReader.hh"
 
@@ -23,11 +24,11 @@ Int_t main(Int_t argc, Char_t** argv) {
 
   std::cout << "=== Open Input File" << std::endl;
   std::istream* istr = nullptr;
-  std::ifstream ifile;
+  Extinction::RawFileStream ifile;
   if (ifilename == "std::cin") {
     istr = &std::cin;
   } else {
-    ifile.open(ifilename, std::ios::binary);
+    ifile.open(ifilename);
     if (!ifile) {
       std::cout << "[error] input file is not opened, " << ifilename << std::endl;
       return 1;
@@ -1,11 +1,10 @@
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <string>
-#include <limits>
 #include "TFile.h"
 #include "TTree.h"
 #include "Fct.hh"
+#include "SpillIndex.hh"
 #include "Units.hh"
 #include "ArgReader.hh"
 
@@ -16,6 +15,7 @@ Int_t main(Int_t argc, Char_t** argv) {
   args->AddOpt<Int_t>      ("MSChannel", 'm', "mschannel", "Set channel of mr sync", "26");
   args->AddOpt<Int_t>      ("EMChannel", 'e', "emchannel", "Set channel of event match", "27");
   args->AddOpt<Int_t>      ("EMCount"  , 'c', "emcount"  , "Set default count of event match", "-1");
+  args->AddOpt             ("Index"    , 'x', "index"    , "Write spill index of the rawdata file");
   args->AddOpt             ("Help"     , 'h', "help"     , "Show usage");
 
   if (!args->Parse(argc, argv) || args->IsSet("Help") || args->HasUnsetRequired()) {
@@ -28,6 +28,7 @@ Int_t main(Int_t argc, Char_t** argv) {
   const Int_t       msChannel  = args->GetValue<Int_t>("MSChannel");
   const Int_t       emChannel  = args->GetValue<Int_t>("EMChannel");
   const Int_t       emDefCount = args->GetValue<Int_t>("EMCount");
+  const Bool_t      index      = args->IsSet("Index") && ifilename != "std::cin";
 
   std::string ofilenameRoot;
   if (ofilename.empty()) {
@@ -44,17 +45,10 @@ Int_t main(Int_t argc, Char_t** argv) {
   }
 
   std::cout << "=== Open Input File" << std::endl;
-  std::istream* istr = nullptr;
-  std::ifstream ifile;
-  if (ifilename == "std::cin") {
-    istr = &std::cin;
-  } else {
-    ifile.open(ifilename, std::ios::binary);
-    if (!ifile) {
-      std::cout << "[error] input file is not opened, " << ifilename << std::endl;
-      return 1;
-    }
-    istr = &ifile;
+  Extinction::RawBuffer ibuffer;
+  if (!ibuffer.Open(ifilename)) {
+    std::cout << "[error] input file is not opened, " << ifilename << std::endl;
+    return 1;
   }
 
   std::cout << "=== Create Output File" << std::endl;
@@ -70,71 +64,104 @@ Int_t main(Int_t argc, Char_t** argv) {
 
   std::cout << "=== Initialize Tree" << std::endl;
   decoder.InitializeTree();
+  decoder.Data.AddEMBranch(decoder.Tree);
 
   std::cout << "=== Initialize Variables" << std::endl;
   Int_t lastMrSyncCount = 0;
   Int_t lastMrSyncTdc   = 0;
 
-  std::vector<std::pair<Long64_t, Int_t>> emCount;
+  // Records of the current spill are kept until its event match number is decoded at the footer
+  std::vector<Extinction::Fct::TreeRecord_t> spillData;
   Int_t nextEmCount = emDefCount;
-  emCount.push_back({ std::numeric_limits<Long64_t>::max(), nextEmCount });
+  auto fillSpill =
+    [&](Int_t emcount) {
+      const Extinction::Fct::TreeRecord_t current        = decoder.Data.GetTreeRecord();
+      const Int_t                         currentEmCount = decoder.Data.EMCount;
+      decoder.Data.EMCount = emcount;
+      for (auto&& record : spillData) {
+        decoder.Data.SetTreeRecord(record);
+        decoder.Tree->Fill();
+      }
+      decoder.Data.SetTreeRecord(current);
+      decoder.Data.EMCount = currentEmCount;
+      spillData.clear();
+    };
+
+  Extinction::SpillIndex        spillIndex;
+  Extinction::SpillIndexEntry_t spillIndexEntry;
+  if (index) {
+    std::cout << "=== Open Spill Index" << std::endl;
+    std::cout << Extinction::SpillIndex::GetFilename(ifilename) << std::endl;
+    if (!spillIndex.Open(Extinction::SpillIndex::GetFilename(ifilename))) {
+      return 1;
+    }
+  }
 
   std::cout << "=== Decode" << std::endl;
+  // Words are classified in batches, gate starts are decoded one by one
+  Extinction::Fct::WordBatch_t batch;
   std::size_t count = 0UL;
-  for (; decoder.Read(*istr); ++count) {
-    if (count % 100000 == 0) {
-      std::cout << ">> " << count << std::endl;
-    }
-
-    decoder.Data.MrSyncCount   = lastMrSyncCount;
-    decoder.Data.MrSyncTdc     = lastMrSyncTdc;
-    decoder.Data.TdcFromMrSync = decoder.Data.Tdc - lastMrSyncTdc;
+  for (Long64_t offset = ibuffer.Tell(); decoder.ReadBatch(ibuffer, batch); offset = ibuffer.Tell()) {
+    for (std::size_t i = 0, n = batch.Size(); i < n; ++i, ++count) {
+      decoder.Data.SetDataAsWord(batch, i);
 
-    if (decoder.Data.IsData()) {
-      // std::cout << "data" << std::endl;
-      decoder.Tree->Fill();
-
-      if (decoder.Data.Channel == msChannel) {
-        ++lastMrSyncCount;
-        lastMrSyncTdc = decoder.Data.Tdc;
-      } else if (decoder.Data.Channel == emChannel) {
-        emdata.push_back(decoder.Data.GetTdcData(-1).front());
+      if (count % 100000 == 0) {
+        std::cout << ">> " << count << std::endl;
       }
 
-    } else if (decoder.Data.IsFooter()) {
-      std::cout << "end of spill " << decoder.Data.Spill << std::endl;
-      decoder.Tree->Fill();
-
-      emCount.back() = { decoder.Tree->GetEntries(), decoder.Data.DecodeEventMatchNumber(emdata) };
-      if (emCount.back().second < 0) {
-        emCount.back().second = nextEmCount < 0 ? nextEmCount : nextEmCount++;
-      } else {
-        nextEmCount = emCount.back().second + 1;
+      decoder.Data.MrSyncCount   = lastMrSyncCount;
+      decoder.Data.MrSyncTdc     = lastMrSyncTdc;
+      decoder.Data.TdcFromMrSync = decoder.Data.Tdc - lastMrSyncTdc;
+
+      if (decoder.Data.IsData()) {
+        // std::cout << "data" << std::endl;
+        spillData.push_back(decoder.Data.GetTreeRecord());
+
+        if (decoder.Data.Channel == msChannel) {
+          ++lastMrSyncCount;
+          lastMrSyncTdc = decoder.Data.Tdc;
+        } else if (decoder.Data.Channel == emChannel) {
+          emdata.push_back(decoder.Data.GetTdcData(-1).front());
+        }
+
+      } else if (decoder.Data.Type == Extinction::Fct::DataType::GateStart) {
+        spillIndexEntry = { };
+        spillIndexEntry.HeaderOffset = offset;
+
+      } else if (decoder.Data.IsFooter()) {
+        std::cout << "end of spill " << decoder.Data.Spill << std::endl;
+        spillData.push_back(decoder.Data.GetTreeRecord());
+
+        Int_t emcount = decoder.Data.DecodeEventMatchNumber(emdata);
+        if (emcount < 0) {
+          emcount = nextEmCount < 0 ? nextEmCount : nextEmCount++;
+        } else {
+          nextEmCount = emcount + 1;
+        }
+        fillSpill(emcount);
+
+        spillIndexEntry.FooterOffset = offset + (i + 1) * sizeof(Extinction::Fct::Packet_t);
+        spillIndexEntry.Spill        = decoder.Data.Spill;
+        spillIndexEntry.EMCount      = emcount;
+        spillIndexEntry.WRCount      = -1;
+        spillIndexEntry.Date         = decoder.Data.Date;
+        spillIndex.Write(spillIndexEntry);
+
+        emdata.clear();
       }
-      emCount.push_back({ std::numeric_limits<Long64_t>::max(), nextEmCount });
-
-      emdata.clear();
     }
   }
   std::cout << "# of data record = " << count << std::endl;
 
-  TBranch* emBranch = decoder.Data.AddEMBranch(decoder.Tree);
-  for (Long64_t entry = 0, entries = decoder.Tree->GetEntries(), iem = 0; entry < entries; ++entry) {
-    if (entry < emCount[iem].first || entry < emCount[++iem].first) {
-      decoder.Data.EMCount = emCount[iem].second;
-    } else {
-      std::cout << "[error] unexpected scenario" << std::endl;
-      return 1;
-    }
-    emBranch->Fill();
-  }
+  fillSpill(nextEmCount);
 
   std::cout << "=== Write Objects" << std::endl;
   std::cout << decoder.Tree->GetName() << "\t" << decoder.Tree->GetEntries() << " entries" << std::endl;
   decoder.Tree->Write();
 
   std::cout << "=== Close Files" << std::endl;
-  ifile.close();
+  spillIndex.Close();
+  ibuffer.Close();
   ofile->Close();
 
   return 0;
@@ -19,11 +19,13 @@
 
 Int_t main(Int_t argc, Char_t** argv) {
   Tron::ArgReader* args = new Tron::ArgReader(argv[0]);
-  args->AddArg<std::string>("ConfFilename",                "Set configure filename");
-  args->AddArg<std::string>("Boards"      ,                "Set comma separated board numbers");
-  args->AddArg<std::string>("Input"       ,                "Set comma separated root filenames");
-  args->AddArg<std::string>("Output"      ,                "Set output filename", "");
-  args->AddOpt             ("Help"        , 'h', "help"  , "Show usage");
+  args->AddArg<std::string>("ConfFilename",                  "Set configure filename");
+  args->AddArg<std::string>("Boards"      ,                  "Set comma separated board numbers");
+  args->AddArg<std::string>("Input"       ,                  "Set comma separated root filenames");
+  args->AddArg<std::string>("Output"      ,                  "Set output filename", "");
+  args->AddOpt             ("Delay"       , 'd', "delay"   , "Apply software delay");
+  args->AddOpt<Int_t      >("Prefetch"    , 'p', "prefetch", "Set number of chunks read ahead per board", "0");
+  args->AddOpt             ("Help"        , 'h', "help"    , "Show usage");
 
   if (!args->Parse(argc, argv) || args->IsSet("Help") || args->HasUnsetRequired()) {
     args->ShowUsage();
@@ -39,6 +41,8 @@ Int_t main(Int_t argc, Char_t** argv) {
     .ToMap([&](std::pair<std::string, Int_t> pair) { return pair.second; },
            [&](std::pair<std::string, Int_t> pair) { return pair.first;  });
   const auto ofilename    = args->GetValue("Output");
+  const auto delayOption  = args->IsSet("Delay");
+  const auto prefetch     = args->GetValue<Int_t>("Prefetch");
 
   std::cout << "--- Load configure" << std::endl;
   Tron::ConfReader* conf = new Tron::ConfReader(confFilename);
@@ -60,10 +64,22 @@ Int_t main(Int_t argc, Char_t** argv) {
   std::cout << "--- Initialize tree marger" << std::endl;
   Extinction::Fct::FctData defaultProvider;
   auto marger = new Extinction::Analyzer::TreeMarger(&defaultProvider);
-  if (marger->InitializeTree(ofilename, "tree")) {
+  if (marger->InitializeTree(ofilename)) {
     return 1;
   }
 
+  auto reader = marger->GetReader();
+  reader->SetPrefetchDepth(prefetch);
+
+  if (delayOption) {
+    reader->SetMrSyncTimeOffset(conf->GetValue<Double_t>("MrSyncTimeOffset"));
+
+    const std::string ifilename = conf->GetValue("TdcOffsets");
+    if (reader->LoadTdcOffsets(ifilename) == 0) {
+      std::cerr << "[warning] offset is empty" << std::endl;
+    }
+  }
+
   std::map<Int_t, Double_t> timePerTdc;
   do {
     const std::string ifilename = conf->GetValue("TimePerTdc");
@@ -83,9 +99,7 @@ Int_t main(Int_t argc, Char_t** argv) {
     }
   } while (false);
 
-  marger->SetReadBufferSize   (conf->GetValue<std::size_t>("ReadBufferSize"   ));
-  marger->SetReadBufferMargin (conf->GetValue<std::size_t>("ReadBufferMargin" ));
-  marger->SetTimePerTdc       (timePerTdc                                      );
+  marger->SetTimePerTdc(timePerTdc);
 
   auto providers = Tron::Linq::From(boards)
     .ToMap([](Int_t board) { return board; },
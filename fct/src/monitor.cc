@@ -11,11 +11,13 @@
 #include <cerrno>
 #include <unistd.h>
 #include <mutex>
+#include <atomic>
 #include <limits>
 #include <sys/inotify.h>
 #include <dirent.h>
 #include <pthread.h>
 #include <regex>
+#include <set>
 
 #include "MonitorWindow.hh"
 
@@ -23,7 +25,6 @@
 #include "String.hh"
 #include "ArgReader.hh"
 #include "ConfReader.hh"
-#include "ScopeSubstituter.hh"
 
 namespace {
 
@@ -45,13 +46,21 @@ namespace {
       return TDatime(0U);
     };
 
-  bool                                idle = true;
+  std::atomic<bool>                   idle(true);
   std::mutex                          busyMutex;
   std::mutex                          filenamesMutex;
   std::map<int/*board*/, std::string> filenames;
+  bool                                tailMode = false;
+  std::set<std::string>               closedFilenames; // for tail mode
+  std::map<int/*board*/, std::string> lastFilenames;   // being read by worker
   Extinction::Fct::MonitorWindow*     monitor;
 
-  void TimerTickEventHandler(int) {
+  bool IsFileClosed(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(filenamesMutex);
+    return closedFilenames.find(filename) != closedFilenames.end();
+  }
+
+  void TimerTick() {
     if (monitor->IsTerminated()) {
       // Nothing to do
 
@@ -59,8 +68,21 @@ namespace {
       std::cerr << "[info] canvas was closed" << std::endl;
       monitor->Terminate();
 
-    } else if (idle) {
-      Tron::ScopeSubstituter<Bool_t> lock(idle, false);
+    } else {
+      // Draw plots published by the worker thread
+      monitor->DrawUpdatedPlots();
+
+      if (monitor->IsUpdating()) {
+        return;
+      }
+
+      if (tailMode) {
+        std::lock_guard<std::mutex> lock(filenamesMutex);
+        for (auto&& pair : lastFilenames) {
+          closedFilenames.erase(pair.second);
+        }
+        lastFilenames.clear();
+      }
 
       // Get Filenames
       std::map<int/*board*/, std::string> ifilenames;
@@ -79,12 +101,17 @@ namespace {
         }
       }
 
-      try {
-        std::cout << "Modify plots for " << ifilenames.begin()->second << " and so on" << std::endl;
-        monitor->UpdatePlots(ifilenames, parser);
-      } catch (...) {
-        monitor->Terminate();
-      }
+      std::cout << "Modify plots for " << ifilenames.begin()->second << " and so on" << std::endl;
+      lastFilenames = ifilenames;
+      monitor->StartUpdatePlots(ifilenames, parser);
+    }
+  }
+
+  void TimerTickEventHandler(int) {
+    // Skip the tick while the previous one is still drawing
+    if (idle.exchange(false)) {
+      TimerTick();
+      idle = true;
     }
   }
 
@@ -168,14 +195,37 @@ namespace {
           break;
         }
 
+        if (tailMode &&
+            inotify_p->mask & IN_CREATE) {
+          if (Tron::String::EndWith(inotify_p->name, ".dat")) {
+            std::cerr << "[info] file was created \"" << inotify_p->name << "\"" << std::endl;
+            std::lock_guard<std::mutex> lock(filenamesMutex);
+            if (paths.find(inotify_p->wd) != paths.end()) {
+              const std::string path = paths[inotify_p->wd];
+              filenames[board] = (path + "/" + inotify_p->name);
+            } else {
+              std::cout << "[warning] unknown wd of inotify" << std::endl;
+            }
+          }
+        }
+
         if (inotify_p->mask & IN_CLOSE_WRITE ||
             inotify_p->mask & IN_MOVED_TO) {
           if (Tron::String::EndWith(inotify_p->name, ".dat")) {
             std::cerr << "[info] file was closed \"" << inotify_p->name << "\"" << std::endl;
             std::lock_guard<std::mutex> lock(filenamesMutex);
             if (paths.find(inotify_p->wd) != paths.end()) {
-              const std::string path = paths[inotify_p->wd];
-              filenames[board] = (path + "/" + inotify_p->name);
+              const std::string path     = paths[inotify_p->wd];
+              const std::string filename = path + "/" + inotify_p->name;
+              if (!tailMode) {
+                filenames[board] = filename;
+              } else {
+                // A file moved in is complete and has not been followed yet
+                closedFilenames.insert(filename);
+                if (inotify_p->mask & IN_MOVED_TO) {
+                  filenames[board] = filename;
+                }
+              }
             } else {
               std::cout << "[warning] unknown wd of inotify" << std::endl;
             }
@@ -228,6 +278,7 @@ Int_t main(Int_t argc, Char_t** argv) {
   args->AddOpt<std::string>("IntervalFilename", 'i', "interval", "Set output mr-sync interval filename", "");
   args->AddOpt             ("Sum"             , 's', "sum"     , "Sum coincidence hist");
   args->AddOpt             ("Leakage"         , 'l', "leakage" , "Coincidence only leakage");
+  args->AddOpt             ("Tail"            , 't', "tail"    , "Follow files being written and update plots every spill");
   args->AddOpt             ("Help"            , 'h', "help"    , "Show usage");
 
   if (!args->Parse(argc, argv) || args->IsSet("Help") || args->HasUnsetRequired()) {
@@ -254,6 +305,7 @@ Int_t main(Int_t argc, Char_t** argv) {
   const std::string intervalFilename = args->GetValue("IntervalFilename");
   const Bool_t      accumulate       = args->IsSet("Sum");
   const Bool_t      leakageMode      = args->IsSet("Leakage");
+  tailMode                           = args->IsSet("Tail");
 
   const Bool_t isWatchingMode = !isFilenamesSet;
 
@@ -421,6 +473,9 @@ Int_t main(Int_t argc, Char_t** argv) {
 
   monitor->SetAccumulate(accumulate);
   monitor->SetLeakageMode(leakageMode);
+  if (tailMode) {
+    monitor->SetFollowMode(IsFileClosed);
+  }
   
   monitor->SetHistoryWidth(historyWidth);
   monitor->SetCoinTimeWidth(coinTimeWidth);
@@ -491,12 +546,17 @@ Int_t main(Int_t argc, Char_t** argv) {
       // eventArg->path  = path;
       eventArg->paths = paths;
 
-      // Set write monitor
+      // Set write monitor, leaving timer signals to the gui thread
+      sigset_t signals, oldSignals;
+      sigemptyset(&signals);
+      sigaddset(&signals, SIGALRM);
+      pthread_sigmask(SIG_BLOCK, &signals, &oldSignals);
       pthread_t* pthread = new pthread_t();
       if (pthread_create(pthread, nullptr, &InotifyEventListener, (void*)eventArg)) {
         std::cerr << "[error] pthread_create error" << std::endl;
         exit(EXIT_FAILURE);
       }
+      pthread_sigmask(SIG_SETMASK, &oldSignals, nullptr);
 
       threads[pthread] = eventArg;
     }
@@ -4,8 +4,11 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <algorithm>
+#include <cstring>
 #include "TTree.h"
 #include "Units.hh"
+#include "RawBuffer.hh"
 #include "Tdc.hh"
 #include "Detector.hh"
 
@@ -21,6 +24,7 @@ namespace Extinction {
   namespace Hul {
 
     const std::string Name = "HUL";
+    const std::size_t NofChannels = 64;
 
     namespace ChannelMapWithBoard {
       std::map<Int_t/*board*/, std::map<Int_t/*raw*/, Int_t>> Ext;
@@ -31,6 +35,58 @@ namespace Extinction {
       std::map<Int_t/*board*/, std::map<Int_t/*raw*/, Int_t>> Evm;
       std::map<Int_t/*global*/, Int_t/*board*/>               Board;
 
+      // Dense raw -> global channel table of each board, built by Load(), -1 for unmapped
+      struct Lookup_t {
+        Int_t Channels[NofChannels];
+        Int_t MrSyncChannel;
+      };
+      std::vector<Lookup_t>                                   Lookup;
+
+      inline const Lookup_t* FindLookup(Int_t board) {
+        return (0 <= board && board < (Int_t)Lookup.size()) ? &Lookup[board] : nullptr;
+      }
+
+      void BuildLookup() {
+        Int_t maxBoard = -1;
+        for (auto&& map : { &Ext, &Hod, &Tc, &Bh, &MrSync, &Evm }) {
+          if (!map->empty()) {
+            maxBoard = std::max(maxBoard, map->rbegin()->first);
+          }
+        }
+
+        Lookup_t empty;
+        std::fill(std::begin(empty.Channels), std::end(empty.Channels), -1);
+        empty.MrSyncChannel = -1;
+        Lookup.assign(maxBoard + 1, empty);
+
+        // Fill in reverse priority of GetTdcData, so that preferred detector overwrites
+        auto fill =
+          [&](const std::map<Int_t, std::map<Int_t, Int_t>>& map, Int_t offset) {
+            for (auto&& pair : map) {
+              if (pair.first < 0) {
+                continue;
+              }
+              for (auto&& rawCh : pair.second) {
+                if (0 <= rawCh.first && rawCh.first < (Int_t)NofChannels) {
+                  Lookup[pair.first].Channels[rawCh.first] = rawCh.second + offset;
+                }
+              }
+            }
+          };
+        fill(Evm   , EventMatch        ::GlobalChannelOffset);
+        fill(MrSync, MrSync            ::GlobalChannelOffset);
+        fill(Bh    , BeamlineHodoscope ::GlobalChannelOffset);
+        fill(Tc    , TimingCounter     ::GlobalChannelOffset);
+        fill(Hod   , Hodoscope         ::GlobalChannelOffset);
+        fill(Ext   , ExtinctionDetector::GlobalChannelOffset);
+
+        for (auto&& pair : MrSync) {
+          if (pair.first >= 0 && !pair.second.empty()) {
+            Lookup[pair.first].MrSyncChannel = pair.second.begin()->second + MrSync::GlobalChannelOffset;
+          }
+        }
+      }
+
       void Load(const Tron::ConfReader* conf, const std::vector<Int_t>& boards) {
         for (auto&& board : boards) {
           const std::string key = Form("ChannelMap.%d", board);
@@ -91,6 +147,8 @@ namespace Extinction {
         checkDouplicate("TimingCounter"     , Tc    , TimingCounter     ::NofChannels);
         checkDouplicate("MRSync"            , MrSync, MrSync            ::NofChannels);
         checkDouplicate("EventMatch"        , Evm   , EventMatch        ::NofChannels);
+
+        BuildLookup();
       }
     }
 
@@ -144,6 +202,41 @@ namespace Extinction {
 
     }
 
+    // Values of the tree branches of a packet, kept by the decoder until the spill is filled
+    struct TreeRecord_t {
+      ULong64_t Date;
+      Int_t     Spill;
+      UChar_t   Type;
+      UShort_t  Channel;
+      UInt_t    Tdc;
+      UShort_t  Heartbeat;
+      UShort_t  Tot;
+      Int_t     MrSyncCount;
+      Long64_t  TdcFromMrSync;
+    };
+
+    // Columnar packets decoded by HulData::ReadBatch(),
+    // a run of data/heartbeat packets in a spill, or a single packet of the other types
+    struct PacketBatch_t {
+      std::vector<UChar_t>  Type;
+      std::vector<UShort_t> Channel;
+      std::vector<UInt_t>   Tdc;
+      std::vector<UShort_t> Tot;
+      std::vector<UShort_t> Heartbeat;
+
+      inline std::size_t Size() const {
+        return Type.size();
+      }
+
+      inline void Resize(std::size_t size) {
+        Type     .resize(size);
+        Channel  .resize(size);
+        Tdc      .resize(size);
+        Tot      .resize(size);
+        Heartbeat.resize(size);
+      }
+    };
+
     class HulData : public ITdcDataProvider {
     public:
       ULong64_t Date;
@@ -230,20 +323,146 @@ namespace Extinction {
           return ret2;
         }
 
+        SetDataAsPacket(buff1, buff2);
+#if HUL_FORMAT_VERSION == 1
+        // No time stamp
+#else
+        if (Type == DataType::SpillStart) {
+          auto& ret3 = file.read((char*)&Date, sizeof(ULong64_t));
+          if (!ret3) {
+            return ret3;
+          }
+        }
+#endif
+
+        if (packet) {
+          packet->Packet1 = buff1;
+          packet->Packet2 = buff2;
+        }
+
+        return file;
+      }
+
+      Bool_t Read(RawBuffer& buffer,
+                  Packet_t* packet = nullptr) {
+        Type          = DataType::None;
+        Channel       = 0;
+        Tdc           = 0;
+        Tot           = 0;
+        TdcFromMrSync = 0;
+
+        const UChar_t* buff = buffer.Take(sizeof(Packet1_t) + sizeof(Packet2_t));
+        if (!buff) {
+          return false;
+        }
+
+        Packet1_t buff1;
+        std::memcpy(&buff1, buff, sizeof(Packet1_t));
+        const Packet2_t buff2 = buff[sizeof(Packet1_t)];
+
+        SetDataAsPacket(buff1, buff2);
+#if HUL_FORMAT_VERSION == 1
+        // No time stamp
+#else
+        if (Type == DataType::SpillStart) {
+          const UChar_t* date = buffer.Take(sizeof(ULong64_t));
+          if (!date) {
+            return false;
+          }
+          std::memcpy(&Date, date, sizeof(ULong64_t));
+        }
+#endif
+
+        if (packet) {
+          packet->Packet1 = buff1;
+          packet->Packet2 = buff2;
+        }
+
+        return true;
+      }
+
+      // Decodes a run of data/heartbeat packets at once in a branchless loop,
+      // or a single packet of the other types by Read(). The data represents the last packet of the batch.
+      std::size_t ReadBatch(RawBuffer& buffer, PacketBatch_t& batch, std::size_t maxSize = 4096) {
+        const std::size_t packetSize = sizeof(Packet1_t) + sizeof(Packet2_t);
+
+        std::size_t    length = 0;
+        const UChar_t* buff   = buffer.Peek(packetSize, length);
+        if (!buff) {
+          batch.Resize(0);
+          return 0;
+        }
+
+        // Classify types, the batch ends before the first packet which changes the spill or reports error
+        const std::size_t n    = std::min(length / packetSize, maxSize);
+        std::size_t       size = 0;
+        for (; size < n; ++size) {
+          const UChar_t type = Packet::GetType(buff[size * packetSize + sizeof(Packet1_t)]);
+          if (type != DataType::Data && type != DataType::Heartbeat) {
+            break;
+          }
+        }
+
+        if (size == 0) {
+          if (!Read(buffer)) {
+            batch.Resize(0);
+            return 0;
+          }
+          batch.Resize(1);
+          batch.Type     [0] = Type;
+          batch.Channel  [0] = Channel;
+          batch.Tdc      [0] = Tdc;
+          batch.Tot      [0] = Tot;
+          batch.Heartbeat[0] = Heartbeat;
+          return 1;
+        }
+
+        // Extract all fields regardless of type
+        batch.Resize(size);
+        for (std::size_t i = 0; i < size; ++i) {
+          const UChar_t* p = buff + i * packetSize;
+          Packet1_t buff1;
+          std::memcpy(&buff1, p, sizeof(Packet1_t));
+          const Packet2_t buff2 = p[sizeof(Packet1_t)];
+          batch.Type     [i] = Packet::GetType(buff2);
+          batch.Channel  [i] = Packet::GetChannel(buff1);
+          batch.Tdc      [i] = Packet::GetTdc(buff1);
+          batch.Tot      [i] = Packet::GetTot(buff1, buff2);
+          batch.Heartbeat[i] = Packet::GetHeartbeat(buff1);
+        }
+
+        // Carry heartbeat to data packets, and clear data fields of heartbeat packets as Read() does
+        UShort_t heartbeat = Heartbeat;
+        for (std::size_t i = 0; i < size; ++i) {
+          const Bool_t isData = batch.Type[i] == DataType::Data;
+          heartbeat          = isData ? heartbeat : batch.Heartbeat[i];
+          batch.Heartbeat[i] = heartbeat;
+          batch.Channel  [i] = isData ? batch.Channel[i] : 0;
+          batch.Tdc      [i] = isData ? batch.Tdc    [i] : 0;
+          batch.Tot      [i] = isData ? batch.Tot    [i] : 0;
+        }
+
+        buffer.Skip(size * packetSize);
+        SetDataAsPacket(batch, size - 1);
+        return size;
+      }
+
+      inline void SetDataAsPacket(const PacketBatch_t& batch, std::size_t i) {
+        Type          = batch.Type     [i];
+        Channel       = batch.Channel  [i];
+        Tdc           = batch.Tdc      [i];
+        Tot           = batch.Tot      [i];
+        Heartbeat     = batch.Heartbeat[i];
+        TdcFromMrSync = 0;
+      }
+
+      inline void SetDataAsPacket(Packet1_t buff1, Packet2_t buff2) {
         Type = Packet::GetType(buff2);
         switch (Type) {
         case DataType::SpillStart:
           {
             ++Spill;
             Heartbeat = 0;
-#if HUL_FORMAT_VERSION == 1
-            // No time stamp
-#else
-            auto& ret3 = file.read((char*)&Date, sizeof(ULong64_t));
-            if (!ret3) {
-              return ret3;
-            }
-#endif
           }
           break;
         case DataType::SpillEnd:
@@ -271,13 +490,6 @@ namespace Extinction {
           }
           break;
         }
-
-        if (packet) {
-          packet->Packet1 = buff1;
-          packet->Packet2 = buff2;
-        }
-
-        return file;
       }
 
       inline virtual Bool_t IsData() const override {
@@ -336,8 +548,15 @@ namespace Extinction {
       }
 
       inline virtual std::vector<TdcData> GetTdcData(Int_t board) const override {
-        using namespace ChannelMapWithBoard;
-        TdcData datum;
+        std::vector<TdcData> data;
+        AppendTdcData(board, data);
+        return data;
+      }
+
+      inline virtual void AppendTdcData(Int_t board, std::vector<TdcData>& data) const override {
+        const ChannelMapWithBoard::Lookup_t* lookup = ChannelMapWithBoard::FindLookup(board);
+        data.emplace_back();
+        TdcData& datum = data.back();
         datum.Date            = Date;
         datum.Spill           = Spill;
         datum.EMCount         = EMCount;
@@ -350,11 +569,8 @@ namespace Extinction {
         datum.LastMrSyncTdc   = MrSyncTdc;
         datum.NextMrSyncTdc   = 0;
         datum.TdcFromMrSync   = TdcFromMrSync;
-        typename decltype(MrSync      )::const_iterator itr1;
-        typename decltype(itr1->second)::const_iterator itr2;
-        if        ((itr1 = MrSync      .find(board  )) != MrSync      .end() &&
-                   (itr2 = itr1->second.begin()      ) != itr1->second.end()) {
-          datum.MrSyncChannel = itr2->second + MrSync::GlobalChannelOffset;
+        if (lookup && lookup->MrSyncChannel >= 0) {
+          datum.MrSyncChannel = lookup->MrSyncChannel;
         }
 
         if (!IsData()) {
@@ -362,27 +578,10 @@ namespace Extinction {
           datum.Channel       = -1;
         } else {
           datum.RawChannel      = Channel;
-          if        ((itr1 = Ext         .find(board  )) != Ext         .end() &&
-                     (itr2 = itr1->second.find(Channel)) != itr1->second.end()) {
-            datum.Channel     = itr2->second + ExtinctionDetector::GlobalChannelOffset;
-          } else if ((itr1 = Hod         .find(board  )) != Hod         .end() &&
-                     (itr2 = itr1->second.find(Channel)) != itr1->second.end()) {
-            datum.Channel     = itr2->second + Hodoscope         ::GlobalChannelOffset;
-          } else if ((itr1 = Tc          .find(board  )) != Tc          .end() &&
-                     (itr2 = itr1->second.find(Channel)) != itr1->second.end()) {
-            datum.Channel     = itr2->second + TimingCounter     ::GlobalChannelOffset;
-          } else if ((itr1 = Bh          .find(board  )) != Bh          .end() &&
-                     (itr2 = itr1->second.find(Channel)) != itr1->second.end()) {
-            datum.Channel     = itr2->second + BeamlineHodoscope ::GlobalChannelOffset;
-          } else if ((itr1 = MrSync      .find(board  )) != MrSync      .end() &&
-                     (itr2 = itr1->second.find(Channel)) != itr1->second.end()) {
-            datum.Channel     = itr2->second + MrSync            ::GlobalChannelOffset;
-          } else if ((itr1 = Evm         .find(board  )) != Evm         .end() &&
-                     (itr2 = itr1->second.find(Channel)) != itr1->second.end()) {
-            datum.Channel     = itr2->second + EventMatch        ::GlobalChannelOffset;
+          if (lookup && Channel < NofChannels && lookup->Channels[Channel] >= 0) {
+            datum.Channel       = lookup->Channels[Channel];
           }
         }
-        return { datum };
       }
 
       inline virtual Int_t FindBoard(Int_t globalChannel) const override {
@@ -407,6 +606,20 @@ namespace Extinction {
         tree->Branch("dtdc"     , &TdcFromMrSync, "dtdc"   "/L");
         tree->SetAlias("tdc2", "tdc + 0x80000 * heartbeat");
       }
+      inline TreeRecord_t GetTreeRecord() const {
+        return { Date, Spill, Type, Channel, Tdc, Heartbeat, Tot, MrSyncCount, TdcFromMrSync };
+      }
+      inline void SetTreeRecord(const TreeRecord_t& record) {
+        Date          = record.Date;
+        Spill         = record.Spill;
+        Type          = record.Type;
+        Channel       = record.Channel;
+        Tdc           = record.Tdc;
+        Heartbeat     = record.Heartbeat;
+        Tot           = record.Tot;
+        MrSyncCount   = record.MrSyncCount;
+        TdcFromMrSync = record.TdcFromMrSync;
+      }
       inline TBranch* AddEMBranch(TTree* tree) {
         return tree->Branch("emcount", &EMCount, "emcount/I");
       }
@@ -510,6 +723,15 @@ namespace Extinction {
                                             Packet_t* packet = nullptr) {
         return Data.Read(file, packet);
       }
+
+      inline Bool_t Read(RawBuffer& buffer,
+                         Packet_t* packet = nullptr) {
+        return Data.Read(buffer, packet);
+      }
+
+      inline std::size_t ReadBatch(RawBuffer& buffer, PacketBatch_t& batch) {
+        return Data.ReadBatch(buffer, batch);
+      }
     };
 
   }
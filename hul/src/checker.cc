@@ -1,11 +1,17 @@
 #include <iostream>
 #include <fstream>
+#include "RawFileStream.hh"
 
 int main(int argc, char** argv) {
   if (argc < 2) {
     std::cout << "usage: " << argv[0] << " [filename]" << std::endl;
+    return 0;
+  }
+  Extinction::RawFileStream ifile(argv[1]);
+  if (!ifile) {
+    std::cout << "[error] input file is not opened, " << argv[1] << std::endl;
+    return 1;
   }
-  std::ifstream ifile(argv[1], std::ios::binary);
 
   unsigned int  ibuf = 0;
   unsigned char cbuf = 0;
@@ -8,6 +8,7 @@
 #include "TFile.h"
 #include "TTree.h"
 #include "Hul.hh"
+#include "RawFileStream.hh"
 #include "Units.hh"
 #include "ArgReader.hh"
 
@@ -29,11 +30,11 @@ Int_t main(Int_t argc, Char_t** argv) {
 
   // Open Input File
   std::istream* istr = nullptr;
-  std::ifstream ifile;
+  Extinction::RawFileStream ifile;
   if (ifilename == "std::cin") {
     istr = &std::cin;
   } else {
-    ifile.open(ifilename, std::ios::binary);
+    ifile.open(ifilename);
     if (!ifile) {
       std::cerr << "[error] input file is not opened, " << ifilename << std::endl;
       return 1;
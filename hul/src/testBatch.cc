@@ -0,0 +1,131 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <random>
+#include "Hul.hh"
+#include "RawBuffer.hh"
+#include "ArgReader.hh"
+
+// Writes a mock raw file in the same way as genMock, decodes it with both Read() and ReadBatch(),
+// and exits with non-zero if they differ in any packet.
+
+Int_t main(Int_t argc, Char_t** argv) {
+  Tron::ArgReader* args = new Tron::ArgReader(argv[0]);
+  args->AddOpt<std::string>("Output"   , 'o', "output"   , "Set mock rawdata filename", "hulmock_batch.dat");
+  args->AddOpt<Int_t>      ("Spills"   , 's', "spills"   , "Set # of spills"          , "3");
+  args->AddOpt<Int_t>      ("Seed"     , 'r', "seed"     , "Set random seed"          , "1");
+  args->AddOpt<Int_t>      ("MaxErrors", 'e', "errors"   , "Set # of mismatches to be shown", "10");
+  args->AddOpt             ("Help"     , 'h', "help"     , "Show usage");
+
+  if (!args->Parse(argc, argv) || args->IsSet("Help") || args->HasUnsetRequired()) {
+    args->ShowUsage();
+    return 0;
+  }
+
+  const std::string filename  = args->GetValue("Output");
+  const Int_t       nofSpills = args->GetValue<Int_t>("Spills");
+  const Int_t       seed      = args->GetValue<Int_t>("Seed");
+  const Int_t       maxErrors = args->GetValue<Int_t>("MaxErrors");
+
+  std::cout << "=== Generate Mock" << std::endl;
+  {
+    std::ofstream ofile(filename, std::ios::binary);
+    if (!ofile) {
+      std::cout << "[error] output file is not opened, " << filename << std::endl;
+      return 1;
+    }
+
+    // Sorted hits interleaved with heartbeats like genMock, with a few error packets
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<Int_t> hitsPerHeartbeat(0, 40);
+    std::uniform_int_distribution<Int_t> channel(0, 63);
+    std::uniform_int_distribution<Int_t> tdc(0, 0x7FFFF);
+    std::uniform_int_distribution<Int_t> error(0, 999);
+
+    Extinction::Hul::HulData data;
+    for (Int_t spill = 0; spill < nofSpills; ++spill) {
+      data.WriteSpillStart(ofile);
+#if HUL_FORMAT_VERSION != 1
+      const ULong64_t date = 1600000000ULL + spill;
+      ofile.write((Char_t*)&date, sizeof(ULong64_t));
+#endif
+      for (Int_t heartbeat = 1; heartbeat <= 2000; ++heartbeat) {
+        data.Heartbeat = heartbeat;
+        data.WriteHeartbeat(ofile);
+        if (error(random) == 0) {
+          data.WriteError(ofile);
+        }
+        for (Int_t hit = 0, hits = hitsPerHeartbeat(random); hit < hits; ++hit) {
+          data.Channel = channel(random);
+          data.Tdc     = tdc(random);
+          data.WriteData(ofile);
+        }
+      }
+      data.WriteSpillEnd(ofile);
+    }
+  }
+
+  std::cout << "=== Open Input File" << std::endl;
+  std::ifstream ifile(filename, std::ios::binary);
+  if (!ifile) {
+    std::cout << "[error] input file is not opened, " << filename << std::endl;
+    return 1;
+  }
+  Extinction::RawBuffer ibuffer;
+  if (!ibuffer.Open(filename)) {
+    std::cout << "[error] input file is not opened, " << filename << std::endl;
+    return 1;
+  }
+
+  Extinction::Hul::HulData       scalar;
+  Extinction::Hul::HulData       batched;
+  Extinction::Hul::PacketBatch_t batch;
+
+  std::cout << "=== Compare" << std::endl;
+  std::size_t count  = 0UL;
+  std::size_t errors = 0UL;
+  while (batched.ReadBatch(ibuffer, batch)) {
+    for (std::size_t i = 0, n = batch.Size(); i < n; ++i, ++count) {
+      if (!scalar.Read(ifile)) {
+        std::cout << "[error] scalar decoder ended at packet " << count << std::endl;
+        return 1;
+      }
+      if (scalar.Type      != batch.Type     [i] ||
+          scalar.Channel   != batch.Channel  [i] ||
+          scalar.Tdc       != batch.Tdc      [i] ||
+          scalar.Tot       != batch.Tot      [i] ||
+          scalar.Heartbeat != batch.Heartbeat[i]) {
+        if (errors < (std::size_t)maxErrors) {
+          std::cout << "[error] mismatch at packet " << count << ", "
+                    << "Type "      << (Int_t)scalar.Type << " / " << (Int_t)batch.Type[i] << ", "
+                    << "Channel "   << scalar.Channel     << " / " << batch.Channel  [i]   << ", "
+                    << "Tdc "       << scalar.Tdc         << " / " << batch.Tdc      [i]   << ", "
+                    << "Tot "       << scalar.Tot         << " / " << batch.Tot      [i]   << ", "
+                    << "Heartbeat " << scalar.Heartbeat   << " / " << batch.Heartbeat[i]   << std::endl;
+        }
+        ++errors;
+      }
+    }
+    if (batched.Spill != scalar.Spill || batched.Date != scalar.Date) {
+      if (errors < (std::size_t)maxErrors) {
+        std::cout << "[error] mismatch of spill at packet " << count << ", "
+                  << "Spill " << scalar.Spill << " / " << batched.Spill << ", "
+                  << "Date "  << scalar.Date  << " / " << batched.Date  << std::endl;
+      }
+      ++errors;
+    }
+  }
+  if (scalar.Read(ifile)) {
+    std::cout << "[error] batch decoder ended at packet " << count << std::endl;
+    return 1;
+  }
+
+  std::cout << "# of packets = " << count << std::endl;
+  std::cout << "# of mismatches = " << errors << std::endl;
+
+  std::cout << "=== Close Files" << std::endl;
+  ifile.close();
+  ibuffer.Close();
+
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,305 @@
+#ifndef Extinction_Daq_hh
+#define Extinction_Daq_hh
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <cerrno>
+#include <arpa/inet.h>
+#include <zlib.h>
+#include "SpillIndex.hh"
+
+// Capture primitives shared by daq (one board) and capture (many boards)
+
+constexpr int UNITSIZE = 13;
+
+struct footer_t {
+  unsigned int  hoge0;
+  unsigned char hoge1;
+  unsigned int  magicWord0;
+  unsigned int  magicWord1;
+  inline bool IsFooter() const {
+    static const unsigned int footerWord = htonl(0xAAAAAAAA);
+    return magicWord0 == footerWord;
+  }
+} __attribute__((__packed__));
+
+struct header_t {
+  unsigned int  magicWord0;
+  unsigned int  magicWord1;
+  unsigned int  hoge0;
+  unsigned char hoge1;
+  inline bool IsHeader() const {
+    static const unsigned int headerWord = htonl(0x34567012);
+    return magicWord1 == headerWord;
+  }
+  // Hardware spill counter, Spill[15:0] at the tail
+  inline unsigned short GetSpill() const {
+    const unsigned char* bytes = (const unsigned char*)this;
+    return (bytes[11] << 8) | bytes[12];
+  }
+} __attribute__((__packed__));
+
+struct DataType {
+  enum {
+        Header = -1,
+        Data   =  0,
+        Footer =  1,
+  };
+};
+
+inline int GetDataType(unsigned char* rcvdBuffer) {
+  if     (((header_t*)rcvdBuffer)->IsHeader()) return DataType::Header;
+  else if(((footer_t*)rcvdBuffer)->IsFooter()) return DataType::Footer;
+  return DataType::Data;
+}
+
+// Capture buffer handed from the socket reader to the writer thread
+struct buffer_t {
+  unsigned char* data;
+  int            length;
+  bool           rotate; // close file after this buffer
+  bool           last;   // no buffer follows
+  std::size_t    board = 0; // source board in multi-board capture
+  std::vector<Extinction::SpillIndexEntry_t> spills; // spills ending in this buffer, offsets from the buffer head
+};
+
+// Lock-free single producer and single consumer queue
+template <typename T>
+class spsc_queue_t {
+private:
+  std::vector<T>           items;
+  std::atomic<std::size_t> head { 0 };
+  std::atomic<std::size_t> tail { 0 };
+
+public:
+  explicit spsc_queue_t(std::size_t capacity) : items(capacity) { }
+
+  bool push(const T& item) {
+    const std::size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == items.size()) {
+      return false;
+    }
+    items[t % items.size()] = item;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& item) {
+    const std::size_t h = head.load(std::memory_order_relaxed);
+    if (tail.load(std::memory_order_acquire) == h) {
+      return false;
+    }
+    item = items[h % items.size()];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::size_t size() const {
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+  }
+};
+
+inline long long elapsedUsec(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Moves or compresses closed files on background threads, so the capture loop never forks
+class archiver_t {
+public:
+  enum mode_t {
+        None,
+        Move,     // same as "mv <file> <dir>"
+        Compress, // same as "tar -czf <dir>/<file>.tar.gz --remove-files <file>"
+  };
+
+private:
+  mode_t                   mode;
+  std::string              dir;
+  std::vector<std::thread> workers;
+  std::deque<std::pair<std::string, bool>> jobs; // filename, is spill index
+  std::mutex               mutex;
+  std::condition_variable  cond;
+  bool                     stop = false;
+
+public:
+  archiver_t(mode_t mode, const std::string& dir, int nofWorkers) : mode(mode), dir(dir) {
+    if (mode != None) {
+      for (int i = 0; i < nofWorkers; ++i) {
+        workers.emplace_back(&archiver_t::run, this);
+      }
+    }
+  }
+  ~archiver_t() {
+    finish();
+  }
+
+  // Spill index is moved beside the archive even in compress mode, its offsets refer to the raw file
+  void push(const std::string& fname, bool index = false) {
+    if (mode == None) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobs.push_back({ fname, index });
+    }
+    cond.notify_one();
+  }
+
+  // Waits for all queued files
+  void finish() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    cond.notify_all();
+    for (auto&& worker : workers) {
+      worker.join();
+    }
+    workers.clear();
+  }
+
+private:
+  void run() {
+    while (true) {
+      std::string fname;
+      bool        index;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this] { return stop || !jobs.empty(); });
+        if (jobs.empty()) {
+          return;
+        }
+        fname = jobs.front().first;
+        index = jobs.front().second;
+        jobs.pop_front();
+      }
+
+      const bool succeeded =
+        mode == Move ? moveFile(fname, dir + "/" + basename(fname)) :
+        index        ? moveFile(fname, dir + "/" + fname) :
+        compressFile(fname);
+      if (!succeeded) {
+        std::cerr << "[error] failed to archive " << fname << std::endl;
+      }
+    }
+  }
+
+  static std::string basename(const std::string& fname) {
+    const std::size_t pos = fname.rfind('/');
+    return pos == std::string::npos ? fname : fname.substr(pos + 1);
+  }
+
+  bool moveFile(const std::string& fname, const std::string& oname) const {
+    if (rename(fname.data(), oname.data()) == 0) {
+      return true;
+    } else if (errno != EXDEV) {
+      return false;
+    }
+
+    // Copy across file systems, under a temporary name until complete
+    const std::string pname = oname + ".part";
+    FILE* fin  = fopen(fname.data(), "rb");
+    FILE* fout = fin ? fopen(pname.data(), "wb") : nullptr;
+    bool  ok   = fin && fout;
+    std::vector<char> buff(1 << 20);
+    for (std::size_t n; ok && (n = fread(buff.data(), sizeof(char), buff.size(), fin)) > 0; ) {
+      ok = fwrite(buff.data(), sizeof(char), n, fout) == n;
+    }
+    if (fin ) fclose(fin);
+    if (fout) ok = (fclose(fout) == 0) && ok;
+    return commit(pname, oname, ok) && remove(fname.data()) == 0;
+  }
+
+  // Gives the complete output its final name, a reader never sees a partial file under it
+  static bool commit(const std::string& pname, const std::string& oname, bool ok) {
+    if (ok && rename(pname.data(), oname.data()) == 0) {
+      return true;
+    }
+    remove(pname.data());
+    return false;
+  }
+
+  // Writes a gzipped ustar archive of a single file
+  bool compressFile(const std::string& fname) const {
+    std::string member = fname;
+    while (!member.empty() && member[0] == '/') {
+      member.erase(0, 1);
+    }
+    const std::string oname = dir + "/" + fname + ".tar.gz";
+    const std::string pname = oname + ".part";
+
+    FILE* fin = fopen(fname.data(), "rb");
+    if (!fin) {
+      return false;
+    }
+    fseek(fin, 0, SEEK_END);
+    const long size = ftell(fin);
+    rewind(fin);
+
+    gzFile fout = gzopen(pname.data(), "wb6");
+    if (!fout) {
+      fclose(fin);
+      return false;
+    }
+
+    // Header block
+    char header[512] = { };
+    std::string name = member, prefix;
+    if (name.size() > 100) {
+      const std::size_t pos = name.find('/', name.size() - 100 - 1);
+      if (pos != std::string::npos && pos <= 155) {
+        prefix = name.substr(0, pos);
+        name   = name.substr(pos + 1);
+      }
+    }
+    strncpy(header      , name.data(), 100);
+    snprintf(header + 100, 8, "%07o", 0644);
+    snprintf(header + 108, 8, "%07o", 0);
+    snprintf(header + 116, 8, "%07o", 0);
+    snprintf(header + 124, 12, "%011lo", (unsigned long)size);
+    snprintf(header + 136, 12, "%011lo", (unsigned long)time(nullptr));
+    memset(header + 148, ' ', 8);
+    header[156] = '0';
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+    strncpy(header + 345, prefix.data(), 155);
+    unsigned int checksum = 0;
+    for (unsigned char c : header) {
+      checksum += c;
+    }
+    snprintf(header + 148, 8, "%06o", checksum);
+
+    bool ok = gzwrite(fout, header, sizeof(header)) == sizeof(header);
+
+    // Data blocks
+    std::vector<char> buff(1 << 20);
+    long written = 0;
+    for (std::size_t n; ok && (n = fread(buff.data(), sizeof(char), buff.size(), fin)) > 0; written += n) {
+      ok = gzwrite(fout, buff.data(), n) == (int)n;
+    }
+    ok = ok && written == size;
+
+    // Padding and end of archive
+    const char zeros[1024] = { };
+    if (ok && size % 512) {
+      ok = gzwrite(fout, zeros, 512 - size % 512) == 512 - size % 512;
+    }
+    ok = ok && gzwrite(fout, zeros, sizeof(zeros)) == sizeof(zeros);
+
+    fclose(fin);
+    ok = (gzclose(fout) == Z_OK) && ok;
+    return commit(pname, oname, ok) && remove(fname.data()) == 0;
+  }
+};
+
+#endif
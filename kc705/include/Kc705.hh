@@ -4,10 +4,12 @@
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <algorithm>
 #include "TTree.h"
 #include "Units.hh"
 #include "Inet.hh"
 #include "Tdc.hh"
+#include "RawBuffer.hh"
 #include "Detector.hh"
 
 #include "ConfReader.hh"
@@ -24,6 +26,9 @@ namespace Extinction {
 
     const std::string Name = "KC705";
 
+    const std::size_t MppcNch = 64UL;
+    const std::size_t SubNch  = 12UL;
+
     namespace ChannelMapWithBoard {
       std::map<Int_t/*board*/, std::map<Int_t/*raw*/, Int_t>> ExtMppc;
       std::map<Int_t/*board*/, std::map<Int_t/*raw*/, Int_t>> ExtSub;
@@ -33,6 +38,58 @@ namespace Extinction {
       std::map<Int_t/*board*/, std::map<Int_t/*raw*/, Int_t>> MrSync;
       std::map<Int_t/*global*/, Int_t/*board*/>               Board;
 
+      // Dense raw -> global channel table of each board, built by Load()
+      // Channels[0, MppcNch) are mppc bits, Channels[MppcNch, MppcNch + SubNch) are sub bits, -1 for unmapped
+      struct Lookup_t {
+        Int_t Channels[MppcNch + SubNch];
+        Int_t MrSyncChannel;
+      };
+      std::vector<Lookup_t>                                   Lookup;
+
+      inline const Lookup_t* FindLookup(Int_t board) {
+        return (0 <= board && board < (Int_t)Lookup.size()) ? &Lookup[board] : nullptr;
+      }
+
+      void BuildLookup() {
+        Int_t maxBoard = -1;
+        for (auto&& map : { &ExtMppc, &ExtSub, &Hod, &Tc, &Bh, &MrSync }) {
+          if (!map->empty()) {
+            maxBoard = std::max(maxBoard, map->rbegin()->first);
+          }
+        }
+
+        Lookup_t empty;
+        std::fill(std::begin(empty.Channels), std::end(empty.Channels), -1);
+        empty.MrSyncChannel = -1;
+        Lookup.assign(maxBoard + 1, empty);
+
+        // Fill in reverse priority of GetTdcData, so that preferred detector overwrites
+        auto fill =
+          [&](const std::map<Int_t, std::map<Int_t, Int_t>>& map, std::size_t first, std::size_t nch, Int_t offset) {
+            for (auto&& pair : map) {
+              if (pair.first < 0) {
+                continue;
+              }
+              for (auto&& rawCh : pair.second) {
+                if (0 <= rawCh.first && rawCh.first < (Int_t)nch) {
+                  Lookup[pair.first].Channels[first + rawCh.first] = rawCh.second + offset;
+                }
+              }
+            }
+          };
+        fill(Bh     , MppcNch, SubNch , BeamlineHodoscope ::GlobalChannelOffset);
+        fill(Tc     , MppcNch, SubNch , TimingCounter     ::GlobalChannelOffset);
+        fill(Hod    , MppcNch, SubNch , Hodoscope         ::GlobalChannelOffset);
+        fill(ExtSub , MppcNch, SubNch , ExtinctionDetector::GlobalChannelOffset);
+        fill(ExtMppc,       0, MppcNch, ExtinctionDetector::GlobalChannelOffset);
+
+        for (auto&& pair : MrSync) {
+          if (pair.first >= 0 && !pair.second.empty()) {
+            Lookup[pair.first].MrSyncChannel = pair.second.begin()->second + MrSync::GlobalChannelOffset;
+          }
+        }
+      }
+
       void Load(const Tron::ConfReader* conf, const std::vector<Int_t>& boards) {
         for (auto&& board : boards) {
           const std::string key = Form("ChannelMap.%d", board);
@@ -93,6 +150,8 @@ namespace Extinction {
         checkDouplicate("BeamlineHodoscope" , Bh     , BeamlineHodoscope ::NofChannels);
         checkDouplicate("TimingCounter"     , Tc     , TimingCounter     ::NofChannels);
         checkDouplicate("MRSync"            , MrSync , MrSync            ::NofChannels);
+
+        BuildLookup();
       }
     }
 
@@ -107,9 +166,6 @@ namespace Extinction {
       };
     };
 
-    const std::size_t MppcNch = 64UL;
-    const std::size_t SubNch  = 12UL;
-
     using Packet_t = UChar_t[13];
 
     namespace Packet {
@@ -125,13 +181,7 @@ namespace Extinction {
         return data[sizeof(Packet_t) - 1 - byte] & (1U << (bit % 8));
       }
       inline std::size_t GetBitCount(UChar_t data) {
-        std::size_t bitCount = 0UL;
-        for (std::size_t i = 0UL; i < 8UL; ++i) {
-          if (data & (1U << i)) {
-            ++bitCount;
-          }
-        }
-        return bitCount;
+        return __builtin_popcount(data);
       }
 
 #if KC705_FORMAT_VERSION == 1
@@ -300,6 +350,46 @@ namespace Extinction {
 #endif
     }
 
+    // Range over the set bit positions of a hit pattern, lowest channel first
+    class HitChannels {
+    public:
+      class Iterator {
+      private:
+        ULong64_t fBits;
+      public:
+        explicit Iterator(ULong64_t bits) : fBits(bits) { }
+        inline Int_t     operator* () const { return __builtin_ctzll(fBits); }
+        inline Iterator& operator++()       { fBits &= fBits - 1; return *this; }
+        inline Bool_t    operator!=(const Iterator& other) const { return fBits != other.fBits; }
+      };
+
+    private:
+      ULong64_t fBits;
+
+    public:
+      explicit HitChannels(ULong64_t bits) : fBits(bits) { }
+      inline Iterator    begin() const { return Iterator(fBits); }
+      inline Iterator    end  () const { return Iterator(0); }
+      inline Bool_t      empty() const { return !fBits; }
+      inline std::size_t size () const { return __builtin_popcountll(fBits); }
+    };
+
+    // Values of the tree branches of a packet, kept by the decoder until the spill is filled.
+    // mppcs[]/subs[] are not kept, they are filled again from the bits.
+    struct TreeRecord_t {
+      ULong64_t Date;
+      Int_t     Spill;
+      UChar_t   Type;
+      UChar_t   BoardId;
+      ULong64_t MppcBit;
+      UShort_t  SubBit;
+      Bool_t    MrSync;
+      UInt_t    Tdc;
+      UInt_t    Overflow;
+      Int_t     MrSyncCount;
+      Int_t     TdcFromMrSync;
+    };
+
     class Kc705Data : public ITdcDataProvider {
     public:
       ULong64_t Date;
@@ -320,6 +410,7 @@ namespace Extinction {
       Int_t     TdcFromMrSync;
 
       Double_t  TimePerTdc = 5.0 * nsec;
+      Bool_t    StoreHitArrays = true; // fill mppcs[]/subs[], which are redundant with mppc/sub
 
       Kc705Data() {
         Clear();
@@ -408,11 +499,8 @@ namespace Extinction {
         MrSync  = Packet::GetMrSync(packet);
         Tdc     = Packet::GetTdc(packet);
         if (Tdc < lastTdc) { ++Overflow; }
-        for (std::size_t ch = 0; ch < MppcNch; ++ch) {
-          Mppcs[ch] = IsMppcHit(ch);
-        }
-        for (std::size_t ch = 0; ch < SubNch; ++ch) {
-          Subs[ch] = IsSubHit(ch);
+        if (StoreHitArrays) {
+          FillHitArrays();
         }
       }
 
@@ -478,11 +566,8 @@ namespace Extinction {
         } else if (Tdc < lastTdc) {
           ++Overflow;
         }
-        for (std::size_t ch = 0; ch < MppcNch; ++ch) {
-          Mppcs[ch] = IsMppcHit(ch);
-        }
-        for (std::size_t ch = 0; ch < SubNch; ++ch) {
-          Subs[ch] = IsSubHit(ch);
+        if (StoreHitArrays) {
+          FillHitArrays();
         }
       }
 
@@ -577,6 +662,61 @@ namespace Extinction {
         return file;
       }
 
+      Bool_t ReadHeader(RawBuffer& buffer,
+                        Packet_t* packet = nullptr) {
+        UChar_t* buff = buffer.Take(sizeof(Packet_t));
+        if (!buff) {
+          return false;
+        }
+
+        if (packet) {
+          std::memcpy(*packet, buff, sizeof(Packet_t));
+        }
+
+        if (Packet::IsHeader(buff)) {
+          SetDataAsHeader(buff);
+#if   KC705_FORMAT_VERSION == 1
+          // No time stamp
+#elif KC705_FORMAT_VERSION == 2
+          // No time stamp
+#else 
+          UChar_t* date = buffer.Take(sizeof(ULong64_t));
+          if (!date) {
+            return false;
+          }
+          std::memcpy(&Date, date, sizeof(ULong64_t));
+#endif
+        } else if (Type == DataType::HeaderError) {
+          // Nothing to do
+        } else {
+          std::cerr << "[error] invalid header, maybe "
+                    << (Packet::IsFooter(buff) ? "footer" : "data") << std::endl;
+          Type = DataType::HeaderError;
+        }
+
+        return true;
+      }
+
+      Bool_t ReadDataOrFooter(RawBuffer& buffer,
+                              Packet_t* packet = nullptr) {
+        UChar_t* buff = buffer.Take(sizeof(Packet_t));
+        if (!buff) {
+          return false;
+        }
+
+        if (Packet::IsFooter(buff)) {
+          SetDataAsFooter(buff);
+        } else {
+          SetDataAsData(buff);
+        }
+
+        if (packet) {
+          std::memcpy(*packet, buff, sizeof(Packet_t));
+        }
+
+        return true;
+      }
+
       inline virtual Bool_t IsData() const override {
         return Type == DataType::Data;
       }
@@ -612,27 +752,26 @@ namespace Extinction {
       inline Bool_t IsMppcHit(Int_t ch) const {
         return MppcBit & (0x1ULL << ch);
       }
-      inline std::vector<Int_t> GetMppcHitChannels() const {
-        std::vector<Int_t> channels;
-        for (std::size_t ch = 0; ch < MppcNch; ++ch) {
-          if (IsMppcHit(ch)) {
-            channels.push_back(ch);
-          }
-        }
-        return channels;
+      inline HitChannels GetMppcHitChannels() const {
+        return HitChannels(MppcBit);
       }
 
       inline Bool_t IsSubHit(Int_t ch) const {
         return SubBit & (0x1U << ch);
       }
-      inline std::vector<Int_t> GetSubHitChannels() const {
-        std::vector<Int_t> channels;
-        for (std::size_t ch = 0; ch < SubNch; ++ch) {
-          if (IsSubHit(ch)) {
-            channels.push_back(ch);
-          }
+      inline HitChannels GetSubHitChannels() const {
+        return HitChannels(SubBit & ((0x1U << SubNch) - 1));
+      }
+
+      inline void FillHitArrays() {
+        std::memset(Mppcs, 0, MppcNch);
+        std::memset( Subs, 0,  SubNch);
+        for (auto&& ch : GetMppcHitChannels()) {
+          Mppcs[ch] = 1;
+        }
+        for (auto&& ch : GetSubHitChannels()) {
+          Subs[ch] = 1;
         }
-        return channels;
       }
 
       inline Long64_t GetTdc2() const {
@@ -659,36 +798,39 @@ namespace Extinction {
                   << "Tdc = " << Tdc << ", "
                   << "Overflow = " << Overflow << ", "
                   << "MPPC =";
-        std::vector<Int_t> mppcHit = GetMppcHitChannels();
+        const HitChannels mppcHit = GetMppcHitChannels();
         if (mppcHit.empty()) {
           std::cout << " None";
         } else {
-          for (std::size_t i = 0, n = mppcHit.size(); i < n; ++i) {
-            std::cout << " " << mppcHit[i];
+          for (auto&& ch : mppcHit) {
+            std::cout << " " << ch;
           }
         }
         std::cout << ", Sub =";
-        std::vector<Int_t> subHit = GetSubHitChannels();
+        const HitChannels subHit = GetSubHitChannels();
         if (subHit.empty()) {
           std::cout << " None";
         } else {
-          for (std::size_t i = 0, n = subHit.size(); i < n; ++i) {
-            std::cout << " " << subHit[i];
+          for (auto&& ch : subHit) {
+            std::cout << " " << ch;
           }
         }
         std::cout << ", MrSync = " << (MrSync ? "true" : "false") << std::endl;
       }
 
       inline virtual std::vector<TdcData> GetTdcData(Int_t board) const override {
-        using namespace ChannelMapWithBoard;
-        namespace CM = ChannelMapWithBoard;
         std::vector<TdcData> data;
+        AppendTdcData(board, data);
+        return data;
+      }
+
+      inline virtual void AppendTdcData(Int_t board, std::vector<TdcData>& data) const override {
+        const ChannelMapWithBoard::Lookup_t* lookup = ChannelMapWithBoard::FindLookup(board);
         const Long64_t tdc  = GetTdc2();
         const Double_t time = GetTime();
-        typename decltype(CM::MrSync  )::const_iterator itr1;
-        typename decltype(itr1->second)::const_iterator itr2;
         for (auto&& mppcCh : GetMppcHitChannels()) {
-          TdcData datum;
+          data.emplace_back();
+          TdcData& datum = data.back();
           datum.Date            = Date;
           datum.Spill           = Spill;
           datum.EMCount         = EMCount;
@@ -701,18 +843,16 @@ namespace Extinction {
           datum.LastMrSyncTdc   = MrSyncTdc;
           datum.NextMrSyncTdc   = 0;
           datum.TdcFromMrSync   = TdcFromMrSync;
-          if        ((itr1 = CM::MrSync  .find(board )) != CM::MrSync  .end() &&
-                     (itr2 = itr1->second.begin()     ) != itr1->second.end()) {
-            datum.MrSyncChannel = itr2->second + MrSync            ::GlobalChannelOffset;
+          if (lookup && lookup->MrSyncChannel >= 0) {
+            datum.MrSyncChannel = lookup->MrSyncChannel;
           }
-          if        ((itr1 = ExtMppc     .find(board )) != ExtMppc     .end() &&
-                     (itr2 = itr1->second.find(mppcCh)) != itr1->second.end()) {
-            datum.Channel       = itr2->second + ExtinctionDetector::GlobalChannelOffset;
+          if (lookup && lookup->Channels[mppcCh] >= 0) {
+            datum.Channel       = lookup->Channels[mppcCh];
           }
-          data.push_back(datum);
         }
         for (auto&& subCh : GetSubHitChannels()) {
-          TdcData datum;
+          data.emplace_back();
+          TdcData& datum = data.back();
           datum.Date            = Date;
           datum.Spill           = Spill;
           datum.EMCount         = EMCount;
@@ -725,27 +865,16 @@ namespace Extinction {
           datum.LastMrSyncTdc   = MrSyncTdc;
           datum.NextMrSyncTdc   = 0;
           datum.TdcFromMrSync   = TdcFromMrSync;
-          if        ((itr1 = CM::MrSync  .find(board)) != CM::MrSync  .end() &&
-                     (itr2 = itr1->second.begin()    ) != itr1->second.end()) {
-            datum.MrSyncChannel = itr2->second + MrSync            ::GlobalChannelOffset;
+          if (lookup && lookup->MrSyncChannel >= 0) {
+            datum.MrSyncChannel = lookup->MrSyncChannel;
           }
-          if        ((itr1 = ExtSub      .find(board)) != ExtSub      .end() &&
-                     (itr2 = itr1->second.find(subCh)) != itr1->second.end()) {
-            datum.Channel       = itr2->second + ExtinctionDetector::GlobalChannelOffset;
-          } else if ((itr1 = Hod         .find(board)) != Hod         .end() &&
-                     (itr2 = itr1->second.find(subCh)) != itr1->second.end()) {
-            datum.Channel       = itr2->second + Hodoscope         ::GlobalChannelOffset;
-          } else if ((itr1 = Tc          .find(board)) != Tc          .end() &&
-                     (itr2 = itr1->second.find(subCh)) != itr1->second.end()) {
-            datum.Channel       = itr2->second + TimingCounter     ::GlobalChannelOffset;
-          } else if ((itr1 = Bh          .find(board)) != Bh          .end() &&
-                     (itr2 = itr1->second.find(subCh)) != itr1->second.end()) {
-            datum.Channel       = itr2->second + BeamlineHodoscope ::GlobalChannelOffset;
+          if (lookup && lookup->Channels[MppcNch + subCh] >= 0) {
+            datum.Channel       = lookup->Channels[MppcNch + subCh];
           }
-          data.push_back(datum);
         }
         if (MrSync) {
-          TdcData datum;
+          data.emplace_back();
+          TdcData& datum = data.back();
           datum.Date            = Date;
           datum.Spill           = Spill;
           datum.EMCount         = EMCount;
@@ -758,13 +887,10 @@ namespace Extinction {
           datum.LastMrSyncTdc   = MrSyncTdc;
           datum.NextMrSyncTdc   = 0;
           datum.TdcFromMrSync   = TdcFromMrSync;
-          if ((itr1 = CM::MrSync  .find(board)) != CM::MrSync  .end() &&
-              (itr2 = itr1->second.begin()    ) != itr1->second.end()) {
-            datum.Channel       = itr2->second + MrSync            ::GlobalChannelOffset;
+          if (lookup && lookup->MrSyncChannel >= 0) {
+            datum.Channel       = lookup->MrSyncChannel;
           }
-          data.push_back(datum);
         }
-        return data;
       }
 
       inline virtual Int_t FindBoard(Int_t globalChannel) const override {
@@ -784,8 +910,10 @@ namespace Extinction {
         tree->Branch("mppc"    , &MppcBit      , "mppc"    "/l");
         tree->Branch("sub"     , &SubBit       , "sub"     "/s");
         tree->Branch("mrSync"  , &MrSync       , "MrSync"  "/O");
-        tree->Branch("mppcs"   ,  Mppcs        , Form("mppcs[%lu]" "/b", MppcNch));
-        tree->Branch("subs"    ,  Subs         , Form("subs [%lu]" "/b", SubNch));
+        if (StoreHitArrays) {
+          tree->Branch("mppcs" ,  Mppcs        , Form("mppcs[%lu]" "/b", MppcNch));
+          tree->Branch("subs"  ,  Subs         , Form("subs [%lu]" "/b", SubNch));
+        }
         tree->Branch("tdc"     , &Tdc          , "tdc"     "/i");
         tree->Branch("overflow", &Overflow     , "overflow""/i");
         tree->Branch("mscount" , &MrSyncCount  , "mscount" "/I");
@@ -793,6 +921,25 @@ namespace Extinction {
         tree->Branch("dtdc"    , &TdcFromMrSync, "dtdc"    "/I");
         tree->SetAlias("tdc2", "tdc + 0x8000000 * overflow");
       }
+      inline TreeRecord_t GetTreeRecord() const {
+        return { Date, Spill, Type, BoardId, MppcBit, SubBit, MrSync, Tdc, Overflow, MrSyncCount, TdcFromMrSync };
+      }
+      inline void SetTreeRecord(const TreeRecord_t& record) {
+        Date          = record.Date;
+        Spill         = record.Spill;
+        Type          = record.Type;
+        BoardId       = record.BoardId;
+        MppcBit       = record.MppcBit;
+        SubBit        = record.SubBit;
+        MrSync        = record.MrSync;
+        Tdc           = record.Tdc;
+        Overflow      = record.Overflow;
+        MrSyncCount   = record.MrSyncCount;
+        TdcFromMrSync = record.TdcFromMrSync;
+        if (StoreHitArrays) {
+          FillHitArrays();
+        }
+      }
       inline TBranch* AddEMBranch(TTree* tree) {
         return tree->Branch("emcount", &EMCount, "emcount/I");
       }
@@ -811,8 +958,10 @@ namespace Extinction {
         tree->SetBranchAddress("mppc"    , &MppcBit      );
         tree->SetBranchAddress("sub"     , &SubBit       );
         tree->SetBranchAddress("mrSync"  , &MrSync       );
-        tree->SetBranchAddress("mppcs"   ,  Mppcs        );
-        tree->SetBranchAddress("subs"    ,  Subs         );
+        if (tree->GetBranch("mppcs")) {
+          tree->SetBranchAddress("mppcs" ,  Mppcs        );
+          tree->SetBranchAddress("subs"  ,  Subs         );
+        }
         tree->SetBranchAddress("tdc"     , &Tdc          );
         tree->SetBranchAddress("overflow", &Overflow     );
         tree->SetBranchAddress("mscount" , &MrSyncCount  );
@@ -980,6 +1129,20 @@ namespace Extinction {
         return Decode(file);
       }
 
+      std::size_t Decode(RawBuffer& buffer) {
+        std::size_t count = 0UL;
+        if (!Tree) {
+          std::cerr << "[warning] tree has not initialized yet" << std::endl;
+        } else {
+          for (; Read(buffer); ++count) {
+            if (Data.IsData() || Data.IsFooter()) {
+              Tree->Fill();
+            }
+          }
+        }
+        return count;
+      }
+
       inline std::basic_istream<char>& Read(std::basic_istream<char>& file,
                                             Packet_t* packet = nullptr) {
         switch (Data.Type) {
@@ -997,6 +1160,23 @@ namespace Extinction {
         }
       }
 
+      inline Bool_t Read(RawBuffer& buffer,
+                         Packet_t* packet = nullptr) {
+        switch (Data.Type) {
+        case DataType::None:
+        case DataType::HeaderError:
+        case DataType::Footer:
+          return Data.ReadHeader(buffer, packet);
+        case DataType::Header:
+        case DataType::Data:
+        case DataType::DataError:
+          return Data.ReadDataOrFooter(buffer, packet);
+        default:
+          std::cerr << "[error] invalid data type" << std::endl;
+          exit(1);
+        }
+      }
+
     };
 
   }
@@ -0,0 +1,466 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <stdlib.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <time.h>
+#include <signal.h>
+#include <errno.h>
+#include <vector>
+#include <map>
+#include <thread>
+#include <chrono>
+#include "ArgReader.hh"
+#include "Daq.hh"
+
+// Capture of several KC705 boards in one process. Board sockets are multiplexed with epoll on this thread,
+// and one writer thread writes per-board files. Every board rotates its file after the spill whose hardware
+// spill number (in the header) is the last of a block of nofSpills, so the n-th files of all boards hold
+// the same spills even if a board was started late. A mismatch of the spill numbers is warned.
+
+// Buffer size, multiple of UNITSIZE
+constexpr int BUFFERSIZE = 1024 * 1024 / UNITSIZE * UNITSIZE;
+
+volatile sig_atomic_t stopped = 0;
+void interrupt(int) {
+  stopped = 1;
+}
+
+struct board_t {
+  std::string  ipAddress;
+  unsigned int tcpPort    = 0;
+
+  // Socket side
+  int          sock       = -1;
+  buffer_t*    buffer     = nullptr; // being filled
+  int          scanned    = 0;
+  long long    ievent     = 0;
+  long long    ispill     = 0;
+  long long    hwSpill    = -1;      // hardware spill number of the last header, -1 before the first
+  long long    irotate    = 0;       // # of rotations on the socket side
+  long long    recvLength = 0;
+  long long    lastLength = 0;       // recvLength at the last report
+
+  // Writer side
+  FILE*        fout       = nullptr;
+  std::string  foutname;
+  long long    ifile      = 0;
+  long long    fileLength = 0;       // bytes written to the current file
+  long long    spillBegin = 0;       // offset of the current spill in the current file
+  Extinction::SpillIndex spillIndex;
+};
+
+inline std::string filename(const std::string& dir, std::size_t board, long long ifile) {
+  char fname[128];
+  sprintf(fname, "kc705_%02lu_%012lld.dat", (unsigned long)board, ifile);
+  return dir + fname;
+}
+
+int main(int argc, char** argv){
+  const std::string AppName = "capture";
+
+  // Load Arguments
+  Tron::ArgReader* args = new Tron::ArgReader(AppName);
+  args->AddArgs<std::string>("Boards"       ,                   "Board addresses, <IP address>:<TCP port #>");
+  args->AddOpt<Long64_t>   ("NofEvents"     , 'n', "number"   , "Set # of events of each board in a run, 0 for no limit", "0");
+  args->AddOpt<Long64_t>   ("NofSpills"     , 's', "spill"    , "Set # of spills in a file", "100");
+  args->AddOpt<Int_t>      ("NofBuffers"    , 'b', "buffers"  , "Set # of buffers of each board", "16");
+  args->AddOpt<std::string>("Directory"     , 'd', "directory", "Set output directory for raw files" , "");
+  args->AddOpt             ("Move"          , 'm', "move"     , "move file to forward directory");
+  args->AddOpt             ("Compress"      , 'c', "compress" , "compress and move file to forward directory");
+  args->AddOpt<std::string>("ForwardDir"    , 'f', "forward"  , "Set forward directory", ".");
+  args->AddOpt<Int_t>      ("NofWorkers"    , 'w', "workers"  , "Set # of move/compress threads", "2");
+  args->AddOpt             ("Index"         , 'x', "index"    , "Write spill index of raw files");
+  args->AddOpt<Int_t>      ("Interval"      , 'i', "interval" , "Set interval of throughput report [sec]", "10");
+  args->AddOpt             ("Help"          , 'h', "help"     , "Help");
+
+  if (!args->Parse(argc, argv) || args->IsSet("Help") || args->HasUnsetRequired()) {
+    args->ShowUsage();
+    return 0;
+  }
+
+  const std::vector<std::string> addresses = args->GetValues("Boards");
+  const long long    nofEvents   = args->GetValue<long long>("NofEvents");
+  const long long    nofSpills   = args->GetValue<long long>("NofSpills");
+  const int          nofBuffers  = args->GetValue<int>("NofBuffers");
+  const std::string  directory   = args->GetValue("Directory");
+  const bool         move        = args->IsSet("Move");
+  const bool         compress    = args->IsSet("Compress");
+  const std::string  forwardDir  = args->GetValue("ForwardDir");
+  const int          nofWorkers  = args->GetValue<int>("NofWorkers");
+  const bool         indexed     = args->IsSet("Index");
+  const int          interval    = args->GetValue<int>("Interval");
+  archiver_t::mode_t archiveMode = archiver_t::None;
+
+  const std::size_t nofBoards = addresses.size();
+  std::vector<board_t> boards(nofBoards);
+  for (std::size_t i = 0; i < nofBoards; ++i) {
+    const std::size_t pos = addresses[i].rfind(':');
+    if (pos == std::string::npos) {
+      std::cout << "[error] invalid board address, " << addresses[i] << std::endl;
+      exit(1);
+    }
+    boards[i].ipAddress = addresses[i].substr(0, pos);
+    boards[i].tcpPort   = std::strtoul(addresses[i].data() + pos + 1, nullptr, 10);
+    std::cout << "Board " << i << ": " << boards[i].ipAddress << ":" << boards[i].tcpPort << std::endl;
+  }
+  std::cout << "Set # of events: " << nofEvents << std::endl;
+  std::cout << "Set # of spills: " << nofSpills << std::endl;
+  std::cout << "Set # of buffers: " << nofBoards << " x " << nofBuffers << " x " << BUFFERSIZE << " bytes" << std::endl;
+  if (nofSpills <= 0) {
+    std::cout << "[error] invalid # of spills" << std::endl;
+    exit(1);
+  }
+  if (nofBuffers < 2) {
+    std::cout << "[error] invalid # of buffers" << std::endl;
+    exit(1);
+  }
+  std::cout << "Set output directory: \"" << directory << "\"" << std::endl;
+  if (move) {
+    std::cout << "Set move" << std::endl;
+    archiveMode = archiver_t::Move;
+  } else if (compress) {
+    std::cout << "Set compress" << std::endl;
+    archiveMode = archiver_t::Compress;
+  } else {
+    std::cout << "Set no move and no compress" << std::endl;
+    archiveMode = archiver_t::None;
+  }
+  std::cout << "Set forward directory: \"" << forwardDir << "\"" << std::endl;
+  if (archiveMode != archiver_t::None) {
+    std::cout << "Set # of workers: " << nofWorkers << std::endl;
+    if (nofWorkers < 1) {
+      std::cout << "[error] invalid # of workers" << std::endl;
+      exit(1);
+    }
+  }
+  if (indexed) {
+    std::cout << "Set spill index" << std::endl;
+  }
+  std::cout << "Set report interval: " << interval << " sec" << std::endl;
+  archiver_t archiver(archiveMode, forwardDir, nofWorkers);
+
+  // Connect to boards
+  std::cout << std::endl
+            << "Create epoll..." << std::endl;
+  const int epfd = epoll_create1(0);
+  if (epfd < 0) {
+    std::cerr << "[error] epoll_create1() failed" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  for (std::size_t i = 0; i < nofBoards; ++i) {
+    board_t& board = boards[i];
+    board.sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    sockaddr_in sitcpAddr;
+    sitcpAddr.sin_family      = AF_INET;
+    sitcpAddr.sin_port        = htons(board.tcpPort);
+    sitcpAddr.sin_addr.s_addr = inet_addr(board.ipAddress.data());
+
+    std::cout << "connecting board " << i << "..." << std::endl;
+    if (connect(board.sock, (sockaddr*)&sitcpAddr, sizeof(sitcpAddr)) < 0) {
+      std::cerr << "[error] connect() failed, board " << i << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    fcntl(board.sock, F_SETFL, fcntl(board.sock, F_GETFL) | O_NONBLOCK);
+
+    epoll_event event;
+    event.events   = EPOLLIN;
+    event.data.u64 = i;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, board.sock, &event) < 0) {
+      std::cerr << "[error] epoll_ctl() failed, board " << i << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  std::cout << "connection succeded" << std::endl;
+
+  std::cout << "Set signal" << std::endl;
+  if (signal(SIGINT, interrupt) == SIG_ERR) {
+    std::cerr << "error signal" << std::endl;
+  }
+
+  std::cout << "Define daq variables" << std::endl;
+  const long long          evlimit = nofEvents > 0 ? nofEvents : std::numeric_limits<long long>::max();
+  const std::size_t        nofAll  = nofBoards * nofBuffers;
+  std::vector<unsigned char> pool(nofAll * BUFFERSIZE);
+  std::vector<buffer_t>      buffers(nofAll);
+  spsc_queue_t<buffer_t*>    freeQueue  (nofAll);
+  spsc_queue_t<buffer_t*>    filledQueue(nofAll);
+  for (std::size_t i = 0; i < nofAll; ++i) {
+    buffers[i].data = pool.data() + i * BUFFERSIZE;
+    freeQueue.push(&buffers[i]);
+  }
+
+  // Counters
+  std::size_t maxQueueDepth = 0;
+  long long   nofStalls     = 0;
+  long long   maxStall      = 0; // [usec]
+  long long   maxWrite      = 0; // [usec]
+
+  std::cout << "Start daq" << std::endl;
+  time_t t_start = time(nullptr);
+  const auto start = std::chrono::steady_clock::now();
+
+  std::thread writer([&] {
+      std::size_t nofFinished = 0;
+      for (buffer_t* buffer = nullptr; nofFinished < nofBoards;) {
+        if (!filledQueue.pop(buffer)) {
+          usleep(100);
+          continue;
+        }
+        board_t& board = boards[buffer->board];
+
+        // Open file at the first data, a rotation does not leave an empty file behind
+        if (!board.fout && buffer->length) {
+          board.foutname   = filename(directory, buffer->board, board.ifile);
+          board.fileLength = 0;
+          board.spillBegin = 0;
+          std::cout << "File Open: " << board.foutname << std::endl;
+          if ((board.fout = fopen(board.foutname.data(), "wb")) == nullptr) {
+            std::cerr << "[error] output file was not opened, " << board.foutname << std::endl;
+            archiver.finish();
+            exit(1);
+          }
+          if (indexed && !board.spillIndex.Open(Extinction::SpillIndex::GetFilename(board.foutname))) {
+            archiver.finish();
+            exit(1);
+          }
+        }
+
+        if (board.fout) {
+          const auto writeStart = std::chrono::steady_clock::now();
+          fwrite(buffer->data, sizeof(char), buffer->length, board.fout);
+          maxWrite = std::max(maxWrite, elapsedUsec(writeStart));
+
+          for (auto&& entry : buffer->spills) {
+            // The spill runs from the end of the previous footer to the end of its footer
+            entry.FooterOffset += board.fileLength;
+            entry.HeaderOffset  = board.spillBegin;
+            board.spillBegin    = entry.FooterOffset;
+            board.spillIndex.Write(entry);
+          }
+          board.fileLength += buffer->length;
+
+          if (buffer->rotate || buffer->last) {
+            fclose(board.fout);
+            board.fout = nullptr;
+
+            // Compress and move output file
+            archiver.push(board.foutname);
+            if (board.spillIndex.IsOpen()) {
+              board.spillIndex.Close();
+              archiver.push(Extinction::SpillIndex::GetFilename(board.foutname), true);
+            }
+          }
+        }
+        if (buffer->rotate) {
+          ++board.ifile;
+        }
+
+        if (buffer->last) {
+          ++nofFinished;
+        }
+        freeQueue.push(buffer);
+      }
+    });
+
+  auto acquire =
+    [&](std::size_t i) {
+      buffer_t* buffer = nullptr;
+      if (!freeQueue.pop(buffer)) {
+        ++nofStalls;
+        const auto stallStart = std::chrono::steady_clock::now();
+        while (!freeQueue.pop(buffer)) {
+          usleep(10);
+        }
+        maxStall = std::max(maxStall, elapsedUsec(stallStart));
+      }
+      buffer->length = 0;
+      buffer->rotate = false;
+      buffer->last   = false;
+      buffer->board  = i;
+      buffer->spills.clear();
+      return buffer;
+    };
+  auto submit =
+    [&](buffer_t* buffer) {
+      filledQueue.push(buffer);
+      maxQueueDepth = std::max(maxQueueDepth, filledQueue.size());
+    };
+  auto finish =
+    [&](board_t& board) {
+      epoll_ctl(epfd, EPOLL_CTL_DEL, board.sock, nullptr);
+      close(board.sock);
+      board.sock = -1;
+      board.buffer->last = true;
+      submit(board.buffer);
+      board.buffer = nullptr;
+    };
+
+  auto report =
+    [&](double elapsed) {
+      long long minSpill = std::numeric_limits<long long>::max();
+      long long maxSpill = 0;
+      for (std::size_t i = 0; i < nofBoards; ++i) {
+        board_t& board = boards[i];
+        std::cout << "Board " << i << ": "
+                  << (board.recvLength - board.lastLength) / elapsed / 1e6 << " MB/s, "
+                  << board.ispill << " spills, " << board.ievent << " events"
+                  << (board.sock < 0 ? " (closed)" : "") << std::endl;
+        board.lastLength = board.recvLength;
+        if (board.sock >= 0) {
+          minSpill = std::min(minSpill, board.ispill);
+          maxSpill = std::max(maxSpill, board.ispill);
+        }
+      }
+      if (minSpill <= maxSpill && maxSpill > minSpill + 1) {
+        std::cout << "[warning] boards are out of step by " << maxSpill - minSpill << " spills" << std::endl;
+      }
+    };
+
+  for (std::size_t i = 0; i < nofBoards; ++i) {
+    boards[i].buffer = acquire(i);
+  }
+
+  // Hardware spill number at which each file was rotated by the first board, to check the others
+  std::map<long long, long long> rotateSpills;
+  auto rotates =
+    [&](std::size_t i) {
+      board_t& board = boards[i];
+      if (board.hwSpill < 0) {
+        // No header seen, fall back to the spill count
+        return board.ispill % nofSpills == 0;
+      }
+      if ((board.hwSpill + 1) % nofSpills) {
+        return false;
+      }
+      const auto inserted = rotateSpills.emplace(board.irotate, board.hwSpill);
+      if (!inserted.second && inserted.first->second != board.hwSpill) {
+        std::cout << "[warning] board " << i << " rotates file " << board.irotate
+                  << " at spill " << board.hwSpill << ", others at spill " << inserted.first->second << std::endl;
+      }
+      return true;
+    };
+
+  // Level triggered, one read per ready board and round, so a busy board does not starve others
+  std::size_t nofOpen    = nofBoards;
+  auto        lastReport = std::chrono::steady_clock::now();
+  std::vector<epoll_event> events(nofBoards);
+  while (nofOpen && !stopped) {
+    const int n = epoll_wait(epfd, events.data(), events.size(), 100);
+    if (n < 0 && errno != EINTR) {
+      std::cerr << "[error] epoll_wait() failed" << std::endl;
+      break;
+    }
+
+    for (int k = 0; k < n; ++k) {
+      const std::size_t i      = events[k].data.u64;
+      board_t&          board  = boards[i];
+      buffer_t*         buffer = board.buffer;
+
+      const ssize_t recvLength = recv(board.sock, buffer->data + buffer->length, BUFFERSIZE - buffer->length, 0);
+      if (recvLength < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        continue;
+      } else if (recvLength <= 0) {
+        std::cerr << "[info] connection closed, board " << i << std::endl;
+        finish(board);
+        --nofOpen;
+        continue;
+      }
+      board.recvLength += recvLength;
+      buffer->length   += recvLength;
+
+      for (; board.scanned + UNITSIZE <= buffer->length; board.scanned += UNITSIZE) {
+        ++board.ievent;
+        const int type = GetDataType(buffer->data + board.scanned);
+        if (type == DataType::Header) {
+          board.hwSpill = ((header_t*)(buffer->data + board.scanned))->GetSpill();
+          continue;
+        } else if (type != DataType::Footer) {
+          continue;
+        }
+        ++board.ispill;
+        if (indexed) {
+          Extinction::SpillIndexEntry_t entry;
+          entry.FooterOffset = board.scanned + UNITSIZE;
+          entry.Spill        = board.ispill - 1;
+          entry.Date         = time(nullptr);
+          buffer->spills.push_back(entry);
+        }
+        if (rotates(i)) {
+          ++board.irotate;
+          // Hand over data until the footer, and carry the rest to the next buffer
+          const int end   = board.scanned + UNITSIZE;
+          buffer_t* next  = acquire(i);
+          next->length    = buffer->length - end;
+          std::memcpy(next->data, buffer->data + end, next->length);
+          buffer->length  = end;
+          buffer->rotate  = true;
+          submit(buffer);
+          buffer        = next;
+          board.buffer  = next;
+          board.scanned = -UNITSIZE;
+        }
+      }
+
+      if (buffer->length == BUFFERSIZE) {
+        submit(buffer);
+        board.buffer  = acquire(i);
+        board.scanned = 0;
+      }
+
+      if (board.ievent > evlimit) {
+        finish(board);
+        --nofOpen;
+      }
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastReport).count();
+    if (interval > 0 && elapsed >= interval) {
+      report(elapsed);
+      lastReport = std::chrono::steady_clock::now();
+    }
+  }
+  if (stopped) {
+    puts("Detect ctrl+c");
+  }
+
+  // Finish daq
+  for (auto&& board : boards) {
+    if (board.sock >= 0) {
+      finish(board);
+    }
+  }
+  writer.join();
+  close(epfd);
+  time_t t_stop = time(nullptr);
+  std::cout << std::endl
+            << "Finished" << std::endl;
+
+  // Average over the run
+  for (auto&& board : boards) {
+    board.lastLength = 0;
+  }
+  report(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  std::cout << "Async writer: max queue depth " << maxQueueDepth << " / " << nofAll
+            << ", " << nofStalls << " stalls (max " << maxStall << " usec)"
+            << ", max write " << maxWrite << " usec" << std::endl;
+
+  // Wait for move and compression
+  std::cout << "Wait for archiver" << std::endl;
+  archiver.finish();
+
+  // Verbose daq time
+  const int t_diff = t_stop - t_start;
+  std::cout << "DAQ time  " << t_stop << " - " << t_start << " = " << t_diff << " sec" << std::endl;
+
+  return 0;
+}
@@ -2,6 +2,7 @@
 #include <fstream>
 #include <string>
 #include "Kc705.hh"
+#include "RawFileStream.hh"
 #include "ArgReader.hh"
 
 Int_t main(Int_t argc, Char_t** argv) {
@@ -30,7 +31,7 @@ Int_t main(Int_t argc, Char_t** argv) {
   const std::size_t amount          = args->GetValue<std::size_t>("Amount");
 
   std::cout << "=== Open Input File" << std::endl;
-  std::ifstream ifile(ifilename, std::ios::binary);
+  Extinction::RawFileStream ifile(ifilename);
   if (!ifile) {
     std::cout << "[error] input file is not opened, " << ifilename << std::endl;
     return 1;
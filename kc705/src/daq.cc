@@ -14,11 +14,19 @@
 #include <sys/time.h>
 #include <signal.h>
 #include <errno.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
 #include "ArgReader.hh"
+#include "Daq.hh"
+#include "ShmRing.hh"
 
 constexpr unsigned int BUFSIZE  = 256000;
 constexpr int          THRESIZE = BUFSIZE * 3 / 4;
-constexpr int          UNITSIZE = 13;
+
+// Buffer size for pattern 3 (asynchronous writer), multiple of UNITSIZE
+constexpr int          ASYNCSIZE = 4 * 1024 * 1024 / UNITSIZE * UNITSIZE;
 
 // int comSignal = 1;
 long long evlimit = 0;
@@ -28,76 +36,17 @@ void alarm(int) {
   evlimit = 0;
 }
 
-struct footer_t {
-  unsigned int  hoge0;
-  unsigned char hoge1;
-  unsigned int  magicWord0;
-  unsigned int  magicWord1;
-  inline bool IsFooter() const {
-    static const unsigned int footerWord = htonl(0xAAAAAAAA);
-    return magicWord0 == footerWord;
-  }
-} __attribute__((__packed__));
-
-struct header_t {
-  unsigned int  magicWord0;
-  unsigned int  magicWord1;
-  unsigned int  hoge0;
-  unsigned char hoge1;
-  inline bool IsHeader() const {
-    static const unsigned int headerWord = htonl(0x34567012);
-    return magicWord1 == headerWord;
-  }
-} __attribute__((__packed__));
-
-struct DataType {
-  enum {
-        Header = -1,
-        Data   =  0,
-        Footer =  1,
-  };
-};
-
-inline int GetDataType(unsigned char* rcvdBuffer) {
-  if     (((header_t*)rcvdBuffer)->IsHeader()) return DataType::Header;
-  else if(((footer_t*)rcvdBuffer)->IsFooter()) return DataType::Footer;
-  return DataType::Data;
-}
-
 inline const char* filename(const std::string* dir) {
   static char fname[128];
   static long count = 0;
   sprintf(fname, "kc705_%012ld.dat", count++);
   static std::stringstream stream;
+  static std::string       name;
   stream.str(*dir);
+  stream.seekp(0, std::ios_base::end);
   stream << fname;
-  return stream.str().data();
-}
-
-inline const char* commandNull(const std::string* , const std::string*) {
-  return nullptr;
-}
-
-inline const char* commandMove(const std::string* fname, const std::string* dir) {
-  static std::string cmd(256, ' ');
-  cmd = "mv ";
-  cmd += *fname;
-  cmd += " ";
-  cmd += *dir;
-  cmd += " &";
-  return cmd.data();
-}
-
-inline const char* commandCompress(const std::string* fname, const std::string* dir) {
-  static std::string cmd(256, ' ');
-  cmd = "tar -czf ";
-  cmd += *dir;
-  cmd += "/";
-  cmd += *fname;
-  cmd += ".tar.gz --remove-files ";
-  cmd += *fname;
-  cmd += " &";
-  return cmd.data();
+  name = stream.str();
+  return name.data();
 }
 
 // for Debug
@@ -130,10 +79,15 @@ int main(int argc, char** argv){
   args->AddOpt<Long64_t>   ("NofSpills"     , 's', "spill"    , "Set # of spills in a file", "100");
   args->AddOpt<Int_t>      ("Pattern"       , 'p', "pattern"  , "Set daq pattern"          , "1");
   args->AddOpt<Int_t>      ("ReadSize"      , 'r', "readsize" , "Set read size [bytes]"    , "2600");
+  args->AddOpt<Int_t>      ("NofBuffers"    , 'b', "buffers"  , "Set # of buffers for pattern 3", "16");
   args->AddOpt<std::string>("Directory"     , 'd', "directory", "Set output directory for raw files" , "");
   args->AddOpt             ("Move"          , 'm', "move"     , "move file to forward directory");
   args->AddOpt             ("Compress"      , 'c', "compress" , "compress and move file to forward directory");
   args->AddOpt<std::string>("ForwardDir"    , 'f', "forward"  , "Set forward directory", ".");
+  args->AddOpt<Int_t>      ("NofWorkers"    , 'w', "workers"  , "Set # of move/compress threads", "2");
+  args->AddOpt             ("Index"         , 'x', "index"    , "Write spill index of raw files for pattern 2, 3");
+  args->AddOpt<std::string>("Tap"           , 't', "tap"      , "Publish raw data to shared memory of the name for monitors", "");
+  args->AddOpt<Int_t>      ("TapSize"       , 'T', "tapsize"  , "Set size of the shared memory [MB]", "64");
   args->AddOpt             ("Help"          , 'h', "help"     , "Help");
 
   if (!args->Parse(argc, argv) || args->IsSet("Help") || args->HasUnsetRequired()) {
@@ -147,11 +101,16 @@ int main(int argc, char** argv){
   const long long    nofSpills   = args->GetValue<long long>("NofSpills");
   const int          pattern     = args->GetValue<int>("Pattern");
   const int          readSize    = args->GetValue<int>("ReadSize");
+  const int          nofBuffers  = args->GetValue<int>("NofBuffers");
   const std::string  directory   = args->GetValue("Directory");
   const bool         move        = args->IsSet("Move");
   const bool         compress    = args->IsSet("Compress");
   const std::string  forwardDir  = args->GetValue("ForwardDir");
-  const char* (*command)(const std::string*,const std::string*) = nullptr;
+  const int          nofWorkers  = args->GetValue<int>("NofWorkers");
+  const bool         index       = args->IsSet("Index");
+  const std::string  tapName     = args->GetValue("Tap");
+  const int          tapSize     = args->GetValue<int>("TapSize");
+  archiver_t::mode_t archiveMode = archiver_t::None;
   
   std::cout << "IP Address: " << ipAddress << std::endl;
   std::cout << "TCP Port: " << tcpPort << std::endl;
@@ -163,18 +122,52 @@ int main(int argc, char** argv){
     std::cout << "[error] invalid read size" << std::endl;
     exit(1);
   }
+  if (pattern == 3) {
+    std::cout << "Set # of buffers: " << nofBuffers << " x " << ASYNCSIZE << " bytes" << std::endl;
+    if (nofBuffers < 2) {
+      std::cout << "[error] invalid # of buffers" << std::endl;
+      exit(1);
+    }
+  }
   std::cout << "Set output directory: \"" << directory << "\"" << std::endl;
   if (move) {
     std::cout << "Set move" << std::endl;
-    command = commandMove;
+    archiveMode = archiver_t::Move;
   } else if (compress) {
     std::cout << "Set compress" << std::endl;
-    command = commandCompress;
+    archiveMode = archiver_t::Compress;
   } else {
     std::cout << "Set no move and no compress" << std::endl;
-    command = commandNull;
+    archiveMode = archiver_t::None;
   }
   std::cout << "Set forward directory: \"" << forwardDir << "\"" << std::endl;
+  if (archiveMode != archiver_t::None) {
+    std::cout << "Set # of workers: " << nofWorkers << std::endl;
+    if (nofWorkers < 1) {
+      std::cout << "[error] invalid # of workers" << std::endl;
+      exit(1);
+    }
+  }
+  if (index) {
+    std::cout << "Set spill index" << std::endl;
+    if (pattern != 2 && pattern != 3) {
+      std::cout << "[warning] spill index is not supported in pattern " << pattern << std::endl;
+    }
+  }
+  if (!tapName.empty()) {
+    std::cout << "Set tap: \"" << tapName << "\", " << tapSize << " MB" << std::endl;
+    if (tapSize <= 0) {
+      std::cout << "[error] invalid tap size" << std::endl;
+      exit(1);
+    }
+  }
+  archiver_t archiver(archiveMode, forwardDir, nofWorkers);
+
+  // Shared memory tap, monitors read received data from here without touching files
+  Extinction::ShmRingWriter tap;
+  if (!tapName.empty() && !tap.Open(tapName, (std::size_t)tapSize * 1024 * 1024, UNITSIZE)) {
+    exit(1);
+  }
   
   // create a socket
   std::cout << std::endl
@@ -191,6 +184,7 @@ int main(int argc, char** argv){
   if (connect(sock, (sockaddr*)&sitcpAddr, sizeof(sitcpAddr)) < 0) {
     puts("Connect() faild");
     close(sock);
+    tap.Close();
     exit(EXIT_FAILURE);
   }
   std::cout << "connection succeded" << std::endl;
@@ -209,8 +203,9 @@ int main(int argc, char** argv){
   int            writeEnd      = 0;
   long long      ievent        = 0;
   long long      ispill        = 0;
-  const char*    cmd           = nullptr;
-  
+  long long      fileLength    = 0; // bytes written to the current file
+  long long      spillBegin    = 0; // offset of the current spill in the current file
+
   std::cout << "Open output file" << std::endl;
   FILE* fout;
   std::string foutname;
@@ -220,10 +215,49 @@ int main(int argc, char** argv){
     if ((fout = fopen(foutname.data(), "wb")) == nullptr) {
       std::cerr << "Can't open " << foutname << std::endl; 
       close(sock);
+      tap.Close();
       exit(1);
     }
   }
 
+  // Spill index of the current file, rotated with the file
+  Extinction::SpillIndex spillIndex;
+  const bool             indexed = index && (pattern == 2 || pattern == 3);
+  auto openIndex =
+    [&]() {
+      fileLength = 0;
+      spillBegin = 0;
+      if (indexed && !spillIndex.Open(Extinction::SpillIndex::GetFilename(foutname))) {
+        close(sock);
+        tap.Close();
+        archiver.finish();
+        exit(1);
+      }
+    };
+  auto closeIndex =
+    [&]() {
+      if (spillIndex.IsOpen()) {
+        spillIndex.Close();
+        archiver.push(Extinction::SpillIndex::GetFilename(foutname), true);
+      }
+    };
+  auto writeIndex =
+    [&](Extinction::SpillIndexEntry_t entry) {
+      // The spill runs from the end of the previous footer to the end of its footer
+      entry.HeaderOffset = spillBegin;
+      spillBegin         = entry.FooterOffset;
+      spillIndex.Write(entry);
+    };
+  auto spillEntry =
+    [&](long long footerEnd) {
+      Extinction::SpillIndexEntry_t entry;
+      entry.FooterOffset = footerEnd;
+      entry.Spill        = ispill - 1;
+      entry.Date         = time(nullptr);
+      return entry;
+    };
+  openIndex();
+
   std::cout << "Start daq" << std::endl;
   time_t t_start = time(nullptr);
 
@@ -238,13 +272,14 @@ int main(int argc, char** argv){
         if ((filledLength = read(sock, rcvdBuffer, readSize)) <= 0) {
           std::cerr << " recv() faild" << std::endl;
           close(sock);
+          tap.Close();
           fclose(fout);
           // Compress and move output file
-          if ((cmd = command(&foutname, &forwardDir))) {
-            system(cmd);
-          }
+          archiver.push(foutname);
+          archiver.finish();
           exit(EXIT_FAILURE);
         }
+        tap.Write(rcvdBuffer, filledLength);
 
         // for (k = 0; k < filledLength; ++k) {
         //   printf("%02x ", rcvdBuffer[k]);
@@ -258,9 +293,7 @@ int main(int argc, char** argv){
           fclose(fout);
 
           // Compress and move output file
-          if ((cmd = command(&foutname, &forwardDir))) {
-            system(cmd);
-          }
+          archiver.push(foutname);
 
           // Open next file
           foutname = filename(&directory);
@@ -268,6 +301,8 @@ int main(int argc, char** argv){
           if ((fout = fopen(foutname.data(), "wb")) == nullptr) {
             std::cerr << "[error] output file was not opened, " << foutname << std::endl;
             close(sock);
+            tap.Close();
+            archiver.finish();
             exit(1);
           }
         }
@@ -289,13 +324,14 @@ int main(int argc, char** argv){
           if ((recvLength = read(sock, rcvdBuffer + filledLength, readSize - filledLength)) <= 0) {
             std::cerr << " recv() faild" << std::endl;
             close(sock);
+            tap.Close();
             fclose(fout);
             // Compress and move output file
-            if ((cmd = command(&foutname, &forwardDir))) {
-              system(cmd);
-            }
+            archiver.push(foutname);
+            archiver.finish();
             exit(EXIT_FAILURE);
           } else {
+            tap.Write(rcvdBuffer + filledLength, recvLength);
             filledLength += recvLength;
           }
         }
@@ -312,9 +348,7 @@ int main(int argc, char** argv){
           fclose(fout);
 
           // Compress and move output file
-          if ((cmd = command(&foutname, &forwardDir))) {
-            system(cmd);
-          }
+          archiver.push(foutname);
 
           // Open next file
           foutname = filename(&directory);
@@ -322,6 +356,8 @@ int main(int argc, char** argv){
           if ((fout = fopen(foutname.data(), "wb")) == nullptr) {
             std::cerr << "[error] output file was not opened, " << foutname << std::endl;
             close(sock);
+            tap.Close();
+            archiver.finish();
             exit(1);
           }
         }
@@ -343,13 +379,15 @@ int main(int argc, char** argv){
         if ((recvLength = read(sock, rcvdBuffer + writtenLength + filledLength, BUFSIZE - (writtenLength + filledLength))) <= 0) {
           std::cerr << " recv() faild" << std::endl;
           close(sock);
+          tap.Close();
           fclose(fout);
           // Compress and move output file
-          if ((cmd = command(&foutname, &forwardDir))) {
-            system(cmd);
-          }
+          archiver.push(foutname);
+          closeIndex();
+          archiver.finish();
           exit(EXIT_FAILURE);
         } else {
+          tap.Write(rcvdBuffer + writtenLength + filledLength, recvLength);
           filledLength += recvLength;
         }
 
@@ -362,7 +400,11 @@ int main(int argc, char** argv){
             // puts("");
 
             if (GetDataType(rcvdBuffer + writtenLength + writeBegin) == DataType::Footer) {
-              if (++ispill % nofSpills == 0) {
+              ++ispill;
+              if (indexed) {
+                writeIndex(spillEntry(fileLength + writeEnd));
+              }
+              if (ispill % nofSpills == 0) {
                 fwrite(rcvdBuffer + writtenLength,  sizeof(char), writeEnd, fout);
                 writtenLength += writeEnd;
                 filledLength  -= writeEnd;
@@ -372,9 +414,8 @@ int main(int argc, char** argv){
                 fclose(fout);
 
                 // Compress and move output file
-                if ((cmd = command(&foutname, &forwardDir))) {
-                  system(cmd);
-                }
+                archiver.push(foutname);
+                closeIndex();
 
                 // Open next file
                 foutname = filename(&directory);
@@ -382,8 +423,11 @@ int main(int argc, char** argv){
                 if ((fout = fopen(foutname.data(), "wb")) == nullptr) {
                   std::cerr << "[error] output file was not opened, " << foutname << std::endl;
                   close(sock);
+                  tap.Close();
+                  archiver.finish();
                   exit(1);
                 }
+                openIndex();
               } else {
                 writeBegin  = writeEnd;
                 writeEnd   += UNITSIZE;
@@ -397,6 +441,7 @@ int main(int argc, char** argv){
 
           if (writeBegin) {
             fwrite(rcvdBuffer + writtenLength,  sizeof(char), writeBegin, fout);
+            fileLength    += writeBegin;
             writtenLength += writeBegin;
             filledLength  -= writeBegin;
           }
@@ -412,9 +457,159 @@ int main(int argc, char** argv){
     }
     break;
 
+  case 3:
+    {
+      // Socket reader on this thread, file writer on another thread
+      evlimit = nofEvents > 0 ? nofEvents : std::numeric_limits<long long>::max();
+      std::vector<unsigned char> pool((std::size_t)nofBuffers * ASYNCSIZE);
+      std::vector<buffer_t>      buffers(nofBuffers);
+      spsc_queue_t<buffer_t*>    freeQueue  (nofBuffers);
+      spsc_queue_t<buffer_t*>    filledQueue(nofBuffers);
+      for (int i = 0; i < nofBuffers; ++i) {
+        buffers[i].data = pool.data() + (std::size_t)i * ASYNCSIZE;
+        freeQueue.push(&buffers[i]);
+      }
+
+      // Counters
+      std::size_t maxQueueDepth = 0;
+      long long   nofStalls     = 0;
+      long long   maxStall      = 0; // [usec]
+      long long   maxWrite      = 0; // [usec]
+
+      std::thread writer([&] {
+          for (buffer_t* buffer = nullptr; ;) {
+            if (!filledQueue.pop(buffer)) {
+              usleep(100);
+              continue;
+            }
+
+            const auto writeStart = std::chrono::steady_clock::now();
+            fwrite(buffer->data, sizeof(char), buffer->length, fout);
+            maxWrite = std::max(maxWrite, elapsedUsec(writeStart));
+
+            for (auto&& entry : buffer->spills) {
+              entry.FooterOffset += fileLength;
+              writeIndex(entry);
+            }
+            fileLength += buffer->length;
+
+            const bool last = buffer->last;
+            if (buffer->rotate || last) {
+              fclose(fout);
+              fout = nullptr;
+
+              // Compress and move output file
+              archiver.push(foutname);
+              closeIndex();
+            }
+            if (buffer->rotate && !last) {
+              // Open next file
+              foutname = filename(&directory);
+              std::cout << "File Open: " << foutname << std::endl;
+              if ((fout = fopen(foutname.data(), "wb")) == nullptr) {
+                std::cerr << "[error] output file was not opened, " << foutname << std::endl;
+                close(sock);
+                tap.Close();
+                archiver.finish();
+                exit(1);
+              }
+              openIndex();
+            }
+
+            freeQueue.push(buffer);
+            if (last) {
+              break;
+            }
+          }
+        });
+
+      auto acquire =
+        [&]() {
+          buffer_t* buffer = nullptr;
+          if (!freeQueue.pop(buffer)) {
+            ++nofStalls;
+            const auto stallStart = std::chrono::steady_clock::now();
+            while (!freeQueue.pop(buffer)) {
+              usleep(10);
+            }
+            maxStall = std::max(maxStall, elapsedUsec(stallStart));
+          }
+          buffer->length = 0;
+          buffer->rotate = false;
+          buffer->last   = false;
+          buffer->spills.clear();
+          return buffer;
+        };
+      auto submit =
+        [&](buffer_t* buffer) {
+          filledQueue.push(buffer);
+          maxQueueDepth = std::max(maxQueueDepth, filledQueue.size());
+        };
+
+      buffer_t* buffer  = acquire();
+      int       scanned = 0;
+      bool      failed  = false;
+      while (ievent <= evlimit) {
+        if ((recvLength = read(sock, buffer->data + buffer->length, ASYNCSIZE - buffer->length)) <= 0) {
+          std::cerr << " recv() faild" << std::endl;
+          failed = true;
+          break;
+        } else {
+          tap.Write(buffer->data + buffer->length, recvLength);
+          buffer->length += recvLength;
+        }
+
+        for (; scanned + UNITSIZE <= buffer->length; scanned += UNITSIZE) {
+          ++ievent;
+          if (GetDataType(buffer->data + scanned) != DataType::Footer) {
+            continue;
+          }
+          ++ispill;
+          if (indexed) {
+            buffer->spills.push_back(spillEntry(scanned + UNITSIZE));
+          }
+          if (ispill % nofSpills == 0) {
+            // Hand over data until the footer, and carry the rest to the next buffer
+            const int end   = scanned + UNITSIZE;
+            buffer_t* next  = acquire();
+            next->length    = buffer->length - end;
+            std::memcpy(next->data, buffer->data + end, next->length);
+            buffer->length  = end;
+            buffer->rotate  = true;
+            submit(buffer);
+            buffer  = next;
+            scanned = -UNITSIZE;
+          }
+        }
+
+        if (buffer->length == ASYNCSIZE) {
+          submit(buffer);
+          buffer  = acquire();
+          scanned = 0;
+        }
+      }
+
+      buffer->last = true;
+      submit(buffer);
+      writer.join();
+
+      std::cout << "Async writer: max queue depth " << maxQueueDepth << " / " << nofBuffers
+                << ", " << nofStalls << " stalls (max " << maxStall << " usec)"
+                << ", max write " << maxWrite << " usec" << std::endl;
+
+      if (failed) {
+        close(sock);
+        tap.Close();
+        archiver.finish();
+        exit(EXIT_FAILURE);
+      }
+    }
+    break;
+
   default:
     std::cerr << "invalid pattern" << std::endl;
     close(sock);
+    tap.Close();
     exit(1);
     break;
   }
@@ -429,13 +624,21 @@ int main(int argc, char** argv){
   close(sock);
   std::cout << "socket closed" << std::endl;
 
+  // Close tap, attached monitors see end of data
+  tap.Close();
+
   // Close file
-  fclose(fout);
+  if (fout) {
+    fclose(fout);
 
-  // Compress and move output file
-  if ((cmd = command(&foutname, &forwardDir))) {
-    system(cmd);
+    // Compress and move output file
+    archiver.push(foutname);
   }
+  closeIndex();
+
+  // Wait for move and compression
+  std::cout << "Wait for archiver" << std::endl;
+  archiver.finish();
 
   // Verbose daq time
   const int t_diff = t_stop - t_start;
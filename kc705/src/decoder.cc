@@ -2,19 +2,22 @@
 #include <fstream>
 #include <vector>
 #include <string>
-#include <limits>
 #include "TFile.h"
 #include "TTree.h"
 #include "Kc705.hh"
+#include "RawBuffer.hh"
+#include "SpillIndex.hh"
 #include "Units.hh"
 #include "ArgReader.hh"
 
 Int_t main(Int_t argc, Char_t** argv) {
   Tron::ArgReader* args = new Tron::ArgReader(argv[0]);
-  args->AddArg<std::string>("Input"     ,                    "Set rawdata filename");
-  args->AddOpt<std::string>("Output"    , 'o', "output"    , "Set output filename", "");
-  args->AddOpt<Int_t>      ("EMCount"   , 'c', "emcount"   , "Set default count of event match", "-1");
-  args->AddOpt             ("Help"      , 'h', "help"      , "Show usage");
+  args->AddArg<std::string>("Input"      ,                       "Set rawdata filename");
+  args->AddOpt<std::string>("Output"     , 'o', "output"       , "Set output filename", "");
+  args->AddOpt<Int_t>      ("EMCount"    , 'c', "emcount"      , "Set default count of event match", "-1");
+  args->AddOpt             ("NoHitArrays", 'n', "no-hit-arrays", "Do not store mppcs/subs branches");
+  args->AddOpt             ("Index"      , 'x', "index"        , "Write spill index of the rawdata file");
+  args->AddOpt             ("Help"       , 'h', "help"         , "Show usage");
 
   if (!args->Parse(argc, argv) || args->IsSet("Help") || args->HasUnsetRequired()) {
     args->ShowUsage();
@@ -24,6 +27,8 @@ Int_t main(Int_t argc, Char_t** argv) {
   const std::string ifilename  = args->GetValue("Input");
   const std::string ofilename  = args->GetValue("Output");
   const Int_t       emDefCount = args->GetValue<Int_t>("EMCount");
+  const Bool_t      index      = args->IsSet("Index") && ifilename != "std::cin";
+  const Bool_t      hitArrays  = !args->IsSet("NoHitArrays");
 
   std::string ofilenameRoot;
   if (ofilename.empty()) {
@@ -40,17 +45,10 @@ Int_t main(Int_t argc, Char_t** argv) {
   }
 
   std::cout << "=== Open Input File" << std::endl;
-  std::istream* istr = nullptr;
-  std::ifstream ifile;
-  if (ifilename == "std::cin") {
-    istr = &std::cin;
-  } else {
-    ifile.open(ifilename, std::ios::binary);
-    if (!ifile) {
-      std::cout << "[error] input file is not opened, " << ifilename << std::endl;
-      return 1;
-    }
-    istr = &ifile;
+  Extinction::RawBuffer ibuffer;
+  if (!ibuffer.Open(ifilename)) {
+    std::cout << "[error] input file is not opened, " << ifilename << std::endl;
+    return 1;
   }
 
   std::cout << "=== Create Output File" << std::endl;
@@ -65,18 +63,44 @@ Int_t main(Int_t argc, Char_t** argv) {
   std::vector<Extinction::TdcData> emdata;
 
   std::cout << "=== Initialize Tree" << std::endl;
+  decoder.Data.StoreHitArrays = hitArrays;
   decoder.InitializeTree();
+  decoder.Data.AddEMBranch(decoder.Tree);
 
   std::cout << "=== Initialize Variables" << std::endl;
   Int_t lastMrSyncCount = 0;
   Int_t lastMrSyncTdc   = 0;
 
+  Extinction::SpillIndex        spillIndex;
+  Extinction::SpillIndexEntry_t spillIndexEntry;
+  if (index) {
+    std::cout << "=== Open Spill Index" << std::endl;
+    std::cout << Extinction::SpillIndex::GetFilename(ifilename) << std::endl;
+    if (!spillIndex.Open(Extinction::SpillIndex::GetFilename(ifilename))) {
+      return 1;
+    }
+  }
+
   std::cout << "=== Decode" << std::endl;
-  std::vector<std::pair<Long64_t, Int_t>> emCount;
+  // Records of the current spill are kept until its event match number is decoded at the footer
+  std::vector<Extinction::Kc705::TreeRecord_t> spillData;
   Int_t nextEmCount = emDefCount;
-  emCount.push_back({ std::numeric_limits<Long64_t>::max(), nextEmCount });
+  auto fillSpill =
+    [&](Int_t emcount) {
+      const Extinction::Kc705::TreeRecord_t current        = decoder.Data.GetTreeRecord();
+      const Int_t                           currentEmCount = decoder.Data.EMCount;
+      decoder.Data.EMCount = emcount;
+      for (auto&& record : spillData) {
+        decoder.Data.SetTreeRecord(record);
+        decoder.Tree->Fill();
+      }
+      decoder.Data.SetTreeRecord(current);
+      decoder.Data.EMCount = currentEmCount;
+      spillData.clear();
+    };
   std::size_t count = 0UL;
-  for (; decoder.Read(*istr); ++count) {
+  Long64_t offset = ibuffer.Tell();
+  for (; decoder.Read(ibuffer); ++count, offset = ibuffer.Tell()) {
     if (count % 100000 == 0) {
       std::cout << ">> " << count << std::endl;
     }
@@ -87,47 +111,50 @@ Int_t main(Int_t argc, Char_t** argv) {
 
     if (decoder.Data.IsData()) {
       // std::cout << "data" << std::endl;
-      decoder.Tree->Fill();
+      spillData.push_back(decoder.Data.GetTreeRecord());
 
       if (decoder.Data.MrSync) {
         ++lastMrSyncCount;
         lastMrSyncTdc = decoder.Data.Tdc;
       }
 
+    } else if (decoder.Data.Type == Extinction::Kc705::DataType::Header) {
+      spillIndexEntry = { };
+      spillIndexEntry.HeaderOffset = offset;
+
     } else if (decoder.Data.IsFooter()) {
       std::cout << "end of spill " << decoder.Data.Spill << std::endl;
-      decoder.Tree->Fill();
+      spillData.push_back(decoder.Data.GetTreeRecord());
 
-      emCount.back() = { decoder.Tree->GetEntries(), decoder.Data.DecodeEventMatchNumber(emdata) };
-      if (emCount.back().second < 0) {
-        emCount.back().second = nextEmCount < 0 ? nextEmCount : nextEmCount++;
+      Int_t emcount = decoder.Data.DecodeEventMatchNumber(emdata);
+      if (emcount < 0) {
+        emcount = nextEmCount < 0 ? nextEmCount : nextEmCount++;
       } else {
-        nextEmCount = emCount.back().second + 1;
+        nextEmCount = emcount + 1;
       }
-      emCount.push_back({ std::numeric_limits<Long64_t>::max(), nextEmCount });
+      fillSpill(emcount);
+
+      spillIndexEntry.FooterOffset = ibuffer.Tell();
+      spillIndexEntry.Spill        = decoder.Data.Spill;
+      spillIndexEntry.EMCount      = emcount;
+      spillIndexEntry.WRCount      = decoder.Data.WRCount;
+      spillIndexEntry.Date         = decoder.Data.Date;
+      spillIndex.Write(spillIndexEntry);
 
       emdata.clear();
     }
   }
   std::cout << "# of data record = " << count << std::endl;
 
-  TBranch* emBranch = decoder.Data.AddEMBranch(decoder.Tree);
-  for (Long64_t entry = 0, entries = decoder.Tree->GetEntries(), iem = 0; entry < entries; ++entry) {
-    if (entry < emCount[iem].first || entry < emCount[++iem].first) {
-      decoder.Data.EMCount = emCount[iem].second;
-    } else {
-      std::cout << "[error] unexpected scenario" << std::endl;
-      return 1;
-    }
-    emBranch->Fill();
-  }
+  fillSpill(nextEmCount);
 
   std::cout << "=== Write Objects" << std::endl;
   std::cout << decoder.Tree->GetName() << "\t" << decoder.Tree->GetEntries() << " entries" << std::endl;
   decoder.Tree->Write();
 
   std::cout << "=== Close Files" << std::endl;
-  ifile.close();
+  spillIndex.Close();
+  ibuffer.Close();
   ofile->Close();
 
   return 0;
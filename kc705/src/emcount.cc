@@ -5,16 +5,106 @@
 #include <limits>
 #include <ctime>
 #include <regex>
+#include <algorithm>
 #include "TFile.h"
 #include "TTree.h"
 #include "Kc705.hh"
+#include "RawFileStream.hh"
+#include "SpillIndex.hh"
 #include "Units.hh"
 #include "ArgReader.hh"
 
+namespace {
+
+  using Extinction::Kc705::Packet_t;
+
+  // Reads the spill header (w/ date) at headerOffset and the footer which ends at footerEnd
+  Bool_t ReadHeaderAndFooter(std::istream& file, Long64_t headerOffset, Long64_t footerEnd,
+                             Extinction::Kc705::Kc705Data& data) {
+    data.Clear();
+    file.clear();
+    if (!file.seekg(headerOffset) || !data.ReadHeader(file) ||
+        data.Type != Extinction::Kc705::DataType::Header) {
+      return false;
+    }
+    if (!file.seekg(footerEnd - sizeof(Packet_t)) || !data.ReadDataOrFooter(file) ||
+        !data.IsFooter()) {
+      return false;
+    }
+    return true;
+  }
+
+  // Returns the end offset of the last footer by scanning backwards from EOF block by block.
+  // A footer id is accepted only at the end of file or just before a header, not to pick up data by chance.
+  Long64_t FindLastFooterEnd(std::istream& file) {
+    const Long64_t packetSize = sizeof(Packet_t);
+    const Long64_t blockSize  = 1024 * packetSize;
+
+    file.clear();
+    if (!file.seekg(0, std::ios::end)) {
+      return -1;
+    }
+    const Long64_t size = file.tellg();
+
+    std::vector<UChar_t> block(blockSize + 2 * packetSize);
+    for (Long64_t end = size; end > 0;) {
+      const Long64_t begin  = std::max(0LL, end - blockSize);
+      const Long64_t length = std::min(size, end + 2 * packetSize) - begin;
+      if (!file.seekg(begin) || !file.read((Char_t*)block.data(), length)) {
+        return -1;
+      }
+      for (Long64_t i = std::min(end - begin - 1, length - packetSize); i >= 0; --i) {
+        UChar_t* packet = block.data() + i;
+        if (Extinction::Kc705::Packet::IsFooter(packet) &&
+            (begin + i + packetSize == size ||
+             (i + 2 * packetSize <= length && Extinction::Kc705::Packet::IsHeader(packet + packetSize)))) {
+          return begin + i + packetSize;
+        }
+      }
+      end = begin;
+    }
+    return -1;
+  }
+
+  // Reads the first spill from the spill index, or from the last footer if the file has only one spill
+  Bool_t ReadFirstSpill(std::istream& file, const std::string& filename,
+                        Extinction::Kc705::Kc705Data& data) {
+    std::vector<Extinction::SpillIndexEntry_t> entries;
+    if (Extinction::SpillIndex::Read(Extinction::SpillIndex::GetFilename(filename), entries) && entries.size()) {
+      return ReadHeaderAndFooter(file, entries.front().HeaderOffset, entries.front().FooterOffset, data);
+    }
+
+#if KC705_FORMAT_VERSION == 1
+    // No spill number in footer to check the file has only one spill
+    return false;
+#else
+    const Long64_t footerEnd = FindLastFooterEnd(file);
+    if (footerEnd < 0) {
+      return false;
+    }
+
+    Packet_t header, footer;
+    file.clear();
+    if (!file.seekg(0) || !file.read((Char_t*)header, sizeof(Packet_t)) ||
+        !file.seekg(footerEnd - sizeof(Packet_t)) || !file.read((Char_t*)footer, sizeof(Packet_t))) {
+      return false;
+    }
+    if (!Extinction::Kc705::Packet::IsHeader(header) ||
+        Extinction::Kc705::Packet::GetSpill(header) != Extinction::Kc705::Packet::GetSpill(footer)) {
+      return false;
+    }
+
+    return ReadHeaderAndFooter(file, 0, footerEnd, data);
+#endif
+  }
+
+}
+
 Int_t main(Int_t argc, Char_t** argv) {
   Tron::ArgReader* args = new Tron::ArgReader(argv[0]);
   args->AddArg<std::string>("Input"     ,                    "Set rawdata filename");
   args->AddOpt<Int_t>      ("Board"     , 'b', "board"     , "Set board id");
+  args->AddOpt             ("Scan"      , 's', "scan"      , "Decode from the head of file without seeking footer");
   args->AddOpt             ("Help"      , 'h', "help"      , "Show usage");
 
   if (!args->Parse(argc, argv) || args->IsSet("Help") || args->HasUnsetRequired()) {
@@ -24,14 +114,15 @@ Int_t main(Int_t argc, Char_t** argv) {
 
   const std::string ifilename = args->GetValue("Input");
   const Int_t       board     = args->GetValue<Int_t>("Board");
+  const Bool_t      scan      = args->IsSet("Scan");
 
   // Open Input File
   std::istream* istr = nullptr;
-  std::ifstream ifile;
+  Extinction::RawFileStream ifile;
   if (ifilename == "std::cin") {
     istr = &std::cin;
   } else {
-    ifile.open(ifilename, std::ios::binary);
+    ifile.open(ifilename);
     if (!ifile) {
       std::cerr << "[error] input file is not opened, " << ifilename << std::endl;
       return 1;
@@ -42,9 +133,16 @@ Int_t main(Int_t argc, Char_t** argv) {
   Extinction::Kc705::Decoder decoder;
 
   // Read file
-  while (decoder.Read(*istr)) {
-    if (decoder.Data.IsFooter()) {
-      break;
+  if (scan || ifilename == "std::cin" || ifile.IsCompressed() || !ReadFirstSpill(ifile, ifilename, decoder.Data)) {
+    if (ifile.is_open() && !ifile.IsCompressed()) {
+      ifile.clear();
+      ifile.seekg(0);
+    }
+    decoder.Data.Clear();
+    while (decoder.Read(*istr)) {
+      if (decoder.Data.IsFooter()) {
+        break;
+      }
     }
   }
   ifile.close();
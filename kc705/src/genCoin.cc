@@ -28,6 +28,11 @@ Int_t main(Int_t argc, Char_t** argv) {
   args->AddOpt             ("Timeline"    , 't', "timeline"    , "Draw timeline of coincidence");
   args->AddOpt<Int_t      >("MSCount"     , 'm', "mscount"     , "Draw timeline in mr sync count", "-1");
   args->AddOpt             ("Efficiency"  , 'e', "efficiency"  , "Execute efficiency analysis");
+  args->AddOpt             ("Sweep"       , 's', "sweep"       , "Use sweep line coincidence engine");
+  args->AddOpt             ("Bitset"      , 'b', "bitset"      , "Use bitset coincidence engine");
+  args->AddOpt             ("CrossCheck"  , 'c', "cross-check" , "Compare bitset engine with timeline scan");
+  args->AddOpt<Int_t      >("Prefetch"    , 'p', "prefetch"    , "Set number of chunks read ahead per board", "0");
+  args->AddOpt             ("Marged"      , 'M', "marged"      , "Read Input as a marged hit file made by marger");
   args->AddOpt             ("Keyword"     , 'k', "keyword"     , "Set keyword for filename");
   args->AddOpt             ("Help"        , 'h', "help"        , "Show usage");
 
@@ -48,6 +53,11 @@ Int_t main(Int_t argc, Char_t** argv) {
   const auto drawCoinTimeline = args->IsSet("Timeline");
   const auto mscountSelection = args->GetValue<Int_t>("MSCount");
   const auto efficiency       = args->IsSet("Efficiency");
+  const auto sweep            = args->IsSet("Sweep");
+  const auto bitset           = args->IsSet("Bitset");
+  const auto crossCheck       = args->IsSet("CrossCheck");
+  const auto prefetch         = args->GetValue<Int_t>("Prefetch");
+  const auto marged           = args->IsSet("Marged");
   const auto keyword          = args->GetValue("Keyword");
   const std::string keywordSuffix = keyword.empty() ? "" : ("_" + keyword);
 
@@ -111,6 +121,7 @@ Int_t main(Int_t argc, Char_t** argv) {
 
   std::cout << "--- Initialize marged reader" << std::endl;
   auto reader = new Extinction::Analyzer::MargedReader(&defaultProvider);
+  reader->SetPrefetchDepth(prefetch);
   reader->SetMrSyncTimeOffset(conf->GetValue<Double_t>("MrSyncTimeOffset"));
 
   {
@@ -145,11 +156,20 @@ Int_t main(Int_t argc, Char_t** argv) {
   generator->SetCoincidenceTarget(conf->GetValues<Int_t   >("CoincidenceTarget"));
   generator->SetCoinTimeWidth    (conf->GetValue <Double_t>("CoinTimeWidth"    ));
   generator->SetBunchEdgeMargin  (conf->GetValue <Double_t>("BunchEdgeMargin"  ));
+  if (sweep) {
+    generator->SetCoinEngine(Extinction::Analyzer::CoinEngine::SweepLine);
+  } else if (bitset) {
+    generator->SetCoinEngine(Extinction::Analyzer::CoinEngine::Bitset);
+    generator->SetCoinCrossCheck(crossCheck);
+  }
 
   generator->InitializePlots(profile);
 
   if (efficiency) {
     std::cout << "--- Generate efficiency" << std::endl;
+    if (marged) {
+      reader->SetMargedInput(ifilenames.begin()->second);
+    }
     generator->GenerateEfficiency(reader, providers, ifilenames, "tree");
 
     generator->DrawPlots(ofilenamePdf_Efficiency);
@@ -162,7 +182,7 @@ Int_t main(Int_t argc, Char_t** argv) {
     generator->InitializeCoinTree(ofilenameCoinTree);
     generator->InitializeSpillSummary(ofilenameSpill);
 
-    if (reader->Open(providers, ifilenames, "tree")) {
+    if (marged ? reader->OpenMarged(ifilenames.begin()->second) : reader->Open(providers, ifilenames, "tree")) {
       exit(1);
     }
 
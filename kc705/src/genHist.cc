@@ -20,12 +20,15 @@
 
 Int_t main(Int_t argc, Char_t** argv) {
   Tron::ArgReader* args = new Tron::ArgReader(argv[0]);
-  args->AddArg<std::string>("ConfFilename",                "Set configure filename");
-  args->AddArg<std::string>("Boards"      ,                "Set comma separated board numbers");
-  args->AddArg<std::string>("Input"       ,                "Set comma separated root filenames");
-  args->AddOpt<std::string>("Output"      , 'o', "output", "Set prefix of output filename", "");
-  args->AddOpt             ("Delay"       , 'd', "delay" , "Apply software delay");
-  args->AddOpt             ("Help"        , 'h', "help"  , "Show usage");
+  args->AddArg<std::string>("ConfFilename",                  "Set configure filename");
+  args->AddArg<std::string>("Boards"      ,                  "Set comma separated board numbers");
+  args->AddArg<std::string>("Input"       ,                  "Set comma separated root filenames");
+  args->AddOpt<std::string>("Output"      , 'o', "output"  , "Set prefix of output filename", "");
+  args->AddOpt             ("Delay"       , 'd', "delay"   , "Apply software delay");
+  args->AddOpt<Int_t      >("Prefetch"    , 'p', "prefetch", "Set number of chunks read ahead per board", "0");
+  args->AddOpt<Int_t      >("Threads"     , 'j', "threads" , "Set number of threads processing spills", "1");
+  args->AddOpt             ("Marged"      , 'M', "marged"  , "Read Input as a marged hit file made by marger");
+  args->AddOpt             ("Help"        , 'h', "help"    , "Show usage");
 
   if (!args->Parse(argc, argv) || args->IsSet("Help") || args->HasUnsetRequired()) {
     args->ShowUsage();
@@ -42,6 +45,9 @@ Int_t main(Int_t argc, Char_t** argv) {
            [&](std::pair<std::string, Int_t> pair) { return pair.first;  });
   const auto ofilename    = args->GetValue("Output");
   const auto delayOption  = args->IsSet("Delay");
+  const auto prefetch     = args->GetValue<Int_t>("Prefetch");
+  const auto nthreads     = args->GetValue<Int_t>("Threads");
+  const auto marged       = args->IsSet("Marged");
 
   std::string ofileprefix;
   if (ofilename.empty()) {
@@ -91,12 +97,14 @@ Int_t main(Int_t argc, Char_t** argv) {
   std::cout << "--- Initialize providers" << std::endl;
   Extinction::Kc705::Kc705Data defaultProvider;
 
+  auto createProvider = [](Int_t) -> Extinction::ITdcDataProvider* { return new Extinction::Kc705::Kc705Data(); };
   auto providers = Tron::Linq::From(boards)
     .ToMap([](Int_t board) { return board; },
-           [](Int_t) -> Extinction::ITdcDataProvider* { return new Extinction::Kc705::Kc705Data(); });
+           createProvider);
 
   std::cout << "--- Initialize marged reader" << std::endl;
   auto reader = new Extinction::Analyzer::MargedReader(&defaultProvider);
+  reader->SetPrefetchDepth(prefetch);
 
   if (delayOption) {
     reader->SetMrSyncTimeOffset(conf->GetValue<Double_t>("MrSyncTimeOffset"));
@@ -145,11 +153,11 @@ Int_t main(Int_t argc, Char_t** argv) {
   generator->InitializeSpillSummary(ofilenameSpill);
 
   std::cout << "--- Generate hists" << std::endl;
-  if (reader->Open(providers, ifilenames, "tree")) {
+  if (marged ? reader->OpenMarged(ifilenames.begin()->second) : reader->Open(providers, ifilenames, "tree")) {
     exit(1);
   }
 
-  generator->GeneratePlots(reader);
+  generator->GeneratePlots(reader, ifilenames, "tree", createProvider, std::max(nthreads, 1));
 
   reader->Close();
 
@@ -0,0 +1,115 @@
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <regex>
+#include "TROOT.h"
+#include "TStyle.h"
+#include "TFile.h"
+#include "TTree.h"
+#include "TParameter.h"
+#include "TCanvas.h"
+#include "TH1.h"
+#include "TH2.h"
+#include "TGraph.h"
+#include "Linq.hh"
+#include "ArgReader.hh"
+#include "Units.hh"
+#include "TreeMarger.hh"
+#include "Kc705.hh"
+
+Int_t main(Int_t argc, Char_t** argv) {
+  Tron::ArgReader* args = new Tron::ArgReader(argv[0]);
+  args->AddArg<std::string>("ConfFilename",                  "Set configure filename");
+  args->AddArg<std::string>("Boards"      ,                  "Set comma separated board numbers");
+  args->AddArg<std::string>("Input"       ,                  "Set comma separated root filenames");
+  args->AddArg<std::string>("Output"      ,                  "Set output filename", "");
+  args->AddOpt             ("Delay"       , 'd', "delay"   , "Apply software delay");
+  args->AddOpt<Int_t      >("Prefetch"    , 'p', "prefetch", "Set number of chunks read ahead per board", "0");
+  args->AddOpt             ("Help"        , 'h', "help"    , "Show usage");
+
+  if (!args->Parse(argc, argv) || args->IsSet("Help") || args->HasUnsetRequired()) {
+    args->ShowUsage();
+    return 0;
+  }
+
+  const auto confFilename = args->GetValue("ConfFilename");
+  const auto boards       = Tron::Linq::From(Tron::String::Split(args->GetValue("Boards"), ","))
+    .Select([](const std::string& board) { return Tron::String::Convert<Int_t>(board); })
+    .ToVector();
+  const auto ifilenames   = Tron::Linq::From(Tron::String::Split(args->GetValue("Input" ), ","))
+    .Join (boards.begin())
+    .ToMap([&](std::pair<std::string, Int_t> pair) { return pair.second; },
+           [&](std::pair<std::string, Int_t> pair) { return pair.first;  });
+  const auto ofilename    = args->GetValue("Output");
+  const auto delayOption  = args->IsSet("Delay");
+  const auto prefetch     = args->GetValue<Int_t>("Prefetch");
+
+  std::cout << "--- Load configure" << std::endl;
+  Tron::ConfReader* conf = new Tron::ConfReader(confFilename);
+  if (!conf->IsOpen()) {
+    std::cerr << " [error] config file is not opened, " << confFilename << std::endl;
+    return 1;
+  }
+  conf->ShowContents();
+
+  Extinction::Kc705::ChannelMapWithBoard::Load(conf, boards);
+
+  std::cout << "--- Initialize style" << std::endl;
+  gStyle->SetPalette(1);
+  gStyle->SetOptStat(111111);
+  gStyle->SetOptFit(1);
+  gStyle->SetNdivisions(520, "X");
+  gStyle->SetNdivisions(505, "Y");
+
+  std::cout << "--- Initialize tree marger" << std::endl;
+  Extinction::Kc705::Kc705Data defaultProvider;
+  auto marger = new Extinction::Analyzer::TreeMarger(&defaultProvider);
+  if (marger->InitializeTree(ofilename)) {
+    return 1;
+  }
+
+  auto reader = marger->GetReader();
+  reader->SetPrefetchDepth(prefetch);
+
+  if (delayOption) {
+    reader->SetMrSyncTimeOffset(conf->GetValue<Double_t>("MrSyncTimeOffset"));
+
+    const std::string ifilename = conf->GetValue("TdcOffsets");
+    if (reader->LoadTdcOffsets(ifilename) == 0) {
+      std::cerr << "[warning] offset is empty" << std::endl;
+    }
+  }
+
+  std::map<Int_t, Double_t> timePerTdc;
+  do {
+    const std::string ifilename = conf->GetValue("TimePerTdc");
+    std::ifstream ifile(ifilename);
+    if (!ifile) {
+      std::cout << "[warning] time resolution file was not opened, " << ifilename << std::endl;
+      break;
+    }
+
+    std::string buff;
+    Int_t board; Double_t resolution;
+    while (std::getline(ifile, buff)) {
+      std::stringstream line(buff);
+      if (line >> board >> resolution) {
+        timePerTdc[board] = resolution * Extinction::nsec;
+      }
+    }
+  } while (false);
+
+  marger->SetTimePerTdc(timePerTdc);
+
+  auto providers = Tron::Linq::From(boards)
+    .ToMap([](Int_t board) { return board; },
+           [](Int_t) -> Extinction::ITdcDataProvider* { return new Extinction::Kc705::Kc705Data(); });
+
+  std::cout << "--- Marge tree" << std::endl;
+  marger->MargeTree(providers, ifilenames, "tree");
+
+  std::cout << "--- Output tree" << std::endl;
+  marger->WriteTree();
+
+  return 0;
+}
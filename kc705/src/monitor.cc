@@ -13,10 +13,13 @@
 #include <limits>
 #include <sys/inotify.h>
 #include <pthread.h>
+#include <set>
 
 #include "Units.hh"
 #include "Detector.hh"
 #include "Kc705.hh"
+#include "RawFileStream.hh"
+#include "ShmRing.hh"
 
 #include "TROOT.h"
 #include "TApplication.h"
@@ -28,6 +31,7 @@
 #include "TH2.h"
 #include "TGraphErrors.h"
 
+#include "String.hh"
 #include "ArgReader.hh"
 #include "AnaCoin.hh"
 
@@ -36,6 +40,9 @@ namespace {
   std::mutex filenameMutex;
   std::string path;
   std::string filename;
+  bool tailMode = false;
+  std::set<std::string> closedFilenames; // for tail mode
+  std::string shmName;                   // for shared memory mode
 
   int fd, wd;
 
@@ -79,9 +86,21 @@ namespace {
   TGraphErrors* gHitInSpill;
   TGraphErrors* gTotalHitInSpill;
   // TGraphErrors* gExtinction;
+
+  // History is in order of time, so only data in the window are looked at
+  template <typename Match>
+  Bool_t findInWindow(const Extinction::TdcHistory_t& history, Double_t lower, Double_t upper, Match&& match) {
+    const std::size_t first = history.LowerBound(lower, [](const Extinction::TdcData& data) { return data.Time; });
+    for (std::size_t i = first; i < history.size() && history[i].Time <= upper; ++i) {
+      if (match(history[i])) {
+        return true;
+      }
+    }
+    return false;
+  }
 }
 
-Int_t updatePlots(const std::string& ifilename) {
+Int_t updatePlots(std::istream& ifile) {
   using namespace Extinction;
   using CoinOffset = Analyzer::AnaTimeOffset::CoinOffset;
 
@@ -92,14 +111,55 @@ Int_t updatePlots(const std::string& ifilename) {
 
   std::cout << "=== Initialzie History" << std::endl;
   const Double_t lastThreshold = 100 * Extinction::nsec;
-  std::vector<Extinction::TdcData> lastExtData;
-  std::vector<Extinction::TdcData> lastHodData;
-  std::vector<Extinction::TdcData> lastTcData;
-  std::vector<Extinction::TdcData> lastBhData;
+  Extinction::TdcHistory_t         lastExtData;
+  Extinction::TdcHistory_t         lastHodData;
+  Extinction::TdcHistory_t         lastTcData;
+  Extinction::TdcHistory_t         lastBhData;
   std::vector<Extinction::TdcData> lastMrSyncData;
 
+  // Ext hits in coincidence with a hit of the index are looked up within these offsets
+  const Double_t coinSigma = 25.0 * nsec;
+  std::map<std::size_t/*index*/, std::pair<Double_t, Double_t>> extCoinMeanRanges; // min and max over ext channels
+  for (std::size_t index = 0; index < CoinOffset::N; ++index) {
+    Double_t minMean = +std::numeric_limits<Double_t>::max();
+    Double_t maxMean = -std::numeric_limits<Double_t>::max();
+    for (std::size_t extCh = 0; extCh < ExtinctionDetector::NofChannels; ++extCh) {
+      if (contains[extCh][index]) {
+        const Double_t mean = coinInfo[extCh][index].FitMean * timePerTdc;
+        minMean = std::min(minMean, mean);
+        maxMean = std::max(maxMean, mean);
+      }
+    }
+    if (minMean <= maxMean) {
+      extCoinMeanRanges[index] = { minMean, maxMean };
+    }
+  }
+
   std::cout << "=== Create Filler" << std::endl;
   Long64_t coinCount = 0;
+  auto findCoinExt =
+    [&](std::size_t i, Double_t time) {
+      std::vector<TdcData> coinExtData;
+      const auto itr = extCoinMeanRanges.find(i);
+      if (itr == extCoinMeanRanges.end()) {
+        return coinExtData;
+      }
+      // Time difference is opposite in sign to the offset
+      const auto& range = itr->second;
+      findInWindow(lastExtData, time - range.second - coinSigma, time - range.first + coinSigma,
+                   [&](const TdcData& lastData) {
+                     const std::size_t extCh = ExtinctionDetector::GetChannel(lastData.Channel);
+                     if (contains[extCh][i]) {
+                       const Double_t dt   = time - lastData.Time;
+                       const Double_t mean = coinInfo[extCh][i].FitMean * timePerTdc;
+                       if (TMath::Abs(dt - mean) < coinSigma) {
+                         coinExtData.push_back(lastData);
+                       }
+                     }
+                     return false;
+                   });
+      return coinExtData;
+    };
   auto fillCoin =
     [&](TdcData extData) {
       const std::size_t extCh = ExtinctionDetector::GetChannel(extData.Channel);
@@ -110,16 +170,14 @@ Int_t updatePlots(const std::string& ifilename) {
       for (std::size_t bhCh = 0; bhCh < BeamlineHodoscope::NofChannels; ++bhCh) {
         const std::size_t i = bhCh + CoinOffset::BH;
         if (contains[extCh][i]) {
-          coincidence[i] = false;
-          for (auto&& lastData : lastBhData) {
-            const Double_t dt    = lastData.Time - time;
-            const Double_t mean  = coinInfo[extCh][i].FitMean * timePerTdc;
-            const Double_t sigma = 25.0 * nsec;
-            if (TMath::Abs(dt - mean) < sigma) {
-              coincidence[i] = true;
-              break;
-            }
-          }
+          const Double_t mean  = coinInfo[extCh][i].FitMean * timePerTdc;
+          const Double_t sigma = 25.0 * nsec;
+          coincidence[i] =
+            findInWindow(lastBhData, time + mean - sigma, time + mean + sigma,
+                         [&](const TdcData& lastData) {
+                           const Double_t dt = lastData.Time - time;
+                           return TMath::Abs(dt - mean) < sigma;
+                         });
         } else {
           coincidence[i] = true;
         }
@@ -128,20 +186,21 @@ Int_t updatePlots(const std::string& ifilename) {
         const std::size_t hodCh = 0;
         const std::size_t i = hodCh + CoinOffset::Hod;
         if (contains[extCh][i]) {
-          coincidence[i] = false;
-          for (auto&& lastData : lastHodData) {
-            if (lastData.Channel != Hodoscope::GlobalChannelOffset) {
-              continue;
-            } // TBD: for 20201217
-            const Double_t dt    = lastData.Time - time;
-            const Double_t mean  = coinInfo[extCh][i].FitMean * timePerTdc;
-            const Double_t sigma = 25.0 * nsec;
-            if (TMath::Abs(dt - mean) < sigma) {
-              coincidence[i] = true;
-              coinHodChs.push_back(Hodoscope::GetChannel(lastData.Channel));
-              break;
-            }
-          }
+          const Double_t mean  = coinInfo[extCh][i].FitMean * timePerTdc;
+          const Double_t sigma = 25.0 * nsec;
+          coincidence[i] =
+            findInWindow(lastHodData, time + mean - sigma, time + mean + sigma,
+                         [&](const TdcData& lastData) {
+                           if (lastData.Channel != Hodoscope::GlobalChannelOffset) {
+                             return false;
+                           } // TBD: for 20201217
+                           const Double_t dt = lastData.Time - time;
+                           if (TMath::Abs(dt - mean) < sigma) {
+                             coinHodChs.push_back(Hodoscope::GetChannel(lastData.Channel));
+                             return true;
+                           }
+                           return false;
+                         });
         } else {
           coincidence[i] = true;
         }
@@ -149,16 +208,14 @@ Int_t updatePlots(const std::string& ifilename) {
       for (std::size_t tcCh = 0; tcCh < TimingCounter::NofChannels; ++tcCh) {
         const std::size_t i = tcCh + CoinOffset::TC;
         if (contains[extCh][i]) {
-          coincidence[i] = false;
-          for (auto&& lastData : lastTcData) {
-            const Double_t dt    = lastData.Time - time;
-            const Double_t mean  = coinInfo[extCh][i].FitMean * timePerTdc;
-            const Double_t sigma = 25.0 * nsec;
-            if (TMath::Abs(dt - mean) < sigma) {
-              coincidence[i] = true;
-              break;
-            }
-          }
+          const Double_t mean  = coinInfo[extCh][i].FitMean * timePerTdc;
+          const Double_t sigma = 25.0 * nsec;
+          coincidence[i] =
+            findInWindow(lastTcData, time + mean - sigma, time + mean + sigma,
+                         [&](const TdcData& lastData) {
+                           const Double_t dt = lastData.Time - time;
+                           return TMath::Abs(dt - mean) < sigma;
+                         });
         } else {
           coincidence[i] = true;
         }
@@ -178,13 +235,6 @@ Int_t updatePlots(const std::string& ifilename) {
       }
     };
 
-  std::cout << "=== Open File" << std::endl;
-  std::ifstream ifile(ifilename, std::ios::binary);
-  if (!ifile) {
-    std::cout << "[error] input file is not opened, " << ifilename << std::endl;
-    return 1;
-  }
-
   {
     std::cout << "=== Get Entry " << std::endl;
     std::size_t count = 0UL;
@@ -201,10 +251,10 @@ Int_t updatePlots(const std::string& ifilename) {
 
       } else if (decoder.Data.Type == Extinction::Kc705::DataType::Footer) {
         std::cout << "[info] end of spill " << decoder.Data.Spill << std::endl;
-        lastExtData.clear();
-        lastHodData.clear();
-        lastTcData.clear();
-        lastBhData.clear();
+        lastExtData.Clear();
+        lastHodData.Clear();
+        lastTcData.Clear();
+        lastBhData.Clear();
         lastMrSyncData.clear();
 
         const Int_t nhit = gHitInSpill->GetN();
@@ -309,18 +359,10 @@ Int_t updatePlots(const std::string& ifilename) {
 
             fillCoin(data);
 
-            for (std::size_t i = 0, n = lastExtData.size(); i < n; ++i) {
-              if (TMath::Abs(time - lastExtData[0].Time) > lastThreshold) {
-                lastExtData.erase(lastExtData.begin());
-              } else {
-                break;
-              }
-            }
-            lastExtData.push_back(data);
-            if (lastExtData.size() > 10000) {
-              std::cerr << "[error] size of lastExtData reaches 10000" << std::endl;
-              exit(1);
-            }
+            lastExtData.PopWhile([&](const TdcData& lastData) {
+                return TMath::Abs(time - lastData.Time) > lastThreshold;
+              });
+            lastExtData.Push(data);
 
           } else if (Hodoscope::Contains(globalChannel)) {
             const Int_t ch = Hodoscope::GetChannel(globalChannel);
@@ -336,112 +378,50 @@ Int_t updatePlots(const std::string& ifilename) {
               if (globalChannel != Hodoscope::GlobalChannelOffset) { // TBD: for 20201217
                 // Nothing to do
               } else {
-                for (auto&& lastData : lastExtData) {
-                  const std::size_t extCh = ExtinctionDetector::GetChannel(lastData.Channel);
-                  if (contains[extCh][i]) {
-                    const Double_t dt    = time - lastData.Time;
-                    const Double_t mean  = coinInfo[extCh][i].FitMean * timePerTdc;
-                    const Double_t sigma = 25.0 * nsec;
-                    if (TMath::Abs(dt - mean) < sigma) {
-                      coinExtData.push_back(lastData);
-                    }
-                  }
-                }
+                coinExtData = findCoinExt(i, time);
               }
             }
 
-            lastHodData.push_back(data);
+            lastHodData.Push(data);
             for (auto&& extData : coinExtData) {
               fillCoin(extData);
             }
 
-            for (std::size_t i = 0, n = lastHodData.size(); i < n; ++i) {
-              if (TMath::Abs(time - lastHodData[0].Time) > lastThreshold) {
-                lastHodData.erase(lastHodData.begin());
-              } else {
-                break;
-              }
-            }
-            if (lastHodData.size() > 10000) {
-              std::cerr << "[error] size of lastHodData reaches 10000" << std::endl;
-              exit(1);
-            }
+            lastHodData.PopWhile([&](const TdcData& lastData) {
+                return TMath::Abs(time - lastData.Time) > lastThreshold;
+              });
 
           } else if (TimingCounter::Contains(globalChannel)) {
             const Int_t ch = TimingCounter::GetChannel(globalChannel);
 
             hTcTdcInSpill[ch]->Fill(time / Extinction::msec);
 
-            std::vector<TdcData> coinExtData;
-            {
-              const std::size_t i = ch + CoinOffset::TC;
-              for (auto&& lastData : lastExtData) {
-                const std::size_t extCh = ExtinctionDetector::GetChannel(lastData.Channel);
-                if (contains[extCh][i]) {
-                  const Double_t dt    = time - lastData.Time;
-                  const Double_t mean  = coinInfo[extCh][i].FitMean * timePerTdc;
-                  const Double_t sigma = 25.0 * nsec;
-                  if (TMath::Abs(dt - mean) < sigma) {
-                    coinExtData.push_back(lastData);
-                  }
-                }
-              }
-            }
+            const std::vector<TdcData> coinExtData = findCoinExt(ch + CoinOffset::TC, time);
 
-            lastTcData.push_back(data);
+            lastTcData.Push(data);
             for (auto&& extData : coinExtData) {
               fillCoin(extData);
             }
 
-            for (std::size_t i = 0, n = lastTcData.size(); i < n; ++i) {
-              if (TMath::Abs(time - lastTcData[0].Time) > lastThreshold) {
-                lastTcData.erase(lastTcData.begin());
-              } else {
-                break;
-              }
-            }
-            if (lastTcData.size() > 10000) {
-              std::cerr << "[error] size of lastTcData reaches 10000" << std::endl;
-              exit(1);
-            }
+            lastTcData.PopWhile([&](const TdcData& lastData) {
+                return TMath::Abs(time - lastData.Time) > lastThreshold;
+              });
 
           } else if (BeamlineHodoscope::Contains(globalChannel)) {
             const Int_t ch = BeamlineHodoscope::GetChannel(globalChannel);
 
             hBhTdcInSpill[ch]->Fill(time / Extinction::msec);
 
-            std::vector<TdcData> coinExtData;
-            {
-              const std::size_t i = ch + CoinOffset::BH;
-              for (auto&& lastData : lastExtData) {
-                const std::size_t extCh = ExtinctionDetector::GetChannel(lastData.Channel);
-                if (contains[extCh][i]) {
-                  const Double_t dt    = time - lastData.Time;
-                  const Double_t mean  = coinInfo[extCh][i].FitMean * timePerTdc;
-                  const Double_t sigma = 25.0 * nsec;
-                  if (TMath::Abs(dt - mean) < sigma) {
-                    coinExtData.push_back(lastData);
-                  }
-                }
-              }
-            }
+            const std::vector<TdcData> coinExtData = findCoinExt(ch + CoinOffset::BH, time);
 
-            lastBhData.push_back(data);
+            lastBhData.Push(data);
             for (auto&& extData : coinExtData) {
               fillCoin(extData);
             }
 
-            for (std::size_t i = 0, n = lastBhData.size(); i < n; ++i) {
-              if (TMath::Abs(time - lastBhData[0].Time) > lastThreshold) {
-                lastBhData.erase(lastBhData.begin());
-              } else {
-                break;
-              }
-            }
-            if (lastBhData.size() > 10000) {
-              std::cerr << "[error] size of lastBhData reaches 10000" << std::endl;
-              exit(1);
-            }
+            lastBhData.PopWhile([&](const TdcData& lastData) {
+                return TMath::Abs(time - lastData.Time) > lastThreshold;
+              });
 
           } else if (MrSync::Contains(globalChannel)) {
             Bool_t found = false;
@@ -468,10 +448,63 @@ Int_t updatePlots(const std::string& ifilename) {
     }
   }
 
+  return 0;
+}
+
+Int_t updatePlots(const std::string& ifilename) {
+  std::cout << "=== Open File" << std::endl;
+  Extinction::RawFileStream ifile;
+  if (tailMode) {
+    ifile.open(ifilename,
+               [&]() {
+                 std::lock_guard<std::mutex> lock(filenameMutex);
+                 return closedFilenames.find(ifilename) != closedFilenames.end();
+               },
+               []() {
+                 // Keep canvas responsive while waiting for the daq
+                 gSystem->ProcessEvents();
+               });
+  } else {
+    ifile.open(ifilename);
+  }
+  if (!ifile) {
+    std::cout << "[error] input file is not opened, " << ifilename << std::endl;
+    return 1;
+  }
+
+  const Int_t ret = updatePlots(ifile);
+
   std::cout << "=== Close Files" << std::endl;
   ifile.close();
 
-  return 0;
+  return ret;
+}
+
+Int_t updatePlotsFromShm(const std::string& name) {
+  std::cout << "=== Open Shared Memory" << std::endl;
+  Extinction::ShmRingStreamBuf buffer;
+  if (!buffer.Open(name,
+                   []() {
+                     // Canvas was closed
+                     return !gPad;
+                   },
+                   []() {
+                     // Keep canvas responsive while waiting for the daq
+                     gSystem->ProcessEvents();
+                   })) {
+    return 1;
+  }
+  std::istream ifile(&buffer);
+
+  const Int_t ret = updatePlots(ifile);
+  if (buffer.GetDroppedBytes()) {
+    std::cout << "[warning] " << buffer.GetDroppedBytes() << " bytes were dropped, monitor could not keep up with the daq" << std::endl;
+  }
+
+  std::cout << "=== Close Shared Memory" << std::endl;
+  buffer.Close();
+
+  return ret;
 }
 
 void SignalHandler(int) {
@@ -489,6 +522,20 @@ void SignalHandler(int) {
       }
       processing = true;
 
+      // Attach to the daq, retry every second until it publishes
+      if (!shmName.empty()) {
+        if (msec_cnt % 50 == 0) {
+          try {
+            std::cout << "[info] start modify plots, " << shmName << std::endl;
+            updatePlotsFromShm(shmName);
+          } catch (...) {
+            gSystem->Exit(1);
+          }
+        }
+        processing = false;
+        return;
+      }
+
       // Get Filename
       std::string ifilename;
       {
@@ -505,6 +552,10 @@ void SignalHandler(int) {
         // Update hist
         std::cout << "[info] start modify plots, " << ifilename << std::endl;
         updatePlots(path + "/" + ifilename);
+        if (tailMode) {
+          std::lock_guard<std::mutex> lock(filenameMutex);
+          closedFilenames.erase(path + "/" + ifilename);
+        }
         processing = false;
       } catch (...) {
         gSystem->Exit(1);
@@ -558,12 +609,33 @@ void* monitorWritten(void*) {
         break;
       }
 
+      // Archive being written by the daq, it appears under its final name when complete
+      if (inotify_p->len && Tron::String::EndWith(inotify_p->name, ".part")) {
+        i += size;
+        continue;
+      }
+
+      // File was created, start to follow it in tail mode
+      if (tailMode &&
+          inotify_p->mask & IN_CREATE) {
+        std::cout << "[info] file was created \"" << inotify_p->name << "\"" << std::endl;
+        std::lock_guard<std::mutex> lock(filenameMutex);
+        filename = inotify_p->name;
+      }
+
       // File opened for writing was closed (*).
       if (inotify_p->mask & IN_CLOSE_WRITE ||
           inotify_p->mask & IN_MOVED_TO) {
         std::cout << "[info] file was closed \"" << inotify_p->name << "\"" << std::endl;
         std::lock_guard<std::mutex> lock(filenameMutex);
-        filename = inotify_p->name;
+        if (!tailMode) {
+          filename = inotify_p->name;
+        } else {
+          closedFilenames.insert(path + "/" + inotify_p->name);
+          if (inotify_p->mask & IN_MOVED_TO) {
+            filename = inotify_p->name;
+          }
+        }
       }
       i += size;
     }
@@ -587,6 +659,8 @@ Int_t main(Int_t argc, Char_t** argv) {
   Tron::ArgReader* args = new Tron::ArgReader(argv[0]);
   args->AddArg<std::string>("Directory" ,                    "A rawdata directory");
   args->AddArg<std::string>("Offset"    ,                    "A offset filename format");
+  args->AddOpt             ("Tail"      , 't', "tail"      , "Follow files being written and update plots every spill");
+  args->AddOpt<std::string>("Shm"       , 's', "shm"       , "Read raw data from shared memory of the daq instead of files", "");
   args->AddOpt             ("Help"      , 'h', "help"      , "Show usage");
 
   if (!args->Parse(argc, argv) || args->IsSet("Help") || args->HasUnsetRequired()) {
@@ -597,6 +671,8 @@ Int_t main(Int_t argc, Char_t** argv) {
   const std::string directory = args->GetValue("Directory");
   const std::string ffilename = args->GetValue("Offset");
   path = directory;
+  tailMode = args->IsSet("Tail");
+  shmName  = args->GetValue("Shm");
 
   std::cout << "=== Initialize Application" << std::endl;
   TApplication* app = new TApplication("monitor", nullptr, nullptr);
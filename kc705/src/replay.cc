@@ -0,0 +1,117 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <stdlib.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include "ArgReader.hh"
+
+// Stand-in of a KC705 board, replays a recorded raw file on a TCP port at a fixed rate
+
+int main(int argc, char** argv) {
+  const std::string AppName = "replay";
+
+  // Load Arguments
+  Tron::ArgReader* args = new Tron::ArgReader(AppName);
+  args->AddArg<std::string>("Input"         ,                   "Raw data file to replay");
+  args->AddArg<UInt_t>     ("TcpPort#"      ,                   "TCP port number");
+  args->AddOpt<Double_t>   ("Rate"          , 'r', "rate"     , "Set data rate [MB/s], 0 for no limit", "10");
+  args->AddOpt<Int_t>      ("ChunkSize"     , 'c', "chunk"    , "Set send size [bytes]"    , "2600");
+  args->AddOpt<Int_t>      ("NofLoops"      , 'l', "loop"     , "Set # of replays, 0 for infinite", "1");
+  args->AddOpt             ("Help"          , 'h', "help"     , "Help");
+
+  if (!args->Parse(argc, argv) || args->IsSet("Help") || args->HasUnsetRequired()) {
+    args->ShowUsage();
+    return 0;
+  }
+
+  const std::string  ifilename   = args->GetValue("Input");
+  const unsigned int tcpPort     = args->GetValue<unsigned int>("TcpPort#");
+  const double       rate        = args->GetValue<double>("Rate");
+  const int          chunkSize   = args->GetValue<int>("ChunkSize");
+  const int          nofLoops    = args->GetValue<int>("NofLoops");
+
+  std::cout << "Input: " << ifilename << std::endl;
+  std::cout << "TCP Port: " << tcpPort << std::endl;
+  std::cout << "Set rate: " << rate << " MB/s" << std::endl;
+  std::cout << "Set chunk size: " << chunkSize << std::endl;
+  std::cout << "Set # of loops: " << nofLoops << std::endl;
+  if (chunkSize <= 0) {
+    std::cout << "[error] invalid chunk size" << std::endl;
+    exit(1);
+  }
+
+  FILE* fin;
+  if ((fin = fopen(ifilename.data(), "rb")) == nullptr) {
+    std::cerr << "[error] input file was not opened, " << ifilename << std::endl;
+    exit(1);
+  }
+
+  // Peer close should not kill the process
+  signal(SIGPIPE, SIG_IGN);
+
+  std::cout << "Create socket..." << std::endl;
+  const int lsock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  const int yes = 1;
+  setsockopt(lsock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+  sockaddr_in addr;
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(tcpPort);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(lsock, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(lsock, 1) < 0) {
+    std::cerr << "[error] port is not available, " << tcpPort << std::endl;
+    close(lsock);
+    exit(1);
+  }
+
+  std::cout << "waiting for daq..." << std::endl;
+  const int sock = accept(lsock, nullptr, nullptr);
+  close(lsock);
+  if (sock < 0) {
+    std::cerr << "[error] accept() failed" << std::endl;
+    exit(1);
+  }
+  std::cout << "connection accepted" << std::endl;
+
+  std::vector<unsigned char> buffer(chunkSize);
+  long long  sentLength = 0;
+  bool       closed     = false;
+  const auto start      = std::chrono::steady_clock::now();
+  for (int loop = 0; !closed && (nofLoops <= 0 || loop < nofLoops); ++loop) {
+    rewind(fin);
+    for (std::size_t n; !closed && (n = fread(buffer.data(), sizeof(char), chunkSize, fin)) > 0; ) {
+      for (std::size_t written = 0; written < n; ) {
+        const ssize_t m = write(sock, buffer.data() + written, n - written);
+        if (m <= 0) {
+          std::cout << "connection closed by daq" << std::endl;
+          closed = true;
+          break;
+        }
+        written    += m;
+        sentLength += m;
+      }
+
+      // Pace to the rate
+      if (rate > 0) {
+        const auto due = start + std::chrono::duration<double>(sentLength / (rate * 1e6));
+        std::this_thread::sleep_until(std::chrono::time_point_cast<std::chrono::steady_clock::duration>(due));
+      }
+    }
+  }
+
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "Sent " << sentLength << " bytes in " << elapsed << " sec"
+            << " (" << sentLength / elapsed / 1e6 << " MB/s)" << std::endl;
+
+  close(sock);
+  fclose(fin);
+
+  return 0;
+}